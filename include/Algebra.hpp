@@ -3,8 +3,12 @@
 
 #include <vector>
 #include <cmath>
+#include <cstdint>
+
+#include "Precision.hpp"
 
 using namespace std;
+using namespace atividades_cg_1::precision;
 
 namespace atividades_cg_1::algebra
 {
@@ -13,7 +17,11 @@ namespace atividades_cg_1::algebra
     const int Z_AXIS = 3;
     const int ARBITRARY_AXIS = 4;
 
+    // Batched transformations smaller than this run on the calling thread only.
+    const int TRANSFORM_MIN_POINTS_PER_THREAD = 1 << 14;
+
     class Vector3d;
+    class Matrix4;
     class MatrixDimension
     {
     public:
@@ -29,11 +37,11 @@ namespace atividades_cg_1::algebra
     class Matrix
     {
     public:
-        vector<vector<float>> matrix;
+        vector<vector<real>> matrix;
         MatrixDimension dimension;
 
         Matrix() {}
-        Matrix(vector<vector<float>> m) : matrix(m)
+        Matrix(vector<vector<real>> m) : matrix(m)
         {
             MatrixDimension dimension = MatrixDimension(m.size(), m[0].size());
             this->dimension = dimension;
@@ -44,8 +52,8 @@ namespace atividades_cg_1::algebra
 
         Matrix multiply(Matrix other);
 
-        Matrix multiply_scalar(float v);
-        Matrix divide_scalar(float v);
+        Matrix multiply_scalar(real v);
+        Matrix divide_scalar(real v);
 
         Vector3d as_vector();
         void print();
@@ -56,22 +64,22 @@ namespace atividades_cg_1::algebra
     class Vector3d
     {
     public:
-        float x;
-        float y;
-        float z;
+        real x;
+        real y;
+        real z;
         int8_t is_point;
 
         Vector3d() {}
-        Vector3d(float x, float y, float z, int8_t is_point = 1) : x(x), y(y), z(z), is_point(is_point) {}
+        Vector3d(real x, real y, real z, int8_t is_point = 1) : x(x), y(y), z(z), is_point(is_point) {}
 
-        Vector3d multiply(float value);
-        Vector3d divide(float value);
+        Vector3d multiply(real value);
+        Vector3d divide(real value);
         Vector3d sum(Vector3d v);
         Vector3d minus(Vector3d v);
 
-        float size();
+        real size();
 
-        float scalar_product(Vector3d v);
+        real scalar_product(Vector3d v);
         Vector3d vectorial_product(Vector3d v);
 
         Vector3d get_vector_normalized();
@@ -80,12 +88,38 @@ namespace atividades_cg_1::algebra
         Matrix as_matrix();
 
         Vector3d apply_transformation(Matrix transformation);
+        Vector3d apply_transformation(const Matrix4 &transformation);
 
         void print();
 
         // friend std::ostream& operator<<(std::ostream& os, const Vector3d& v);
     };
 
+    // Fixed 4x4 homogeneous transformation kept on the stack, so it can be composed and applied
+    // to every vertex of a mesh without allocating.
+    class Matrix4
+    {
+    public:
+        real m[4][4];
+
+        // Identity.
+        Matrix4();
+        // Implicit on purpose: every MatrixTransformations result can be passed where a Matrix4 is expected.
+        Matrix4(const Matrix &matrix);
+
+        bool is_identity() const;
+
+        // this * other, so `other` is applied first.
+        Matrix4 multiply(const Matrix4 &other) const;
+        Vector3d transform(const Vector3d &v) const;
+
+        // Batched kernels: transform `count` points (w = 1) or directions (w = 0), stored as separate x, y and z
+        // arrays, in place. Uses SIMD lanes and up to thread_count threads (0 means one per core); the results
+        // are the same as transform() gives for each of them.
+        void transform_points(real *x, real *y, real *z, size_t count, int thread_count = 0) const;
+        void transform_directions(real *x, real *y, real *z, size_t count, int thread_count = 0) const;
+    };
+
     class Ray
     {
     public:
@@ -96,27 +130,49 @@ namespace atividades_cg_1::algebra
 
         Ray(Vector3d p1, Vector3d p2) : p1(p1), p2(p2) {}
 
-        float size();
+        real size();
 
         // Unitary direction vector
         Vector3d get_dr();
         // friend std::ostream& operator<<(std::ostream& os, const Ray& r);
     };
 
+    // Axis aligned box. An infinite box stands for objects without finite bounds (like Plan).
+    class BoundingBox
+    {
+    public:
+        Vector3d min_point;
+        Vector3d max_point;
+        bool infinite = false;
+
+        // Empty box, ready to be expanded.
+        BoundingBox() : min_point(INFINITY, INFINITY, INFINITY), max_point(-INFINITY, -INFINITY, -INFINITY) {}
+        BoundingBox(Vector3d min_point, Vector3d max_point) : min_point(min_point), max_point(max_point) {}
+
+        static BoundingBox infinite_box();
+
+        bool is_empty();
+        void expand(Vector3d p);
+        void merge(BoundingBox other);
+
+        // Slab test. Only hits with t >= 0 along the ray direction count.
+        bool intersects_ray(Ray ray);
+    };
+
     // Responsible of building Transform Matrix
     class MatrixTransformations
     {
     public:
         // Reusable matrix to all points (no point dependency).
-        static Matrix translation(float tx, float ty, float tz);
+        static Matrix translation(real tx, real ty, real tz);
 
         // Needs the vector you want to scale, so it is not reusable, we have to build a matrix for every point.
-        static Matrix scale(Vector3d v, float sx, float sy, float sz);
+        static Matrix scale(Vector3d v, real sx, real sy, real sz);
 
-        static Matrix rotation(float theta, int axis);
-        static Matrix rotation(float sen_theta, float cos_theta, int axis);
+        static Matrix rotation(real theta, int axis);
+        static Matrix rotation(real sen_theta, real cos_theta, int axis);
 
-        static Matrix arbitrary_rotation(float theta, Vector3d p1, Vector3d p2);
+        static Matrix arbitrary_rotation(real theta, Vector3d p1, Vector3d p2);
     };
 }
 
@@ -0,0 +1,63 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <functional>
+#include <vector>
+
+#include "Algebra.hpp"
+#include "Camera.hpp"
+#include "Scene.hpp"
+#include "Render.hpp"
+
+using namespace atividades_cg_1::algebra;
+using namespace atividades_cg_1::camera;
+using namespace atividades_cg_1::scene;
+using namespace atividades_cg_1::render;
+
+namespace atividades_cg_1::animation {
+    const int CAMERA_STATIC = 0;
+    const int CAMERA_TURNTABLE = 1;
+    const int CAMERA_FLYTHROUGH = 2;
+
+    // Transformation applied to one object at every frame, in world coordinates.
+    class ObjectAnimation
+    {
+    public:
+        int object_index;
+        Matrix4 per_frame_transformation;
+
+        ObjectAnimation(int object_index, Matrix4 per_frame_transformation)
+        : object_index(object_index), per_frame_transformation(per_frame_transformation) {}
+    };
+
+    class Animation
+    {
+    public:
+        int frame_count = 0;
+        int camera_mode = CAMERA_STATIC;
+
+        // Turntable: the eye orbits `target` at `radius`, `height` units above it.
+        Vector3d target;
+        real radius = 0;
+        real height = 0;
+
+        // Flythrough: the eye moves linearly from `from` to `to` while looking at `target`.
+        Vector3d from;
+        Vector3d to;
+
+        std::vector<ObjectAnimation> object_animations;
+
+        // Camera for the given frame. Window size, resolution and focal distance come from `base`.
+        Camera camera_at(int frame, Camera base);
+    };
+
+    // Called on the calling thread with each finished frame, in order. Returning false stops the animation.
+    typedef std::function<bool(int frame, Window &window)> FrameSink;
+
+    // Traces frame N+1 on a worker thread while `sink` presents or encodes frame N.
+    // Frames travel through `buffer_count` framebuffers (2 for double, 3 for triple buffering),
+    // so tracing only waits when the sink is that many frames behind.
+    void render_animation(Scene &scene, Animation &animation, FrameSink sink, RenderSettings settings = RenderSettings(), int buffer_count = 3);
+}
+
+#endif
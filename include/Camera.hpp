@@ -17,21 +17,51 @@ namespace atividades_cg_1::camera {
     {
     public:
         Vector3d center;
-        float width;
-        float height;
+        real width;
+        real height;
 
         int cols;
         int rows;
 
         // dx and dy of rectangles
-        float dx;
-        float dy;
+        real dx;
+        real dy;
 
         std::vector<std::vector<Color>> windows_colors;
         bool should_update = true;
 
         Window() {}
-        Window(float width, float height, int cols, int rows, float x, float y, float z);
+        Window(real width, real height, int cols, int rows, real x, real y, real z);
+
+        // Center of the pixel at (row, col), where its primary ray crosses the window plane. In camera
+        // coordinates, like the eye at the origin.
+        Vector3d get_pixel_center(int row, int col) const
+        {
+            // Creto's system: y grows upwards from the center of the window; SDL rows grow downwards.
+            real y = this->height / 2 - (this->dy / 2) - (this->dy * row);
+            real x = - this->width / 2 + (this->dx / 2) + (this->dx * col);
+            return Vector3d(x, y, this->center.z);
+        }
+    };
+
+
+    // Pyramid from the eye (origin of the camera coordinates) through a rectangle of the window plane.
+    class Frustum
+    {
+    protected:
+        // Inward normals of the left, right, bottom, top and near planes. Every plane goes through the eye.
+        Vector3d normals[5];
+
+    public:
+        Frustum() {}
+        Frustum(real left, real right, real bottom, real top, real window_z);
+
+        // Whole window, or the rectangle covered by pixel columns [first_col, last_col) and rows [first_row, last_row).
+        static Frustum from_window(Window &window);
+        static Frustum from_pixels(Window &window, int first_col, int last_col, int first_row, int last_row);
+
+        // True only when the box is completely outside, so objects that might be visible are never culled.
+        bool is_outside(BoundingBox box);
     };
 
 
@@ -47,15 +77,18 @@ namespace atividades_cg_1::camera {
             Vector3d jc;
             Vector3d ic;
 
-            float focal_distance;
+            real focal_distance;
             Window window;
 
             Camera(){}
-            Camera(Vector3d look_at, Vector3d eye, Vector3d view_up, float d, float width, 
-            float height, int cols, int rows);
+            Camera(Vector3d look_at, Vector3d eye, Vector3d view_up, real d, real width, 
+            real height, int cols, int rows);
 
             Vector3d transform_vector_from_world_to_camera(Vector3d v);
             Vector3d transform_vector_from_camera_to_world(Vector3d v);
+            // The same changes as matrices, for composing with other transformations.
+            Matrix4 get_world_to_camera_matrix();
+            Matrix4 get_camera_to_world_matrix();
             void destroy();
 
     };
@@ -4,20 +4,24 @@
 #include <iostream>
 #include <cstdint>
 
+#include "Precision.hpp"
+
+using namespace atividades_cg_1::precision;
+
 namespace atividades_cg_1::color {
     class Color;
     class IntensityColor
     {
     public:
-        float r;
-        float g;
-        float b;
+        real r;
+        real g;
+        real b;
 
         IntensityColor();
-        IntensityColor(float r, float g, float b);
+        IntensityColor(real r, real g, real b);
 
         IntensityColor arroba_multiply(IntensityColor intensity);
-        IntensityColor multiply(float value);
+        IntensityColor multiply(real value);
         IntensityColor sum(IntensityColor other);
         IntensityColor minus(IntensityColor other);
         Color to_color();
@@ -0,0 +1,92 @@
+#ifndef CONCURRENCY_H
+#define CONCURRENCY_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace atividades_cg_1::concurrency {
+
+    // FIFO shared between threads. push blocks while the queue is full and pop blocks while it is empty,
+    // so a fast producer can never run more than `capacity` items ahead of its consumer.
+    template <typename T>
+    class BoundedQueue
+    {
+    protected:
+        std::deque<T> items;
+        size_t capacity;
+        bool closed = false;
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+
+    public:
+        BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+        // Returns false if the queue was closed before the item could be added.
+        bool push(T item)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->not_full.wait(lock, [this]() { return this->closed || this->items.size() < this->capacity; });
+            if (this->closed) return false;
+
+            this->items.push_back(item);
+            this->not_empty.notify_one();
+            return true;
+        }
+
+        // Returns false once the queue is closed and there is nothing left to consume.
+        bool pop(T &item)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->not_empty.wait(lock, [this]() { return this->closed || !this->items.empty(); });
+            if (this->items.empty()) return false;
+
+            item = this->items.front();
+            this->items.pop_front();
+            this->not_full.notify_one();
+            return true;
+        }
+
+        // Wakes every waiting thread. Items already queued can still be popped.
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->closed = true;
+            this->not_empty.notify_all();
+            this->not_full.notify_all();
+        }
+    };
+
+    // Newest value handed from one producer thread to one consumer thread, in three slots so that neither of them
+    // ever waits for the other: the producer fills the back slot and publish swaps it with the ready slot, and take
+    // swaps the ready slot with the consumer's front slot when something new was published. Values the consumer
+    // was too slow to take are overwritten, like frames that were never shown.
+    template <typename T>
+    class TripleBuffer
+    {
+    protected:
+        static const int NEW_VALUE = 4; // Flag of `ready` while its slot holds a value not taken yet.
+
+        T slots[3];
+        int back = 0;  // Only touched by the producer.
+        int front = 1; // Only touched by the consumer.
+        std::atomic<int> ready{2};
+
+    public:
+        T &get_back() { return this->slots[this->back]; }
+        void publish() { this->back = this->ready.exchange(this->back | NEW_VALUE) & 3; }
+
+        // Returns true, with the newest value in get_front, when one was published since the last take.
+        bool take()
+        {
+            if (!(this->ready.load() & NEW_VALUE)) return false;
+            this->front = this->ready.exchange(this->front) & 3;
+            return true;
+        }
+        T &get_front() { return this->slots[this->front]; }
+    };
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef COST_H
+#define COST_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+#include "Camera.hpp"
+
+using namespace atividades_cg_1::camera;
+
+namespace atividades_cg_1::cost {
+    // What a cost heatmap shows.
+    const int COST_NONE = 0;
+    const int COST_INTERSECTIONS = 1; // Ray-object intersection tests, primary, shadow and secondary rays.
+    const int COST_SHADOW_TESTS = 2;  // Shadow rays, one per light sample.
+    const int COST_CYCLES = 3;        // Time spent tracing and shading the pixel.
+
+    int parse_cost_metric(std::string name);
+
+    // Work done for one pixel. Intersection tests count the objects a ray was tested against: a mesh counts
+    // once, the triangles it tests inside only show in cycles.
+    class PixelCost
+    {
+    public:
+        long intersection_tests = 0;
+        long shadow_tests = 0;
+        uint64_t cycles = 0;
+
+        double get(int metric) const;
+    };
+
+    class CostBuffers
+    {
+    public:
+        int cols = 0;
+        int rows = 0;
+        std::vector<PixelCost> pixels;
+
+        void resize(int cols, int rows);
+        PixelCost &at(int row, int col) { return this->pixels[(size_t)row * this->cols + col]; }
+    };
+
+    // Time stamp counter where there is one (not comparable between machines, nor exactly cycles on every
+    // CPU); steady clock nanoseconds elsewhere.
+    inline uint64_t read_cycle_counter()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    // Pixel the calling thread is working for, or NULL when costs are not being recorded. Set by CountedPixel.
+    inline thread_local PixelCost *counted_pixel = NULL;
+
+    // Called once per ray with the number of objects it was tested against, not once per test, so the cost of
+    // counting when nothing records it is one thread local load per ray.
+    inline void count_intersection_tests(long count)
+    {
+        if (counted_pixel != NULL) counted_pixel->intersection_tests += count;
+    }
+
+    inline void count_shadow_test()
+    {
+        if (counted_pixel != NULL) counted_pixel->shadow_tests++;
+    }
+
+    // Charges the tests and the cycles of the calling thread to `cost` until destroyed. Does nothing when cost
+    // is NULL.
+    class CountedPixel
+    {
+    protected:
+        PixelCost *cost;
+        PixelCost *previous;
+        uint64_t start = 0;
+
+    public:
+        CountedPixel(PixelCost *cost) : cost(cost), previous(counted_pixel)
+        {
+            if (cost == NULL) return;
+            counted_pixel = cost;
+            this->start = read_cycle_counter();
+        }
+
+        ~CountedPixel()
+        {
+            if (this->cost == NULL) return;
+            this->cost->cycles += read_cycle_counter() - this->start;
+            counted_pixel = this->previous;
+        }
+
+        CountedPixel(const CountedPixel &) = delete;
+        CountedPixel &operator=(const CountedPixel &) = delete;
+    };
+
+    // Paints window.windows_colors with `metric` in false color, from black (no cost) through purple, red and
+    // orange to pale yellow. The scale ends at the 99th percentile, so a few outliers do not leave the rest of
+    // the image dark; returns that value.
+    double write_heatmap(const CostBuffers &costs, int metric, Window &window);
+}
+
+#endif
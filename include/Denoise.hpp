@@ -0,0 +1,66 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include <vector>
+
+#include "Camera.hpp"
+#include "Color.hpp"
+#include "Objects.hpp"
+#include "Shading.hpp"
+
+using namespace atividades_cg_1::camera;
+using namespace atividades_cg_1::color;
+using namespace atividades_cg_1::objects;
+using namespace atividades_cg_1::shading;
+
+namespace atividades_cg_1::denoise {
+
+    // What the primary ray of a pixel hit.
+    class PixelGuide
+    {
+    public:
+        const Object *object = NULL; // NULL where the ray hit nothing; those pixels are left as they are.
+        real nx, ny, nz;             // Unitary normal.
+        real depth;                  // Distance from the eye.
+        real albedo_r, albedo_g, albedo_b; // In [0, 1]. Keeps texture and material edges.
+    };
+
+    // The guides of every pixel, row by row: the edges the denoiser must not blur across. Kept as one record
+    // per pixel, unlike ShadingBatch, because the filter reads all of them from neighbours that can be rows apart.
+    class GuideBuffers
+    {
+    public:
+        int cols = 0;
+        int rows = 0;
+        std::vector<PixelGuide> pixels;
+
+        void resize(int cols, int rows);
+        // Guides of the pixel at (row, col) from hit `index` of a batch traced from the eye at the origin.
+        void set(int row, int col, const ShadingBatch &batch, int index);
+    };
+
+    class DenoiseSettings
+    {
+    public:
+        // Passes of the 3x3 filter, with taps 1, 2, 4, ... pixels apart: 4 passes reach 15 pixels away.
+        int iterations = 4;
+        // A neighbour's weight falls as exp(-difference^2 / sigma^2) for each guide. Colors are in [0, 1] and
+        // their sigma halves after every pass, so the wide late passes only average colors that are already close.
+        real color_sigma = 1;
+        real normal_sigma = (real)0.3;
+        // Relative to the pixel's depth and to the distance between taps.
+        real depth_sigma = (real)0.02;
+        real albedo_sigma = (real)0.1;
+        // Rows are split between this many threads; 0 uses every hardware thread.
+        int thread_count = 0;
+    };
+
+    // Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010) over window.windows_colors. Each pass is a
+    // 3x3 (1/4, 1/2, 1/4) kernel whose taps are weighted by how much the neighbour's color, normal, depth and
+    // albedo differ, and is zero between different objects; the taps spread out with every pass, so a wide blur
+    // costs 9 taps per pixel per pass. Meant for renders with few shadow samples per light: their noise is
+    // averaged over each surface while silhouettes, creases and texture edges stay sharp.
+    void denoise_frame(Window &window, const GuideBuffers &guides, DenoiseSettings settings = DenoiseSettings());
+}
+
+#endif
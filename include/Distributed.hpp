@@ -0,0 +1,113 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "Color.hpp"
+#include "Render.hpp"
+#include "Socket.hpp"
+
+using namespace atividades_cg_1::color;
+using namespace atividades_cg_1::network;
+using namespace atividades_cg_1::render;
+
+namespace atividades_cg_1::distributed {
+
+    class DistributedSettings
+    {
+    public:
+        // Side of the square tiles the window is split into; each one is a `tile` request to some worker.
+        int tile_size = 64;
+        // An idle worker also takes a tile that has been running for this many times the mean tile time, and the
+        // first of the two results is kept. Zero or less never duplicates.
+        double straggler_factor = 3;
+    };
+
+    class DistributedStats
+    {
+    public:
+        double frame_time_ms = 0;
+        int tiles = 0;
+        // Tiles sent again because their worker was lost, and tiles also sent to a second worker as stragglers.
+        int requeued_tiles = 0;
+        int duplicated_tiles = 0;
+        int lost_workers = 0;
+    };
+
+    // Splits the window into tiles and hands them to `cenario --serve` workers (see Server.hpp) holding the same
+    // scene, one tile in flight per worker, then assembles the frame. A worker whose connection fails is dropped
+    // and its tile goes back to the queue; rendering only fails when no worker is left.
+    class RenderCoordinator
+    {
+    protected:
+        class Worker
+        {
+        public:
+            std::string address;
+            std::unique_ptr<Connection> connection;
+            // Tile in flight, -1 when idle, and the frame it belongs to: results of an earlier frame are discarded.
+            int tile = -1;
+            int frame = -1;
+            std::chrono::steady_clock::time_point started;
+            int tiles_done = 0;
+
+            bool is_alive() const { return this->connection != nullptr; }
+        };
+
+        std::vector<Worker> workers;
+        int cols = 0;
+        int rows = 0;
+        int frame = 0;
+
+        bool send_tile(Worker &worker, const RenderTile &tile);
+        // Reads the answer to the worker's `tile` request into `pixels` (rows * cols RGB triplets of the tile).
+        // False, with the reason in `error`, when the connection fails or the answer is not a frame.
+        bool receive_tile(Worker &worker, std::vector<char> &pixels, std::string &error);
+        void drop_worker(Worker &worker, std::string reason);
+        // Waits for the result of a tile of an earlier frame, so the next request gets its own answer.
+        void drain(Worker &worker);
+
+    public:
+        DistributedSettings settings;
+        // Called after each tile a worker delivers, with the worker index and how many it has delivered.
+        std::function<void(int worker, int tiles_done)> on_tile_done;
+
+        // Connects to every address (see connect_address) and asks each worker for its window size. Workers that
+        // cannot be reached or render another window are left out; throws when none is left.
+        RenderCoordinator(std::vector<std::string> addresses, DistributedSettings settings = DistributedSettings());
+
+        int get_cols() const { return this->cols; }
+        int get_rows() const { return this->rows; }
+        int get_worker_count() const;
+
+        // Renders one frame into `pixels` (rows x cols). Throws when every worker is lost.
+        DistributedStats render(std::vector<std::vector<Color>> &pixels);
+
+        // Sends `shutdown` to every worker still connected.
+        void shutdown_workers();
+    };
+
+    // `cenario --serve` child processes on Unix domain sockets of this machine, for running the coordinator alone.
+    class LocalWorker
+    {
+    public:
+        pid_t pid;
+        std::string address;
+    };
+
+    // Starts `count` copies of this executable serving `scene_path`, and returns once all of them accept
+    // connections. Throws when one exits or does not start listening in time.
+    std::vector<LocalWorker> spawn_local_workers(std::string scene_path, int count, int threads_per_worker);
+    // Waits for the workers to exit, killing those still running after `shutdown_workers`.
+    void stop_local_workers(std::vector<LocalWorker> &workers);
+
+    // Comma separated list of worker addresses.
+    std::vector<std::string> parse_worker_addresses(std::string list);
+}
+
+#endif
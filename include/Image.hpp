@@ -0,0 +1,33 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <string>
+#include <vector>
+
+#include "Color.hpp"
+
+using namespace atividades_cg_1::color;
+
+namespace atividades_cg_1::image {
+
+    // Binary PPM (P6) input/output for frames stored as rows of colors, like Window::windows_colors.
+    void write_ppm(std::string file_path, const std::vector<std::vector<Color>> &pixels);
+    std::vector<std::vector<Color>> read_ppm(std::string file_path);
+
+    class ImageDifference
+    {
+    public:
+        int max_channel_difference = 0;
+        double mean_channel_difference = 0;
+        // Pixels where any channel differs by more than the tolerance passed to compare_images.
+        long mismatched_pixels = 0;
+        long total_pixels = 0;
+        bool same_dimensions = true;
+
+        double mismatched_ratio();
+    };
+
+    ImageDifference compare_images(const std::vector<std::vector<Color>> &a, const std::vector<std::vector<Color>> &b, int channel_tolerance);
+}
+
+#endif
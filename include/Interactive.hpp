@@ -0,0 +1,93 @@
+#ifndef INTERACTIVE_H
+#define INTERACTIVE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Camera.hpp"
+#include "Concurrency.hpp"
+#include "Render.hpp"
+#include "Scene.hpp"
+
+using namespace atividades_cg_1::camera;
+using namespace atividades_cg_1::concurrency;
+using namespace atividades_cg_1::render;
+using namespace atividades_cg_1::scene;
+
+namespace atividades_cg_1::interactive {
+
+    // How often an idle RenderThread checks whether a mesh loading in the background is ready.
+    const int MESH_POLL_INTERVAL_MS = 50;
+
+    // A finished frame, as the RGB24 rows an SDL streaming texture takes.
+    class PresentedFrame
+    {
+    public:
+        int cols = 0;
+        int rows = 0;
+        std::vector<uint8_t> rgb;
+        double frame_time_ms = 0;
+        bool full_resolution = false;
+    };
+
+    // Packs window.windows_colors into frame.
+    void pack_frame(Window &window, PresentedFrame &frame);
+
+    // Moves eye and look at together along the camera axes, keeping the window plane where it was.
+    Camera move_camera(Camera current, real right, real up, real forward);
+
+    // Traces the frames of an interactive view on its own thread, so the thread handling the window events
+    // never waits for a trace. The scene belongs to this thread while it runs: camera moves are only queued by
+    // move_camera and applied between frames.
+    //
+    // While the view changes, frames are traced at the resolution picked by a ResolutionController and
+    // upscaled; a move that arrives during a full resolution frame cancels it. Once the moves stop, one frame is
+    // traced at full resolution and the thread sleeps until the next move, or until a mesh loading in the
+    // background is ready, which takes another full resolution frame.
+    class RenderThread
+    {
+    protected:
+        Scene &scene;
+        RenderSettings settings;
+        ResolutionController resolution;
+        TripleBuffer<PresentedFrame> frames;
+        std::function<void()> on_frame_ready;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        // Moves queued since the last frame started, added up.
+        real pending_right = 0;
+        real pending_up = 0;
+        real pending_forward = 0;
+        bool has_pending_move = false;
+        bool stopping = false;
+        std::atomic<bool> cancel_frame{false};
+        std::atomic<bool> tracing_full_resolution{false};
+
+        std::thread thread;
+
+        void run();
+        void publish(Window &window, double frame_time_ms, bool full_resolution);
+
+    public:
+        // Starts tracing the first frame right away. on_frame_ready is called on the render thread after each
+        // frame is published, to wake the consumer.
+        RenderThread(Scene &scene, RenderSettings settings, double target_fps, std::function<void()> on_frame_ready);
+        ~RenderThread();
+
+        void move_camera(real right, real up, real forward);
+        // Cancels the frame being traced and waits for the thread to end.
+        void stop();
+
+        // Consumer side: true when a frame was published since the last call, then available in get_frame.
+        bool take_frame() { return this->frames.take(); }
+        PresentedFrame &get_frame() { return this->frames.get_front(); }
+    };
+}
+
+#endif
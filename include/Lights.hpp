@@ -1,6 +1,9 @@
 #ifndef LIGHTS_H
 #define LIGHTS_H
 
+#include <algorithm>
+#include <cmath>
+
 #include "Color.hpp"
 #include "Algebra.hpp"
 
@@ -8,12 +11,23 @@ using namespace atividades_cg_1::algebra;
 using namespace atividades_cg_1::color;
 
 namespace atividades_cg_1::lights {
+    const int LIGHT_POINT = 1;
+    const int LIGHT_RECTANGLE = 2; // Parallelogram centered at `center`, spanned by edge_u and edge_v.
+    const int LIGHT_SPHERE = 3;    // Sphere surface of `radius` around `center`.
 
     class SourceOfLight
     {
     public:
         IntensityColor intensity;
         Vector3d center;
+
+        int shape = LIGHT_POINT;
+        Vector3d edge_u;
+        Vector3d edge_v;
+        real radius = 0;
+        // Area lights are sampled on a samples_per_side x samples_per_side grid, one jittered sample per cell.
+        int samples_per_side = 1;
+
         SourceOfLight() {}
         SourceOfLight(IntensityColor intensity, Vector3d center)
         {
@@ -25,7 +39,56 @@ namespace atividades_cg_1::lights {
             this->intensity = color.to_color_normalized();
             this->center = center;
         }
+
+        // At least `samples` shadow rays per point, rounded up to a square grid.
+        static SourceOfLight rectangle(IntensityColor intensity, Vector3d center, Vector3d edge_u, Vector3d edge_v, int samples)
+        {
+            SourceOfLight light(intensity, center);
+            light.shape = LIGHT_RECTANGLE;
+            light.edge_u = edge_u;
+            light.edge_v = edge_v;
+            light.set_sample_count(samples);
+            return light;
+        }
+
+        static SourceOfLight sphere(IntensityColor intensity, Vector3d center, real radius, int samples)
+        {
+            SourceOfLight light(intensity, center);
+            light.shape = LIGHT_SPHERE;
+            light.radius = radius;
+            light.set_sample_count(samples);
+            return light;
+        }
+
+        // Rounds `samples` up to a square grid; point lights keep their single sample.
+        void set_sample_count(int samples) { this->samples_per_side = std::max(1, (int)std::ceil(std::sqrt((real)samples))); }
+        int sample_count() const { return this->shape == LIGHT_POINT ? 1 : this->samples_per_side * this->samples_per_side; }
+
+        // Point of grid cell `index`, moved inside the cell by jitter_u and jitter_v in [0, 1).
+        Vector3d get_sample(int index, real jitter_u, real jitter_v) const
+        {
+            if (this->shape == LIGHT_POINT) return this->center;
+
+            real u = (index % this->samples_per_side + jitter_u) / this->samples_per_side;
+            real v = (index / this->samples_per_side + jitter_v) / this->samples_per_side;
+            Vector3d c = this->center;
+            if (this->shape == LIGHT_RECTANGLE) {
+                u -= (real)0.5;
+                v -= (real)0.5;
+                return Vector3d(c.x + this->edge_u.x * u + this->edge_v.x * v,
+                                c.y + this->edge_u.y * u + this->edge_v.y * v,
+                                c.z + this->edge_u.z * u + this->edge_v.z * v);
+            }
+
+            // Equal area cells: uniform in z and in the angle around z.
+            real z = 1 - 2 * u;
+            real ring = std::sqrt(std::max((real)0, 1 - z * z));
+            real phi = 2 * (real)M_PI * v;
+            return Vector3d(c.x + this->radius * ring * std::cos(phi),
+                            c.y + this->radius * ring * std::sin(phi),
+                            c.z + this->radius * z);
+        }
     };
 
 }
-#endif
\ No newline at end of file
+#endif
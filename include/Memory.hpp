@@ -0,0 +1,58 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Color.hpp"
+
+using namespace atividades_cg_1::color;
+
+namespace atividades_cg_1::memory {
+    // Subsystems whose memory is accounted.
+    const int MEMORY_MESH_GEOMETRY = 0; // Faces of Mesh, vertices and indices of CompactMesh.
+    const int MEMORY_FRAMEBUFFERS = 1;  // Windows and the per pixel buffers of a frame (denoise guides, costs).
+    const int MEMORY_ACCELERATION = 2;  // Culling lists of the frame, typed lists of StaticScene.
+    const int MEMORY_TEXTURES = 3;      // Texels of every mip level, once per texture however many objects share it.
+    const int MEMORY_OBJECTS = 4;       // The objects themselves, meshes without their geometry.
+    const int MEMORY_CATEGORY_COUNT = 5;
+
+    // Name of a category in the server protocol.
+    std::string get_memory_category_key(int category);
+
+    // Bytes held by each category, as counted from the data structures (vector capacities, not allocator
+    // overhead).
+    class MemoryUsage
+    {
+    public:
+        size_t bytes[MEMORY_CATEGORY_COUNT] = {};
+
+        void add(int category, size_t count) { this->bytes[category] += count; }
+        size_t total() const;
+    };
+
+    template <typename T>
+    size_t get_vector_memory(const std::vector<T> &items)
+    {
+        return items.capacity() * sizeof(T);
+    }
+
+    // Rows of pixels, like Window::windows_colors.
+    size_t get_pixels_memory(const std::vector<std::vector<Color>> &pixels);
+
+    // Latest usage measured, and the highest seen for each category and for the total.
+    class MemoryAccount
+    {
+    public:
+        MemoryUsage current;
+        MemoryUsage peak;
+        size_t peak_total = 0;
+
+        void record(const MemoryUsage &usage);
+        // One line per category with its current and peak usage, and the totals.
+        std::string describe() const;
+    };
+}
+
+#endif
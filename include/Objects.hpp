@@ -1,28 +1,55 @@
 #ifndef OBJECTS_H
 #define OBJECTS_H
 
+#include <cmath>
+#include <memory>
+
 #include "Color.hpp"
 #include "Algebra.hpp"
 #include "Lights.hpp"
 #include "Camera.hpp"
+#include "Memory.hpp"
+#include "Texture.hpp"
 
 using namespace atividades_cg_1::camera;
 using namespace atividades_cg_1::algebra;
 using namespace atividades_cg_1::color;
 using namespace atividades_cg_1::lights;
+using namespace atividades_cg_1::memory;
+using namespace atividades_cg_1::texture;
 
 
 namespace atividades_cg_1::objects {
+    // Material classes, so the shading kernel can skip work that a material does not need.
+    const int MATERIAL_DIFFUSE_ONLY = 1;  // No specular reflectivity, no pow at all.
+    const int MATERIAL_PHONG_INTEGER = 2; // Integer shininess, evaluated with multiplications.
+    const int MATERIAL_PHONG = 3;         // Any other shininess, evaluated with std::pow.
+    const int MAX_INTEGER_SHININESS = 255;
+
     class Object;
     class Intersection
     {
     public:
-        float time;
-        bool is_valid;
+        real time;
+        // Bit fields, so a float Intersection stays 16 bytes and is still returned in registers.
+        bool is_valid : 1;
+        // Triangle of the hit, for objects that return themselves instead of a per triangle object (CompactMesh).
+        int primitive_index : 31;
         Object *intersepted_object;
 
-        Intersection() {}
-        Intersection(float t, bool valid, Object *obj = NULL) : time(t), is_valid(valid), intersepted_object(obj) {}
+        Intersection() : primitive_index(-1) {}
+        Intersection(real t, bool valid, Object *obj = NULL) : time(t), is_valid(valid), primitive_index(-1), intersepted_object(obj) {}
+    };
+
+    // Where a hit falls on the texture of its object.
+    class TextureCoordinates
+    {
+    public:
+        real u;
+        real v;
+        // Texture repeats per unit of length along the surface around the hit, to turn the width of a pixel
+        // there into a texture footprint.
+        real density;
     };
 
     class Object
@@ -31,24 +58,63 @@ namespace atividades_cg_1::objects {
         virtual ~Object() {}
 
         Object() {}
-        Object(Color color, IntensityColor dr, IntensityColor sr, IntensityColor er, float shininess)
-        : color(color), difuse_reflectivity(dr), specular_reflectivity(sr), environment_reflectivity(er), shininess(shininess) {}
+        Object(Color color, IntensityColor dr, IntensityColor sr, IntensityColor er, real shininess)
+        : color(color), difuse_reflectivity(dr), specular_reflectivity(sr), environment_reflectivity(er), shininess(shininess)
+        {
+            this->classify_material();
+        }
 
         Color color;
         IntensityColor difuse_reflectivity;   // K_d
         IntensityColor specular_reflectivity; // K_e
         IntensityColor environment_reflectivity; // K_a
-        float shininess;
+        real shininess;
+        int material_class = MATERIAL_PHONG;
+
+        // Mirror and glass behaviour. Secondary rays are only traced when has_optics is set.
+        IntensityColor mirror_reflectivity = IntensityColor(0, 0, 0); // K_r
+        IntensityColor transmissivity = IntensityColor(0, 0, 0);      // K_t
+        real refraction_index = 1;
+        bool has_optics = false;
+
+        // Must be called again whenever the material fields are changed directly.
+        void classify_material();
 
         virtual void print() {};
 
+        virtual void set_material(Color color, IntensityColor dr, IntensityColor sr, IntensityColor er, real shininess);
+        virtual void set_optics(IntensityColor mirror_reflectivity, IntensityColor transmissivity, real refraction_index);
+        // Image multiplied by `color` where the object has texture coordinates. Only the objects that have them
+        // (Sphere, Plan, Mesh) keep a texture, shared by every object that uses it; the others ignore it.
+        // `scale` is the length covered by one repeat of the texture, for objects that tile it (Plan).
+        virtual void set_texture(std::shared_ptr<const Texture> texture, real scale) {};
+        virtual const Texture *get_texture() { return NULL; }
+
         virtual void apply_coordinate_change(Camera camera, int type_coord_change) {};
-        virtual void apply_transformation(Matrix transformation) {};
-        virtual void apply_scale_transformation(float sx, float sy, float sz) {};
-        virtual void apply_rotation_transformation(float theta, int axis) {};
+        virtual void apply_transformation(Matrix4 transformation) {};
+        virtual void apply_scale_transformation(real sx, real sy, real sz) {};
+        virtual void apply_rotation_transformation(real theta, int axis) {};
+        // Objects that defer their transformations (Mesh) apply everything still queued here.
+        virtual void flush_transformations() {};
+        // Point that apply_scale_transformation keeps fixed; the origin for objects without one (Plan).
+        virtual Vector3d get_center() { return Vector3d(); }
 
         virtual Intersection get_intersection(Ray ray) { return Intersection(0.0, false); }
+        // Closest hit strictly in front of ray.p1, used by secondary rays, which may start inside an object.
+        virtual Intersection get_next_intersection(Ray ray);
+        // Hit on one primitive only, for objects that report a primitive_index in their intersections.
+        virtual Intersection get_primitive_intersection(Ray ray, int primitive_index) { return this->get_intersection(ray); }
         virtual Vector3d get_normal_vector(Vector3d intersec_point, Intersection intersection) { return Vector3d();};
+        // False when the surface has no texture coordinates there; the plain color is used instead.
+        virtual bool get_texture_coordinates(Vector3d intersec_point, Intersection intersection, TextureCoordinates &coordinates) { return false; }
+
+        // Conservative bounds in the object's current coordinates. Unbounded objects return an infinite box.
+        virtual BoundingBox get_bounds() { return BoundingBox::infinite_box(); }
+        // Triangle of a hit returned by get_intersection: face * 2 + half for meshes (see CompactMesh), -1 for
+        // objects that are a single surface.
+        virtual int get_primitive_index(const Intersection &intersection) { return intersection.primitive_index; }
+        // Adds the bytes of the object to `usage`; a texture is left to the scene, which counts each one once.
+        virtual void add_memory_usage(MemoryUsage &usage);
         Vector3d get_light_vector(Vector3d intersec_point, Intersection intersection, SourceOfLight source_of_light);
 
         IntensityColor get_difuse_contribution(Vector3d intersec_point, Intersection intersection, SourceOfLight source_of_light);
@@ -59,36 +125,64 @@ namespace atividades_cg_1::objects {
 
     class Sphere : public Object
     {
+    protected:
+        // Points on the surface above the north pole and on the u = 0 meridian. They follow the transformations
+        // like the center, so the texture turns with the sphere and stays put when the camera moves.
+        Vector3d texture_pole;
+        Vector3d texture_meridian;
+        std::shared_ptr<const Texture> texture;
+
     public:
         Vector3d center;
-        float radius;
+        real radius;
 
-        Sphere(Vector3d center, float radius, Color color, IntensityColor difuse_reflectivity, IntensityColor specular_reflectivity, IntensityColor environment_reflectivity, float shininess)
-        : Object(color, difuse_reflectivity, specular_reflectivity, environment_reflectivity, shininess), center(center), radius(radius) {}
+        Sphere(Vector3d center, real radius, Color color, IntensityColor difuse_reflectivity, IntensityColor specular_reflectivity, IntensityColor environment_reflectivity, real shininess)
+        : Object(color, difuse_reflectivity, specular_reflectivity, environment_reflectivity, shininess),
+          texture_pole(center.x, center.y + radius, center.z), texture_meridian(center.x + radius, center.y, center.z),
+          center(center), radius(radius) {}
 
         // n unitary vector (normal vector).
         Vector3d get_normal_vector(Vector3d intersec_point, Intersection intersection) override;
+        void set_texture(std::shared_ptr<const Texture> texture, real scale) override { this->texture = texture; }
+        const Texture *get_texture() override { return this->texture.get(); }
+        // Longitude and latitude: the whole texture wraps once around the sphere, v = 0 at the pole.
+        bool get_texture_coordinates(Vector3d intersec_point, Intersection intersection, TextureCoordinates &coordinates) override;
 
         Intersection get_intersection(Ray ray) override;
+        Intersection get_next_intersection(Ray ray) override;
+        BoundingBox get_bounds() override;
+        void add_memory_usage(MemoryUsage &usage) override;
+        Vector3d get_center() override;
 
-        void apply_transformation(Matrix transformation) override;
-        void apply_scale_transformation(float sx, float sy, float sz) override;
+        void apply_transformation(Matrix4 transformation) override;
+        void apply_scale_transformation(real sx, real sy, real sz) override;
 
         void apply_coordinate_change(Camera camera, int type_coord_change) override;
     };
 
     class Plan: public Object {
+    protected:
+        // known_point plus one texture repeat along u and along v, as points so they follow the transformations.
+        Vector3d texture_u_point;
+        Vector3d texture_v_point;
+        std::shared_ptr<const Texture> texture;
+
     public:
         Vector3d known_point;
         Vector3d normal;
 
         Plan(Vector3d known_point, Vector3d normal, IntensityColor difuse_reflectivity, IntensityColor specular_reflectivity, 
-        IntensityColor environment_reflectivity, float shininess, Color color)
+        IntensityColor environment_reflectivity, real shininess, Color color)
         : Object(color, difuse_reflectivity, specular_reflectivity, environment_reflectivity, shininess), known_point(known_point), normal(normal.multiply(100000)) {}
 
-        void apply_transformation(Matrix transformation) override;
+        void apply_transformation(Matrix4 transformation) override;
         Vector3d get_normal_vector(Vector3d intersec_point, Intersection intersection) override;
         Intersection get_intersection(Ray ray) override ;
+        // The texture repeats every `scale` units along two directions of the plane, starting at known_point.
+        void set_texture(std::shared_ptr<const Texture> texture, real scale) override;
+        const Texture *get_texture() override { return this->texture.get(); }
+        bool get_texture_coordinates(Vector3d intersec_point, Intersection intersection, TextureCoordinates &coordinates) override;
+        void add_memory_usage(MemoryUsage &usage) override;
 
         void apply_coordinate_change(Camera camera, int type_coord_change) override;
     };
@@ -97,8 +191,6 @@ namespace atividades_cg_1::objects {
         public:
             
             Composite(){}
-
-            Vector3d virtual get_center(){return Vector3d();};
     };
 
     class Triangle : public Object, public Composite {
@@ -112,20 +204,26 @@ namespace atividades_cg_1::objects {
             Triangle(Vector3d p1, Vector3d p2, 
             Vector3d p3, Color color=Color(255,255,255), 
             IntensityColor dr=IntensityColor(.7, .7, .7), IntensityColor sr=IntensityColor(.7, .7, .7),
-            IntensityColor er=IntensityColor(.7, .7, .7), float shininess=10);
+            IntensityColor er=IntensityColor(.7, .7, .7), real shininess=10);
             Vector3d get_normal_vector(Vector3d intersec_point, Intersection intersection) override;
 
-            void apply_transformation(Matrix transformation) override;
-            void apply_scale_transformation(float sx, float sy, float sz) override;
-            void apply_rotation_transformation(float theta, int axis) override;
+            void apply_transformation(Matrix4 transformation) override;
+            void apply_scale_transformation(real sx, real sy, real sz) override;
+            void apply_rotation_transformation(real theta, int axis) override;
 
             void apply_coordinate_change(Camera camera, int type_coord_change) override;
 
             Vector3d get_p1();
             Vector3d get_p2();
             Vector3d get_p3();
+            void set_points(Vector3d p1, Vector3d p2, Vector3d p3);
+            // Interpolates the texture coordinates of p1, p2 and p3 (u and v of each, in `uv`) at a point of the
+            // triangle. False for degenerate triangles.
+            bool interpolate_texture_coordinates(Vector3d point, const real *uv, TextureCoordinates &coordinates);
 
             Intersection get_intersection(Ray ray) override;
+            BoundingBox get_bounds() override;
+            void add_memory_usage(MemoryUsage &usage) override;
             Vector3d get_center() override;
     };
 
@@ -139,46 +237,226 @@ namespace atividades_cg_1::objects {
             FourPointsFace(Vector3d p1, Vector3d p2,
                     Vector3d p3, Vector3d p4, Color color = Color(255, 255, 255),
                     IntensityColor dr = IntensityColor(.7, .7, .7), IntensityColor sr = IntensityColor(.7, .7, .7),
-                    IntensityColor er = IntensityColor(.7, .7, .7), float shininess = 10);
+                    IntensityColor er = IntensityColor(.7, .7, .7), real shininess = 10);
 
             Vector3d get_normal_vector(Vector3d intersec_point, Intersection intersection) override;
 
-            void apply_transformation(Matrix transformation) override;
-            void apply_scale_transformation(float sx, float sy, float sz) override;
-            void apply_rotation_transformation(float theta, int axis) override;
+            void apply_transformation(Matrix4 transformation) override;
+            void apply_scale_transformation(real sx, real sy, real sz) override;
+            void apply_rotation_transformation(real theta, int axis) override;
             void apply_coordinate_change(Camera camera, int type_coord_change) override;
             void print() override;
+            void set_material(Color color, IntensityColor dr, IntensityColor sr, IntensityColor er, real shininess) override;
+            void set_optics(IntensityColor mirror_reflectivity, IntensityColor transmissivity, real refraction_index) override;
 
             Intersection get_intersection(Ray ray) override;
+            BoundingBox get_bounds() override;
 
             Triangle get_t1();
             Triangle get_t2();
+            // 0 when `triangle` is t1, 1 when it is t2, -1 otherwise.
+            int get_half(const Object *triangle) const { return triangle == &this->t1 ? 0 : triangle == &this->t2 ? 1 : -1; }
+            Triangle &get_half_triangle(int half) { return half == 0 ? this->t1 : this->t2; }
             Vector3d get_center() override;
 
+            // Points of t1 and then t2, for batched transformations.
+            static const int VERTEX_COUNT = 6;
+            void get_vertices(Vector3d *vertices);
+            void set_vertices(const Vector3d *vertices);
+
     };
 
     class Mesh : public Object, public Composite {
-        // protected:
+        protected:
+            // Cached union of the face bounds, recomputed after any transformation.
+            BoundingBox bounds;
+            bool bounds_valid = false;
+
+            // Transformations composed since the last flush, not yet applied to the faces.
+            Matrix4 pending_transformation;
+            bool transformation_pending = false;
+
+            std::shared_ptr<const Texture> texture;
+
         public:
             vector<FourPointsFace> faces;
+            // u and v of p1 to p4 of every face (8 values per face), from the `vt` lines of the OBJ file. Empty when
+            // the mesh has none; faces left without them have NAN as their first u and keep the plain color.
+            vector<real> texture_coordinates;
 
             Mesh(vector<FourPointsFace> faces, Color color = Color(255, 255, 255),
                     IntensityColor dr = IntensityColor(.7, .7, .7), IntensityColor sr = IntensityColor(.7, .7, .7),
-                    IntensityColor er = IntensityColor(.7, .7, .7), float shininess = 10);
+                    IntensityColor er = IntensityColor(.7, .7, .7), real shininess = 10);
 
             Vector3d get_normal_vector(Vector3d intersec_point, Intersection intersection) override;
             void print() override;
+            void set_material(Color color, IntensityColor dr, IntensityColor sr, IntensityColor er, real shininess) override;
+            void set_optics(IntensityColor mirror_reflectivity, IntensityColor transmissivity, real refraction_index) override;
+            // Faces use texture_coordinates; faces without them keep the plain color.
+            void set_texture(std::shared_ptr<const Texture> texture, real scale) override { this->texture = texture; }
+            const Texture *get_texture() override { return this->texture.get(); }
+            bool get_texture_coordinates(Vector3d intersec_point, Intersection intersection, TextureCoordinates &coordinates) override;
+            // Sets the 8 texture coordinates of one face, making room for every face on the first call.
+            void set_texture_coordinates(int face, const real *uv);
+
+            // Transformations and coordinate changes are only composed into pending_transformation,
+            // so a chain of them walks the vertices once, on the next flush or intersection, with the
+            // batched Matrix4::transform_points kernel.
+            void queue_transformation(Matrix4 transformation);
+            void flush_transformations() override;
+
+            void apply_transformation(Matrix4 transformation) override;
+            void apply_scale_transformation(real sx, real sy, real sz) override;
+            void apply_rotation_transformation(real theta, int axis) override;
+
+            void apply_coordinate_change(Camera camera, int type_coord_change) override;
+            Vector3d get_center() override;
+
+            // Hits return the mesh itself as the intersepted object, with primitive_index = face * 2 + half (t1 or
+            // t2 of the face), like CompactMesh.
+            Intersection get_intersection(Ray ray) override;
+            Intersection get_primitive_intersection(Ray ray, int primitive_index) override;
+            BoundingBox get_bounds() override;
+            void add_memory_usage(MemoryUsage &usage) override;
+    };
+
+    // Face mesh stored for size, for assets too large for Mesh: vertex positions are quantized to 16 bits per
+    // axis inside the mesh bounds (6 bytes per vertex) and faces are four vertex indices of 16 bits, or 32 bits
+    // when there are more than 65536 vertices. Vertices are decoded during intersection.
+    //
+    // Precision: a decoded vertex is off by at most half a quantization step per axis, that is the mesh size
+    // along that axis / 131070 (about 0.0008%). Transformations only change the decoding matrix, so they are
+    // free and add no further error.
+    //
+    // Faces split like FourPointsFace, into (p1, p2, p3) and (p3, p4, p1). Hits return the mesh itself as the
+    // intersepted object, with primitive_index = face * 2 + half.
+    // Texture coordinates are not kept, so a texture leaves the mesh with its plain color.
+    class CompactMesh : public Object, public Composite {
+        protected:
+            vector<uint16_t> positions;     // x, y, z of every vertex.
+            vector<uint16_t> short_indices; // Four per face, when every index fits in 16 bits.
+            vector<uint32_t> long_indices;  // Four per face otherwise.
+            size_t face_count = 0;
+
+            // From quantized coordinates (0 to 65535) to the current coordinates of the mesh.
+            Matrix4 decoding;
+
+            BoundingBox bounds;
+            bool bounds_valid = false;
+
+            void build(const vector<Vector3d> &vertices, const vector<uint32_t> &quads);
+            uint32_t get_index(size_t face, int corner);
+            Vector3d get_vertex(uint32_t index);
+            void get_triangle(int primitive_index, Vector3d &p1, Vector3d &p2, Vector3d &p3);
+
+        public:
+            // `quads` holds the four vertex indices of each face.
+            CompactMesh(const vector<Vector3d> &vertices, const vector<uint32_t> &quads, Color color = Color(255, 255, 255),
+                    IntensityColor dr = IntensityColor(.7, .7, .7), IntensityColor sr = IntensityColor(.7, .7, .7),
+                    IntensityColor er = IntensityColor(.7, .7, .7), real shininess = 10);
+            // Same faces and material as `mesh`, with the vertices that faces share stored once.
+            CompactMesh(Mesh &mesh);
+
+            size_t get_face_count();
+            // Bytes taken by the vertices and indices.
+            size_t get_memory_usage();
 
-            void apply_transformation(Matrix transformation) override;
-            void apply_scale_transformation(float sx, float sy, float sz) override;
-            void apply_rotation_transformation(float theta, int axis) override;
+            Vector3d get_normal_vector(Vector3d intersec_point, Intersection intersection) override;
+            void print() override;
 
+            void apply_transformation(Matrix4 transformation) override;
+            void apply_scale_transformation(real sx, real sy, real sz) override;
+            void apply_rotation_transformation(real theta, int axis) override;
             void apply_coordinate_change(Camera camera, int type_coord_change) override;
+            // Center of the quantization box.
             Vector3d get_center() override;
 
             Intersection get_intersection(Ray ray) override;
-            
+            Intersection get_primitive_intersection(Ray ray, int primitive_index) override;
+            BoundingBox get_bounds() override;
+            void add_memory_usage(MemoryUsage &usage) override;
     };
+
+    // The intersection tests of the basic primitives are defined here, so that StaticScene, which calls them
+    // without going through the vtable, can also inline them into its loops.
+
+    inline Intersection Sphere::get_intersection(Ray ray)
+    {
+        Vector3d initial_point = ray.p1;
+        Vector3d dr = ray.get_dr();
+
+        Vector3d w = initial_point.minus(this->center);
+
+        // We want to check if ||Pint - C||² = R²
+        // (Pin + tint*dr - C).(Pin + tint*dr - C) - R² = 0
+        // (w + tint*dr).(w + tint*dr) - R² = 0
+        // w² + 2w*tint*dr + tint²*dr² - R² = 0
+        // dr²*tint² + 2w*dr*tint + w² -     R² = 0
+        real a = dr.scalar_product(dr);
+        real b = (w.multiply(2)).scalar_product(dr);
+        real c = w.scalar_product(w) - std::pow(this->radius, 2);
+
+        real delta = std::pow(b, 2) - (4 * a * c);
+        // Most shadow rays miss: leave before the square root, which is slow for negative numbers.
+        if (delta < 0)
+        {
+            return Intersection(0.0, false);
+        }
+
+        real root = std::sqrt(delta);
+        real t1 = (-b + root) / (2 * a);
+        real t2 = (-b - root) / (2 * a);
+        if (t1 < t2)
+            return Intersection(t1, true, this);
+        return Intersection(t2, true, this);
+    }
+
+    inline Intersection Plan::get_intersection(Ray ray)
+    {
+        Vector3d w = ray.p1.minus(this->known_point);
+        Vector3d dr = ray.get_dr();
+
+        real t_int = -(this->normal.scalar_product(w)) / (this->normal.scalar_product(dr));
+        if (t_int > 0) {
+            return Intersection(t_int, true, this);
+        }
+        return Intersection(t_int, false);
+    }
+
+    // Hit of the ray on triangle (p1, p2, p3), reported as a hit on `object`. Shared by Triangle and CompactMesh.
+    inline Intersection intersect_triangle(Vector3d &p1, Vector3d &p2, Vector3d &p3, Ray &ray, Object *object)
+    {
+        Vector3d r1 = p2.minus(p1);
+        Vector3d r2 = p3.minus(p1);
+        Vector3d normal_vector = r1.vectorial_product(r2).get_vector_normalized();
+        real intersec_t = -(((ray.p1.minus(p1)).scalar_product(normal_vector)) / ray.get_dr().scalar_product(normal_vector));
+
+        if (intersec_t <= 0)
+        {
+            return Intersection(intersec_t, false);
+        }
+
+        Vector3d intersec_point = ray.p1.sum(ray.get_dr().multiply(intersec_t));
+        Vector3d v = intersec_point.minus(p1);
+
+        real total_area = r1.vectorial_product(r2).scalar_product(normal_vector);
+
+        real c1 = v.vectorial_product(r2).scalar_product(normal_vector) / total_area;
+        real c2 = r1.vectorial_product(v).scalar_product(normal_vector) / total_area;
+        real c3 = 1.0 - c1 - c2;
+
+        if (c1 >= 0.0 && c2 >= 0.0 && c3 >= 0.0 && std::abs(c1 + c2 + c3 - 1.0) <= 1.0e-12)
+        {
+            return Intersection(intersec_t, true, object);
+        }
+
+        return Intersection(intersec_t, false);
+    }
+
+    inline Intersection Triangle::get_intersection(Ray ray)
+    {
+        return intersect_triangle(this->p1, this->p2, this->p3, ray, this);
+    }
 }
 
 #endif
\ No newline at end of file
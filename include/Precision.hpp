@@ -0,0 +1,14 @@
+#ifndef PRECISION_H
+#define PRECISION_H
+
+namespace atividades_cg_1::precision {
+    // Scalar used by the algebra, color and intersection code. Build with -DCENARIO_DOUBLE_PRECISION=ON
+    // for double: large scenes keep more precision, at the cost of twice the memory per vector.
+#ifdef CENARIO_DOUBLE_PRECISION
+    typedef double real;
+#else
+    typedef float real;
+#endif
+}
+
+#endif
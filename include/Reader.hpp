@@ -5,24 +5,66 @@
 #include <vector>
 
 #include "Objects.hpp"
+#include "Scene.hpp"
+#include "Animation.hpp"
 
 using namespace std;
 using namespace atividades_cg_1::objects;
 using namespace atividades_cg_1::algebra;
+using namespace atividades_cg_1::scene;
+using namespace atividades_cg_1::animation;
 
 namespace atividades_cg_1::reader 
 {
+    // Files smaller than this are parsed by a single thread.
+    const size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
+
+    // Transformations follow the object on the same line and are applied in order, in world coordinates:
+    // translate tx ty tz | rotate <x|y|z> degrees | scale sx sy sz
+    void apply_transformations(Object *object, std::string transformations);
+    // The same transformations composed into one matrix, for Scene::transform_objects. Scales are about
+    // `center` (the object's, in world coordinates), moved along by the steps before them.
+    Matrix4 get_transformation_matrix(std::string transformations, Vector3d center);
+
     class ObjReader {
         public:
             vector<Vector3d> vertices;
+            vector<real> texture_coordinates; // u and v of every `vt` line, v from the top of the image.
             vector<FourPointsFace> faces;
+            // The file is cut at line breaks into one chunk per thread; 0 uses every hardware thread.
+            int thread_count = 0;
 
+            // The file is mapped into memory rather than copied. Chunks are parsed in parallel, then merged: a
+            // prefix sum over the vertex and face counts of the chunks places each one in the mesh and resolves its
+            // face indices.
             Mesh* read_obj_file(std::string file_path);
+            // Same parsing, but the faces go straight into a CompactMesh: no FourPointsFace is ever built.
+            CompactMesh* read_compact_obj_file(std::string file_path);
+    };
+
+    // Reads a text scene description (see scenes/default.scene) into a Scene.
+    // Meshes declared with `asset` are only read when a `mesh` line references them, and every referenced
+    // asset is read on its own thread. The scene is returned without waiting for them: each mesh stands as its
+    // `bounds` box (or nothing) until Scene::swap_loaded_meshes puts it in place.
+    class SceneReader {
+        public:
+            // Filled by the `animation`, `turntable`, `flythrough`, `spin` and `move` commands.
+            Animation animation;
+            // Returns a ProductionScene (see StaticScene.hpp) instead of a Scene.
+            bool static_dispatch = false;
+
+            Scene* read_scene_file(std::string file_path);
     };
 
     class ObjFactory {
         public:
             static Mesh* create_cube();
+            // Six faces around the box, for stand ins of meshes that are still loading.
+            static Mesh* create_box(BoundingBox box);
+
+            // Square grid on the XZ plane centered at the origin, with divisions x divisions faces.
+            // Heights follow a sine wave so that neighbouring faces have different normals.
+            static Mesh* create_grid(int divisions, real size, real wave_height);
     };
 } // atividades_cg1::reader 
 
@@ -0,0 +1,69 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Render.hpp"
+#include "Scene.hpp"
+
+using namespace atividades_cg_1::render;
+using namespace atividades_cg_1::scene;
+
+namespace atividades_cg_1::regression {
+
+    // A scene rendered headless at a fixed resolution and compared against its golden image.
+    class ReferenceScene
+    {
+    public:
+        std::string name;
+        int cols;
+        int rows;
+        std::function<Scene *(int cols, int rows)> build;
+        RenderSettings settings;
+
+        ReferenceScene(std::string name, int cols, int rows, std::function<Scene *(int cols, int rows)> build,
+                       RenderSettings settings = RenderSettings())
+        : name(name), cols(cols), rows(rows), build(build), settings(settings) {}
+    };
+
+    class RegressionOptions
+    {
+    public:
+        std::string golden_dir = "../tests/golden";
+        // Timings depend on the scalar precision the renderer was built with.
+        std::string baseline_path = sizeof(real) == sizeof(double) ? "../tests/baseline_double.txt" : "../tests/baseline_float.txt";
+        // Rewrite golden images and baseline timings instead of checking them.
+        bool update = false;
+        // Maximum allowed slowdown of a scene (0.25 = 25% slower). Frame times are compared as multiples of a
+        // calibration frame rendered in the same run, so baselines recorded on another machine still hold.
+        double time_tolerance = 0.25;
+        // A pixel mismatches when any channel differs by more than this.
+        int channel_tolerance = 8;
+        // Fraction of mismatched pixels accepted before the output is considered changed.
+        double mismatched_ratio_tolerance = 0.01;
+        // Each scene is rendered this many times: the fastest frame is reported, the median calibrated time checked.
+        int repetitions = 5;
+    };
+
+    std::vector<ReferenceScene> get_reference_scenes();
+
+    // Returns 0 when every scene matches its golden image and baseline timing, 1 otherwise.
+    int run_regression_suite(RegressionOptions options);
+
+    // Renders every reference scene with each primary ray traversal order and prints frame time, rays/s and,
+    // when the kernel allows perf_event_open, hardware cache misses.
+    int run_traversal_benchmark(RegressionOptions options);
+
+    // Reads the OBJ file with 1, 2, 4, ... threads up to the hardware thread count and prints the parse time of
+    // each. Returns 1 when the file cannot be read or the thread counts disagree on the mesh.
+    int run_obj_benchmark(std::string obj_path, RegressionOptions options);
+
+    // Renders the scene file in this process and through `worker_count` local worker processes (see
+    // Distributed.hpp), killing one worker partway through the frame. Returns 0 when the coordinator reports the
+    // lost worker and both frames match.
+    int run_distributed_check(std::string scene_path, int worker_count, RegressionOptions options);
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "Camera.hpp"
+#include "Cost.hpp"
+#include "Denoise.hpp"
+#include "Scene.hpp"
+
+using namespace atividades_cg_1::camera;
+using namespace atividades_cg_1::cost;
+using namespace atividades_cg_1::scene;
+using namespace atividades_cg_1::denoise;
+
+namespace atividades_cg_1::render {
+    // Order in which primary rays are traced.
+    const int TRAVERSAL_SCANLINE = 1; // Whole image rows, left to right.
+    const int TRAVERSAL_ROW_MAJOR = 2; // Square tiles, rows inside each tile.
+    const int TRAVERSAL_MORTON = 3;    // Square tiles, Z-order curve inside each tile.
+    const int TRAVERSAL_HILBERT = 4;   // Square tiles, Hilbert curve inside each tile.
+
+    class RenderSettings
+    {
+    public:
+        int traversal_order = TRAVERSAL_MORTON;
+        // Pixels per tile side. Must be a power of two for the Morton and Hilbert curves.
+        int tile_size = 16;
+        // Tiles are shared by this many threads; 0 uses every hardware thread.
+        int thread_count = 0;
+        // render_frame runs the denoiser over the whole frame after tracing it, guided by the primary hits.
+        // render_region never does: a region cannot see the pixels around it.
+        bool denoise = false;
+        DenoiseSettings denoise_settings;
+        // COST_INTERSECTIONS, COST_SHADOW_TESTS or COST_CYCLES: render_frame records the cost of every pixel and
+        // replaces the image with a heatmap of it (not denoised). render_region ignores it, like denoise.
+        int heatmap = COST_NONE;
+        // When set, tiles not started yet are skipped once it becomes true, leaving the frame incomplete.
+        const std::atomic<bool> *cancel = NULL;
+    };
+
+    // Part of the window traced as one unit of work: columns [first_col, last_col) and rows [first_row, last_row).
+    class RenderTile
+    {
+    public:
+        int first_col;
+        int last_col;
+        int first_row;
+        int last_row;
+
+        RenderTile(int first_col, int last_col, int first_row, int last_row)
+        : first_col(first_col), last_col(last_col), first_row(first_row), last_row(last_row) {}
+    };
+
+    // Pixel offsets (col, row) of a tile_size x tile_size tile, in the given traversal order.
+    std::vector<std::pair<int, int>> get_tile_traversal(int traversal_order, int tile_size);
+
+    int parse_traversal_order(std::string name);
+
+    class FrameStats
+    {
+    public:
+        double frame_time_ms = 0;
+        // Part of frame_time_ms spent denoising.
+        double denoise_time_ms = 0;
+        long primary_rays = 0;
+        long secondary_rays = 0;
+        // Totals of the heatmap's cost buffers, and the cost shown as its hottest color. Only set with a heatmap.
+        long intersection_tests = 0;
+        long shadow_tests = 0;
+        double heatmap_scale = 0;
+        // Bytes of the window and of the per pixel buffers (denoise guides, costs) the frame used.
+        size_t framebuffer_bytes = 0;
+
+        // Primary and secondary rays.
+        double rays_per_second();
+    };
+
+    // Chooses how much of the window resolution interactive frames trace, so the frame time stays close to a
+    // target. `scale` multiplies the rows and the columns.
+    class ResolutionController
+    {
+    public:
+        double target_frame_ms;
+        real min_scale = 0.25;
+        real scale = 1;
+
+        ResolutionController(double target_fps = 30) : target_frame_ms(1000 / target_fps) {}
+
+        // Adjusts scale after a frame traced at the current scale took frame_time_ms.
+        void record_frame(double frame_time_ms);
+    };
+
+    // Window covering the same area of the window plane as `full`, with `scale` times its rows and columns.
+    Window scale_window(Window &full, real scale);
+    // Fills every pixel of full.windows_colors by bilinear interpolation of low.windows_colors.
+    void upscale_window(Window &low, Window &full);
+
+    // Traces every pixel of the window and stores the result in window.windows_colors.
+    // Objects are expected in camera coordinates, so the eye is at the origin.
+    FrameStats render_frame(Scene &scene, Window &window, RenderSettings settings = RenderSettings());
+    // Same, for the pixels of `region` only; the rest of windows_colors is left as it was.
+    FrameStats render_region(Scene &scene, Window &window, RenderTile region, RenderSettings settings = RenderSettings());
+}
+
+#endif
@@ -1,45 +1,198 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <atomic>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <vector>
 
 #include "Color.hpp"
 #include "Algebra.hpp"
 #include "Lights.hpp"
+#include "Memory.hpp"
 #include "Objects.hpp"
 #include "Camera.hpp"
+#include "Cost.hpp"
+#include "Shading.hpp"
 
 using namespace atividades_cg_1::algebra;
 using namespace atividades_cg_1::color;
 using namespace atividades_cg_1::lights;
+using namespace atividades_cg_1::memory;
 using namespace atividades_cg_1::objects;
 using namespace atividades_cg_1::camera;
+using namespace atividades_cg_1::cost;
+using namespace atividades_cg_1::shading;
 
 namespace atividades_cg_1::scene {
     const int WORLD_COORDINATES = 1;
     const int CAMERA_COORDINATES = 2;
 
+    // Pixels per side of the tiles that get their own primary ray candidate list.
+    const int CULLING_TILE_SIZE = 16;
+
+    // Secondary rays start this far from the surface they leave, so they do not hit it again.
+    const real SECONDARY_RAY_OFFSET = 0.01;
+
+    // Texture footprints grow as 1 / cos of the angle between the ray and the normal, up to this factor.
+    const real MAX_GRAZING_FOOTPRINT_SCALE = 16;
+
+    // Limits for the reflection and refraction rays of mirror and glass materials.
+    class SecondaryRaySettings
+    {
+    public:
+        // Bounces after the primary hit.
+        int max_depth = 4;
+        // Rays carrying less than this fraction of the pixel survive only with probability fraction / threshold
+        // (Russian roulette), and the survivors are weighted up to keep the expected color.
+        real roulette_threshold = 0.1;
+        // Secondary rays allowed per frame, as a multiple of the window's pixel count. Negative means unlimited.
+        real rays_per_pixel = 2;
+    };
+
+    // Mesh that another thread is still reading. objects[index] holds a stand in (like its bounding box) until
+    // the mesh is ready; `prepare` then gives the loaded mesh its material and world transformations.
+    class PendingMesh
+    {
+    public:
+        int index;
+        std::shared_future<Object *> mesh; // A Mesh or a CompactMesh.
+        std::function<Object *(Object *)> prepare;
+        // World transformations applied to the stand in while loading, replayed on the mesh.
+        std::vector<Matrix4> transformations;
+    };
+
+    // World coordinates transformation of objects[object_index], for Scene::transform_objects.
+    class ObjectTransformation
+    {
+    public:
+        int object_index;
+        Matrix4 transformation;
+
+        ObjectTransformation(int object_index, Matrix4 transformation) : object_index(object_index), transformation(transformation) {}
+    };
+
+    // What the primary ray of a pixel hits, for selecting objects on screen.
+    class PickResult
+    {
+    public:
+        // The scene object, a Mesh rather than one of its triangles. NULL when the ray hits nothing.
+        Object *object = NULL;
+        int object_index = -1; // In Scene::objects.
+        // Triangle of a mesh, as face * 2 + half; -1 for objects that are a single surface.
+        int primitive_index = -1;
+        Vector3d point; // In world coordinates.
+        real distance = INFINITY; // From the eye.
+    };
+
     class Scene
     {
     protected:
         Camera camera;
+
+        std::vector<Object *> visible_objects;
+        int tile_cols = 0;
+        std::vector<std::vector<Object *>> tile_candidates;
+        // Size of the window the tile candidates were built for, and whether the camera or the objects moved since.
+        int culling_cols = 0;
+        int culling_rows = 0;
+        bool culling_stale = true;
+
+        // Secondary rays left in this frame, shared by every tracing thread. Reset by prepare_frame.
+        std::atomic<long> secondary_ray_budget{0};
+        bool secondary_ray_budget_limited = false;
+        std::atomic<long> secondary_rays_traced{0};
+
+        // Angle covered by a pixel, set by prepare_frame. A ray spreads into a cone of this angle, whose width
+        // where it meets a textured surface picks the texture level.
+        real pixel_spread_angle = 0;
+
+        // Point, normal, albedo and shadow visibility of a hit found by `ray`, appended to batch. Shadow rays
+        // start with the per light occluders cached in `occluders`. `distance` is how far the ray's cone already
+        // travelled before ray.p1 (0 for primary rays).
+        void add_hit(Ray ray, Intersection intersection, ShadingBatch &batch, std::vector<Object *> &occluders, real distance = 0);
+        // Whether something other than `target` (or than its primitive target_primitive, when not -1) is closer
+        // to the light along ray_light. Stops at the first occluder found, trying last_occluder before the others, and
+        // remembers it.
+        virtual bool is_occluded(Ray ray_light, Object *target, int target_primitive, Object *&last_occluder);
+        // First part of is_occluded: the hit on the target itself, in `own`. False when the target is missed or
+        // another of its own primitives is in front, that is when the point is already known to be in shadow.
+        bool find_target_hit(Ray &ray_light, Object *target, int target_primitive, Intersection &own);
+
+        std::vector<PendingMesh> pending_meshes;
+        bool take_secondary_ray();
+        // Follows the reflection and refraction rays of batch hit `index` with an explicit stack and adds
+        // their contribution to color.
+        void trace_secondary(ShadingBatch &batch, int index, Color &color);
     public:
         std::vector<Object *> objects;
         int coordinates_type;
         Color background_color;
-        SourceOfLight source_of_light;
+        std::vector<SourceOfLight> sources_of_light;
         IntensityColor environment_light;
-
+        SecondaryRaySettings secondary_ray_settings;
+        // Bytes that get_memory_usage may reach, 0 for no limit. Meshes that finish loading past it are left
+        // out of the scene (see swap_loaded_meshes).
+        size_t memory_budget = 0;
 
         Scene(Color bg_color, SourceOfLight source, IntensityColor environment_light, Camera camera);
+        virtual ~Scene() {}
        
         void push_object(Object *obj);
+        void push_light(SourceOfLight source);
+        // Pushes `proxy` (in world coordinates) in place of a mesh that is still loading, or an invisible object
+        // when proxy is NULL. Returns the object index, which the mesh keeps once it replaces the proxy.
+        int push_pending_mesh(std::shared_future<Object *> mesh, std::function<Object *(Object *)> prepare, Object *proxy);
+        // Replaces the proxies of the meshes that finished loading. Called by prepare_frame, so a mesh joins the
+        // scene between frames; with `wait`, blocks until every mesh is loaded. A mesh that would take the scene
+        // past memory_budget is deleted and its proxy replaced by an invisible object.
+        void swap_loaded_meshes(bool wait = false);
+        bool has_pending_meshes();
+        // Whether some pending mesh finished loading, so the next swap_loaded_meshes replaces its proxy.
+        bool has_loaded_meshes();
+
+        // Applies a world coordinates transformation to objects[index], which is stored in camera coordinates.
+        // The camera changes and the transformation reach the object as one composed matrix.
+        void transform_object(int index, Matrix4 transformation);
+        // Batched form of transform_object, for updating many objects at once (like an animation frame).
+        void transform_objects(const std::vector<ObjectTransformation> &transformations);
+        // Applies the transformations that objects (meshes) are still deferring. Called by prepare_frame.
+        void flush_transformations();
 
         Color get_color_to_draw(Ray ray);
 
+        // Finds the closest hit of the ray and its shadow visibility for every light, and appends them to batch.
+        // Colors are computed later, for the whole batch at once, by shade().
+        void trace(Ray ray, ShadingBatch &batch);
+        // Same, but the primary ray is only tested against `candidates`. Shadow rays always test every object.
+        void trace(Ray ray, ShadingBatch &batch, std::vector<Object *> &candidates);
+        // Primary ray of the pixel at (row, col), tested against the candidates of its tile.
+        virtual void trace_pixel(Ray ray, ShadingBatch &batch, int row, int col);
+        // Also traces the secondary rays of hits on mirror and glass materials. When `costs` is set, the work of
+        // hit i is charged to costs[i]; batched shading is shared evenly between the hits.
+        void shade(ShadingBatch &batch, Color *colors, PixelCost *const *costs = NULL);
+
         void dealloc_objects();
 
+        // Frustum culling, once per frame: objects completely outside the window frustum are left out of the
+        // primary ray candidates, and each CULLING_TILE_SIZE tile keeps only the objects inside its own frustum.
+        virtual void prepare_frame(Window &window);
+        // Candidates for the pixel at (row, col).
+        std::vector<Object *> &get_tile_candidates(int row, int col);
+        // Secondary rays traced since the last prepare_frame.
+        long get_secondary_rays_traced();
+        // What the primary ray of the pixel at (col, row) of the camera window hits. When the last prepare_frame
+        // was for the camera window (like the last render_frame at full resolution) and nothing moved since, only
+        // the candidates of the pixel's tile are tested, as for the frame; otherwise every object. Like tracing,
+        // it must not run while another thread changes the scene.
+        PickResult pick(int col, int row);
+        // Same, for many pixels (col, row) at once, like the pixels under a lasso.
+        std::vector<PickResult> pick(const std::vector<std::pair<int, int>> &pixels);
+
+        // Memory held by the scene: objects, mesh geometry, textures, culling lists and the camera window.
+        virtual MemoryUsage get_memory_usage();
+
         /* Transformations: C->W (old camera) and then W->C (new camera)*/
         void set_camera(Camera camera);
 
@@ -0,0 +1,59 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+
+#include "Render.hpp"
+#include "Scene.hpp"
+#include "Socket.hpp"
+
+using namespace atividades_cg_1::network;
+using namespace atividades_cg_1::render;
+using namespace atividades_cg_1::scene;
+
+namespace atividades_cg_1::server {
+    // Long lived render process: the scene is read once and stays loaded (meshes, camera coordinates) while
+    // clients send requests over a Unix domain or TCP socket, so each request only pays for the change and the
+    // tracing.
+    //
+    // One request per line, answered with `ok`, `error <message>` or a frame:
+    //   ping
+    //   camera [eye x y z] [look_at x y z] [view_up x y z] [focal d]   (what is left out is kept)
+    //   resolution cols rows
+    //   transform object_index <transformations>                       (same syntax as the scene file)
+    //   render [ppm|raw]
+    //   tile first_col first_row last_col last_row                     (raw frame of those pixels only)
+    //   window                                                         (answered with `window cols rows`)
+    //   pick col row                                                   (answered with `pick none`, or with
+    //                                                                   `pick object_index primitive_index x y z distance`)
+    //   memory                                                         (answered with `memory` and, for total and
+    //                                                                   each category, `key current_bytes peak_bytes`)
+    //   quit                                                           (closes this connection)
+    //   shutdown                                                       (stops the server)
+    // A frame is the line `frame cols rows format bytes frame_time_ms` followed by `bytes` bytes: a binary PPM,
+    // or rows * cols RGB triplets for raw.
+    class RenderServer
+    {
+    protected:
+        Scene &scene;
+        RenderSettings settings;
+        bool running = true;
+        // Measured when serving starts and after every frame; the peak is printed when the server stops.
+        MemoryAccount memory;
+
+        void record_memory(size_t framebuffer_bytes);
+
+        // Answers one request. Returns false when the connection should be closed.
+        bool handle_request(Connection &connection, const std::string &request);
+        void send_frame(Connection &connection, Window &window, RenderTile region, std::string format, double frame_time_ms);
+
+    public:
+        RenderServer(Scene &scene, RenderSettings settings) : scene(scene), settings(settings) {}
+
+        // Serves clients one at a time on `address` (see listen_address) until a `shutdown` request.
+        // Returns the process exit code.
+        int serve(std::string address);
+    };
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SHADING_H
+#define SHADING_H
+
+#include <vector>
+
+#include "Algebra.hpp"
+#include "Color.hpp"
+#include "Lights.hpp"
+#include "Objects.hpp"
+
+using namespace atividades_cg_1::algebra;
+using namespace atividades_cg_1::color;
+using namespace atividades_cg_1::lights;
+using namespace atividades_cg_1::objects;
+
+namespace atividades_cg_1::shading {
+
+    // Hit points waiting to be shaded, stored as one array per component so the kernel loops stay simple.
+    // visibility[i * light_count + l] is how much of light l reaches hit i (0 in shadow, 1 fully lit, the fraction of
+    // unblocked samples for area lights).
+    class ShadingBatch
+    {
+    public:
+        int light_count = 0;
+        std::vector<Object *> objects; // NULL when the ray hit nothing.
+        std::vector<real> px, py, pz;
+        std::vector<real> nx, ny, nz;
+        std::vector<real> dx, dy, dz; // Unitary direction of the ray that found the hit.
+        std::vector<Color> albedo;    // Object color, or its texture filtered at the hit.
+        std::vector<real> visibility;
+        // Last object that blocked each light. Tested first by the next shadow ray, since neighbouring pixels
+        // usually share occluders. Kept by clear(), a batch belongs to a single thread.
+        std::vector<Object *> last_occluders;
+
+        ShadingBatch() {}
+        ShadingBatch(int light_count) : light_count(light_count), last_occluders(light_count, NULL) {}
+
+        int size() const { return this->objects.size(); }
+        void clear();
+
+        // Returns the index of the new hit; its visibility starts as fully lit.
+        int add_hit(Object *object, Vector3d point, Vector3d normal, Vector3d direction, Color albedo);
+        void add_miss();
+    };
+
+    class ShadingParameters
+    {
+    public:
+        const std::vector<SourceOfLight> *lights;
+        IntensityColor environment_light;
+        Vector3d eye;
+        Color background_color;
+    };
+
+    // Phong shading of every hit in the batch. Hits are grouped by Object::material_class and each group runs
+    // a specialized loop; contributions are accumulated without clamping and clamped once per pixel.
+    void shade_batch(const ShadingBatch &batch, const ShadingParameters &parameters, Color *colors);
+}
+
+#endif
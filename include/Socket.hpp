@@ -0,0 +1,49 @@
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <string>
+
+namespace atividades_cg_1::network {
+
+    // Blocking stream socket with a read buffer, for line based requests followed by binary payloads.
+    // Owns the descriptor and closes it on destruction.
+    class Connection
+    {
+    protected:
+        int fd;
+        std::string buffer;
+
+    public:
+        explicit Connection(int fd) : fd(fd) {}
+        ~Connection();
+        Connection(const Connection &) = delete;
+        Connection &operator=(const Connection &) = delete;
+
+        int get_fd() const { return this->fd; }
+
+        // Next line without its '\n'. False once the peer closed the connection.
+        bool read_line(std::string &line);
+        // Exactly `size` bytes. False if the connection ends first.
+        bool read_bytes(char *data, size_t size);
+        bool write_bytes(const char *data, size_t size);
+        bool write_line(const std::string &line);
+    };
+
+    // Listening Unix domain socket at `path`, replacing a stale socket file left there. Throws on failure.
+    int listen_unix(std::string path);
+    // Connected descriptor, or -1 if nobody listens at `path`.
+    int connect_unix(std::string path);
+    // Same for TCP. An empty host listens on every interface.
+    int listen_tcp(std::string host, int port);
+    int connect_tcp(std::string host, int port);
+
+    // Addresses are `host:port` (or `:port`) for TCP and a socket path for Unix domain sockets.
+    bool is_tcp_address(std::string address);
+    int listen_address(std::string address);
+    int connect_address(std::string address);
+    // Blocks until a client connects to the listening descriptor; -1 on failure.
+    int accept_connection(int listener);
+    void close_socket(int fd);
+}
+
+#endif
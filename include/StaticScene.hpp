@@ -0,0 +1,207 @@
+#ifndef STATIC_SCENE_H
+#define STATIC_SCENE_H
+
+#include <cmath>
+#include <tuple>
+#include <typeinfo>
+#include <type_traits>
+#include <vector>
+
+#include "Objects.hpp"
+#include "Scene.hpp"
+#include "Timeline.hpp"
+
+using namespace atividades_cg_1::objects;
+using namespace atividades_cg_1::timeline;
+
+namespace atividades_cg_1::scene {
+
+    // Objects split by exact type: a list for each of Ts, and the objects of any other type.
+    template <typename... Ts>
+    class TypedObjects
+    {
+    protected:
+        // Calls visit(list) for the list of every type in Ts.
+        template <typename Visit>
+        void for_each_list(Visit &&visit)
+        {
+            std::apply([&](auto &... list) { (visit(list), ...); }, this->lists);
+        }
+
+        template <size_t I = 0>
+        void add_typed(Object *object)
+        {
+            if constexpr (I == sizeof...(Ts)) {
+                this->others.push_back(object);
+            } else {
+                using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+                // A subclass of T may override its intersection, so only objects of exactly T are listed as T.
+                if (typeid(*object) == typeid(T)) {
+                    std::get<I>(this->lists).push_back(static_cast<T *>(object));
+                } else {
+                    this->add_typed<I + 1>(object);
+                }
+            }
+        }
+
+    public:
+        std::tuple<std::vector<Ts *>...> lists;
+        std::vector<Object *> others;
+
+        size_t get_memory_usage()
+        {
+            size_t bytes = get_vector_memory(this->others);
+            this->for_each_list([&](auto &list) { bytes += get_vector_memory(list); });
+            return bytes;
+        }
+
+        void assign(const std::vector<Object *> &objects)
+        {
+            this->for_each_list([](auto &list) { list.clear(); });
+            this->others.clear();
+            for (Object *object : objects) {
+                this->add_typed(object);
+            }
+        }
+
+        // Closest valid hit of the ray, or an invalid intersection at INFINITY.
+        Intersection closest_hit(Ray &ray)
+        {
+            Intersection closest(INFINITY, false);
+            long tests = this->others.size();
+            // The qualified call T::get_intersection is bound at compile time: no vtable lookup, and inline
+            // tests (see Objects.hpp) are expanded in the loop over the list.
+            this->for_each_list([&](auto &list) {
+                using T = std::remove_pointer_t<typename std::decay_t<decltype(list)>::value_type>;
+                tests += list.size();
+                for (T *object : list) {
+                    Intersection intersection = object->T::get_intersection(ray);
+                    if (intersection.is_valid && intersection.time < closest.time) {
+                        closest = intersection;
+                    }
+                }
+            });
+            for (Object *object : this->others) {
+                Intersection intersection = object->get_intersection(ray);
+                if (intersection.is_valid && intersection.time < closest.time) {
+                    closest = intersection;
+                }
+            }
+            count_intersection_tests(tests);
+            return closest;
+        }
+
+        // First object other than `target` and `skip` with a valid hit closer than max_time, or NULL.
+        Object *find_blocker(Ray &ray, Object *target, Object *skip, real max_time)
+        {
+            Object *blocker = NULL;
+            long tests = 0;
+            auto blocks = [&](Intersection &intersection) {
+                tests++;
+                return intersection.is_valid && intersection.intersepted_object != target && intersection.time < max_time;
+            };
+            this->for_each_list([&](auto &list) {
+                using T = std::remove_pointer_t<typename std::decay_t<decltype(list)>::value_type>;
+                for (size_t i = 0; blocker == NULL && i < list.size(); i++) {
+                    T *object = list[i];
+                    if (object == skip || object == target) continue;
+                    Intersection intersection = object->T::get_intersection(ray);
+                    if (blocks(intersection)) {
+                        blocker = object;
+                    }
+                }
+            });
+            for (size_t i = 0; blocker == NULL && i < this->others.size(); i++) {
+                Object *object = this->others[i];
+                if (object == skip || object == target) continue;
+                Intersection intersection = object->get_intersection(ray);
+                if (blocks(intersection)) {
+                    blocker = object;
+                }
+            }
+            count_intersection_tests(tests);
+            return blocker;
+        }
+    };
+
+    // Scene whose primary and shadow rays test the objects of the types Ts with static dispatch. Objects of
+    // other types still work, through the virtual calls of Scene; so do reflection and refraction rays, which
+    // are few next to the primary and shadow rays.
+    //
+    // The typed lists are rebuilt by prepare_frame from the objects and the tile candidates of the frame, so
+    // objects must be pushed before it runs, as with the culling of Scene.
+    template <typename... Ts>
+    class StaticScene : public Scene
+    {
+    protected:
+        TypedObjects<Ts...> all_objects;
+        std::vector<TypedObjects<Ts...>> tile_objects;
+        bool typed_objects_ready = false;
+
+        bool is_occluded(Ray ray_light, Object *target, int target_primitive, Object *&last_occluder) override
+        {
+            if (!this->typed_objects_ready) {
+                return Scene::is_occluded(ray_light, target, target_primitive, last_occluder);
+            }
+
+            Intersection own;
+            if (!this->find_target_hit(ray_light, target, target_primitive, own)) {
+                return true;
+            }
+            if (last_occluder != NULL && last_occluder != target) {
+                Intersection intersection = last_occluder->get_intersection(ray_light);
+                count_intersection_tests(1);
+                if (intersection.is_valid && intersection.intersepted_object != target && intersection.time < own.time) {
+                    return true;
+                }
+            }
+            Object *blocker = this->all_objects.find_blocker(ray_light, target, last_occluder, own.time);
+            if (blocker != NULL) {
+                last_occluder = blocker;
+                return true;
+            }
+            return false;
+        }
+
+    public:
+        using Scene::Scene;
+
+        void prepare_frame(Window &window) override
+        {
+            Scene::prepare_frame(window);
+            TimelineScope scope("split objects by type");
+
+            this->all_objects.assign(this->objects);
+            this->tile_objects.resize(this->tile_candidates.size());
+            for (size_t i = 0; i < this->tile_candidates.size(); i++) {
+                this->tile_objects[i].assign(this->tile_candidates[i]);
+            }
+            this->typed_objects_ready = true;
+        }
+
+        MemoryUsage get_memory_usage() override
+        {
+            MemoryUsage usage = Scene::get_memory_usage();
+            usage.add(MEMORY_ACCELERATION, this->all_objects.get_memory_usage() + get_vector_memory(this->tile_objects));
+            for (auto &typed : this->tile_objects) {
+                usage.add(MEMORY_ACCELERATION, typed.get_memory_usage());
+            }
+            return usage;
+        }
+
+        void trace_pixel(Ray ray, ShadingBatch &batch, int row, int col) override
+        {
+            Intersection closest = this->tile_objects[(row / CULLING_TILE_SIZE) * this->tile_cols + col / CULLING_TILE_SIZE].closest_hit(ray);
+            if (!closest.is_valid) {
+                batch.add_miss();
+                return;
+            }
+            this->add_hit(ray, closest, batch, batch.last_occluders);
+        }
+    };
+
+    // The object types that scene files create.
+    using ProductionScene = StaticScene<Sphere, Plan, Triangle, Mesh, CompactMesh>;
+}
+
+#endif
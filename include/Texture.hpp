@@ -0,0 +1,70 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Color.hpp"
+
+using namespace atividades_cg_1::color;
+
+namespace atividades_cg_1::texture {
+
+    // Texels per side of the square blocks a texture level is stored in.
+    const int TEXTURE_TILE_SIZE = 8;
+
+    // Image texture with its mip levels, each half the size of the previous one down to 1x1.
+    //
+    // Levels are stored in TEXTURE_TILE_SIZE x TEXTURE_TILE_SIZE blocks, row by row inside a block and block by
+    // block along the level, so the four texels of a bilinear fetch are almost always in the same 192 bytes
+    // instead of two rows that are a whole image width apart. Coordinates repeat outside [0, 1).
+    class Texture
+    {
+    protected:
+        class MipLevel
+        {
+        public:
+            int width;
+            int height;
+            int tiles_per_row;
+            size_t offset; // First texel of the level in texels.
+        };
+
+        std::vector<MipLevel> levels;
+        std::vector<Color> texels;
+
+        const Color &texel(const MipLevel &level, int x, int y) const
+        {
+            size_t tile = (size_t)(y / TEXTURE_TILE_SIZE) * level.tiles_per_row + x / TEXTURE_TILE_SIZE;
+            return this->texels[level.offset + tile * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE
+                                + (y % TEXTURE_TILE_SIZE) * TEXTURE_TILE_SIZE + x % TEXTURE_TILE_SIZE];
+        }
+        Color &texel(const MipLevel &level, int x, int y)
+        {
+            return const_cast<Color &>(static_cast<const Texture *>(this)->texel(level, x, y));
+        }
+        // Bilinear filtering inside one level, accumulated in 0 to 255 units.
+        void bilinear(const MipLevel &level, real u, real v, real *rgb) const;
+
+    public:
+        // `pixels` are rows from top to bottom, like Window::windows_colors; v grows downwards.
+        Texture(const std::vector<std::vector<Color>> &pixels);
+
+        // Binary PPM (P6) file. Throws when it cannot be read.
+        static std::shared_ptr<Texture> load(std::string file_path);
+
+        int get_width() const { return this->levels[0].width; }
+        int get_height() const { return this->levels[0].height; }
+        int get_level_count() const { return this->levels.size(); }
+        Color get_texel(int level, int x, int y) const { return this->texel(this->levels[level], x, y); }
+        // Bytes of the texels of every level.
+        size_t get_memory_usage() const { return this->texels.capacity() * sizeof(Color) + this->levels.capacity() * sizeof(MipLevel); }
+
+        // Trilinear sample at (u, v). `footprint` is the width of the pixel on the surface in texture repeats:
+        // the level where it covers about one texel is used, so distant surfaces average instead of aliasing.
+        Color sample(real u, real v, real footprint) const;
+    };
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace atividades_cg_1::timeline {
+
+    // A finished span of work: `name` must outlive the timeline (a string literal).
+    class TimelineEvent
+    {
+    public:
+        const char *name;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+    };
+
+    // Ring of the newest events of one thread. Only its thread writes, without locks; once full, every event
+    // overwrites the oldest one.
+    class ThreadTimeline
+    {
+    public:
+        static const size_t CAPACITY = 1 << 16;
+
+        int id;
+        std::string name;
+        std::vector<TimelineEvent> events;
+        std::atomic<uint64_t> written{0};
+
+        ThreadTimeline(int id) : id(id), name("thread " + std::to_string(id)), events(CAPACITY) {}
+
+        void record(const TimelineEvent &event)
+        {
+            uint64_t count = this->written.load(std::memory_order_relaxed);
+            this->events[count & (CAPACITY - 1)] = event;
+            this->written.store(count + 1, std::memory_order_release);
+        }
+    };
+
+    // Off until enable_timeline; while off, a TimelineScope costs one relaxed load.
+    inline std::atomic<bool> timeline_enabled{false};
+
+    void enable_timeline();
+    // Nanoseconds since enable_timeline.
+    uint64_t timeline_clock();
+    // Appends to the calling thread's ring. The first event of a thread takes a ring from a shared pool (the
+    // only lock), which it gives back when the thread ends: short lived threads, like the tracing threads of
+    // each frame, reuse the same few rings, each shown as one row of the timeline.
+    void record_event(const char *name, uint64_t start_ns, uint64_t end_ns);
+    // Row name of the calling thread's ring.
+    void name_thread(const std::string &name);
+
+    // Writes every recorded event in the Trace Event Format, as complete ("X") events that about:tracing and
+    // Perfetto (ui.perfetto.dev) open. Returns the number of events lost to full rings.
+    uint64_t write_timeline(const std::string &path);
+
+    // Calls write_timeline(path) when destroyed, unless path is empty, and reports the file on the console.
+    class TimelineFile
+    {
+    public:
+        std::string path;
+
+        ~TimelineFile();
+    };
+
+    // Records the span from its construction to its destruction, when the timeline is enabled.
+    class TimelineScope
+    {
+    protected:
+        const char *name;
+        uint64_t start = 0;
+        bool active;
+
+    public:
+        TimelineScope(const char *name) : name(name), active(timeline_enabled.load(std::memory_order_relaxed))
+        {
+            if (this->active) this->start = timeline_clock();
+        }
+
+        ~TimelineScope()
+        {
+            this->end();
+        }
+
+        // Ends the span before the scope does.
+        void end()
+        {
+            if (!this->active) return;
+            record_event(this->name, this->start, timeline_clock());
+            this->active = false;
+        }
+
+        TimelineScope(const TimelineScope &) = delete;
+        TimelineScope &operator=(const TimelineScope &) = delete;
+    };
+}
+
+#endif
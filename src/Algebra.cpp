@@ -2,17 +2,23 @@
 
  #include <iostream>
  #include <stdexcept>
+ #include <algorithm>
+ #include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
 using namespace atividades_cg_1::algebra;
 
 
-Vector3d Vector3d::multiply(float value) {
+Vector3d Vector3d::multiply(real value) {
     return Vector3d(this->x * value, this->y * value, this->z * value);
 }
 
 
-Vector3d Vector3d::divide(float value) {
+Vector3d Vector3d::divide(real value) {
     return this->multiply(1 / value);
 }
 
@@ -30,13 +36,13 @@ Vector3d Vector3d::minus(Vector3d v)
 }
 
 
-float Vector3d::size()
+real Vector3d::size()
 {
     return sqrt(std::pow(this->x, 2) + std::pow(this->y, 2) + std::pow(this->z, 2));
 }
 
 
-float Vector3d::scalar_product(Vector3d v)
+real Vector3d::scalar_product(Vector3d v)
 {
     return (this->x * v.x + this->y * v.y + this->z * v.z);
 }
@@ -48,9 +54,9 @@ void Vector3d::print() {
 
 
 Vector3d Vector3d::vectorial_product(Vector3d other) {
-    float new_x = this->y * other.z - this->z * other.y;
-    float new_y = this->z * other.x - this->x * other.z;
-    float new_z = this->x * other.y - this->y * other.x;
+    real new_x = this->y * other.z - this->z * other.y;
+    real new_y = this->z * other.x - this->x * other.z;
+    real new_z = this->x * other.y - this->y * other.x;
     return Vector3d(new_x, new_y, new_z);
 }
 
@@ -62,14 +68,14 @@ Vector3d Vector3d::get_vector_normalized()
 
 
 bool Vector3d::equals(Vector3d other) {
-    float factor = 1e-12;
+    real factor = 1e-12;
     return std::abs(this->x - other.x) <= factor 
                 && std::abs(this->y - other.y) <= factor && std::abs(this->z - other.z) <= factor;
 }
 
 
 Matrix Vector3d::as_matrix() {
-    vector<vector<float>> result(4, vector<float>(1, 0));
+    vector<vector<real>> result(4, vector<real>(1, 0));
     result[0][0] = this->x;
     result[1][0] = this->y;
     result[2][0] = this->z;
@@ -79,7 +85,7 @@ Matrix Vector3d::as_matrix() {
 }
 
 
-float Ray::size()
+real Ray::size()
 {
     return (p2.minus(p1)).size();
 }
@@ -96,9 +102,9 @@ Matrix Matrix::sum(Matrix other) {
         throw runtime_error("Tamanho das matrizes é incompatível.");
     }
 
-    vector<vector<float>> new_matrix = this->matrix;
-    for (int i = 0; i < new_matrix.size(); i++) {
-        for (int j = 0; j < new_matrix.size(); j++) {
+    vector<vector<real>> new_matrix = this->matrix;
+    for (size_t i = 0; i < new_matrix.size(); i++) {
+        for (size_t j = 0; j < new_matrix.size(); j++) {
             new_matrix[i][j] += other.matrix[i][j];
         }
     }
@@ -111,9 +117,9 @@ Matrix Matrix::minus(Matrix other) {
         throw runtime_error("Tamanho das matrizes é incompatível.");
     }
     
-    vector<vector<float>> new_matrix = this->matrix;
-    for (int i = 0; i < new_matrix.size(); i++) {
-        for (int j = 0; j < new_matrix.size(); j++) {
+    vector<vector<real>> new_matrix = this->matrix;
+    for (size_t i = 0; i < new_matrix.size(); i++) {
+        for (size_t j = 0; j < new_matrix.size(); j++) {
             new_matrix[i][j] -= other.matrix[i][j];
         }
     }
@@ -122,10 +128,10 @@ Matrix Matrix::minus(Matrix other) {
 }
 
 
-Matrix Matrix::multiply_scalar(float v) {
-    vector<vector<float>> new_matrix = this->matrix;
-    for (int i = 0; i < new_matrix.size(); i++) {
-        for (int j = 0; j < new_matrix.size(); j++) {
+Matrix Matrix::multiply_scalar(real v) {
+    vector<vector<real>> new_matrix = this->matrix;
+    for (size_t i = 0; i < new_matrix.size(); i++) {
+        for (size_t j = 0; j < new_matrix.size(); j++) {
             new_matrix[i][j] *= v;
         }
     }
@@ -134,8 +140,8 @@ Matrix Matrix::multiply_scalar(float v) {
 }
 
 
-Matrix Matrix::divide_scalar(float v) {
-    Matrix::multiply_scalar(1/v);
+Matrix Matrix::divide_scalar(real v) {
+    return Matrix::multiply_scalar(1/v);
 }
 
 
@@ -147,15 +153,15 @@ Matrix Matrix::multiply(Matrix other) {
     int n = this->dimension.n;
     int m = other.dimension.m;
 
-    // vector<vector<float>> result(n, vector<float>(m, 0));
-    vector<vector<float>> result;
+    // vector<vector<real>> result(n, vector<real>(m, 0));
+    vector<vector<real>> result;
 
     for (int i = 0; i < n; i++) { 
-        vector<float> row;
+        vector<real> row;
         for (int j = 0; j < m; j++) {
             // row.push_back(0);
             // result[i][j] = 0; 
-            float acc = 0; 
+            real acc = 0; 
   
             for (int k = 0; k < other.dimension.n; k++) { 
                 acc += this->matrix[i][k] * other.matrix[k][j]; 
@@ -189,6 +195,154 @@ Vector3d Vector3d::apply_transformation(Matrix transformation) {
     return transformation.multiply(this->as_matrix()).as_vector();
 }
 
+Vector3d Vector3d::apply_transformation(const Matrix4 &transformation) {
+    return transformation.transform(*this);
+}
+
+Matrix4::Matrix4() {
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            this->m[i][j] = i == j ? 1 : 0;
+        }
+    }
+}
+
+Matrix4::Matrix4(const Matrix &matrix) {
+    if (matrix.dimension.n != 4 || matrix.dimension.m != 4) {
+        throw domain_error("A matriz de transformação deve ser 4x4.");
+    }
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            this->m[i][j] = matrix.matrix[i][j];
+        }
+    }
+}
+
+bool Matrix4::is_identity() const {
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            if (this->m[i][j] != (i == j ? 1 : 0)) return false;
+        }
+    }
+    return true;
+}
+
+Matrix4 Matrix4::multiply(const Matrix4 &other) const {
+    Matrix4 result;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            real acc = 0;
+            for (int k = 0; k < 4; k++) {
+                acc += this->m[i][k] * other.m[k][j];
+            }
+            result.m[i][j] = acc;
+        }
+    }
+    return result;
+}
+
+Vector3d Matrix4::transform(const Vector3d &v) const {
+    // Same accumulation order as Matrix::multiply, so both paths give identical results.
+    real in[4] = {v.x, v.y, v.z, (real)v.is_point};
+    real out[4];
+    for (int i = 0; i < 4; i++) {
+        real acc = 0;
+        for (int k = 0; k < 4; k++) {
+            acc += this->m[i][k] * in[k];
+        }
+        out[i] = acc;
+    }
+    return Vector3d(out[0], out[1], out[2], out[3]);
+}
+
+#if defined(__SSE2__)
+#ifdef CENARIO_DOUBLE_PRECISION
+typedef __m128d simd_real;
+static const size_t SIMD_WIDTH = 2;
+static inline simd_real simd_load(const real *p) { return _mm_loadu_pd(p); }
+static inline void simd_store(real *p, simd_real v) { _mm_storeu_pd(p, v); }
+static inline simd_real simd_set(real v) { return _mm_set1_pd(v); }
+static inline simd_real simd_add(simd_real a, simd_real b) { return _mm_add_pd(a, b); }
+static inline simd_real simd_mul(simd_real a, simd_real b) { return _mm_mul_pd(a, b); }
+#else
+typedef __m128 simd_real;
+static const size_t SIMD_WIDTH = 4;
+static inline simd_real simd_load(const real *p) { return _mm_loadu_ps(p); }
+static inline void simd_store(real *p, simd_real v) { _mm_storeu_ps(p, v); }
+static inline simd_real simd_set(real v) { return _mm_set1_ps(v); }
+static inline simd_real simd_add(simd_real a, simd_real b) { return _mm_add_ps(a, b); }
+static inline simd_real simd_mul(simd_real a, simd_real b) { return _mm_mul_ps(a, b); }
+#endif
+#endif
+
+// Points [begin, end) of the arrays, with the fourth coordinate w. Every row is summed in the same order as
+// Matrix4::transform (x, y, z, then w), so both give bit identical results.
+static void transform_range(const Matrix4 &t, real w, real *x, real *y, real *z, size_t begin, size_t end)
+{
+    real offset[3];
+    for (int r = 0; r < 3; r++) {
+        offset[r] = t.m[r][3] * w;
+    }
+
+    size_t i = begin;
+#if defined(__SSE2__)
+    simd_real m[3][3];
+    simd_real o[3];
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            m[r][c] = simd_set(t.m[r][c]);
+        }
+        o[r] = simd_set(offset[r]);
+    }
+
+    for (; i + SIMD_WIDTH <= end; i += SIMD_WIDTH) {
+        simd_real vx = simd_load(x + i), vy = simd_load(y + i), vz = simd_load(z + i);
+        simd_real out[3];
+        for (int r = 0; r < 3; r++) {
+            out[r] = simd_add(simd_add(simd_add(simd_mul(m[r][0], vx), simd_mul(m[r][1], vy)), simd_mul(m[r][2], vz)), o[r]);
+        }
+        simd_store(x + i, out[0]);
+        simd_store(y + i, out[1]);
+        simd_store(z + i, out[2]);
+    }
+#endif
+
+    for (; i < end; i++) {
+        real vx = x[i], vy = y[i], vz = z[i];
+        x[i] = t.m[0][0] * vx + t.m[0][1] * vy + t.m[0][2] * vz + offset[0];
+        y[i] = t.m[1][0] * vx + t.m[1][1] * vy + t.m[1][2] * vz + offset[1];
+        z[i] = t.m[2][0] * vx + t.m[2][1] * vy + t.m[2][2] * vz + offset[2];
+    }
+}
+
+static void transform_batch(const Matrix4 &t, real w, real *x, real *y, real *z, size_t count, int thread_count)
+{
+    if (thread_count <= 0) thread_count = max(1u, thread::hardware_concurrency());
+    size_t chunk_count = min((size_t)thread_count, count / TRANSFORM_MIN_POINTS_PER_THREAD + 1);
+    size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+    // The calling thread takes the first chunk.
+    vector<thread> threads;
+    for (size_t c = 1; c < chunk_count; c++) {
+        size_t begin = c * chunk_size;
+        size_t end = min(count, begin + chunk_size);
+        threads.push_back(thread(transform_range, cref(t), w, x, y, z, begin, end));
+    }
+    transform_range(t, w, x, y, z, 0, min(count, chunk_size));
+
+    for (auto &worker : threads) {
+        worker.join();
+    }
+}
+
+void Matrix4::transform_points(real *x, real *y, real *z, size_t count, int thread_count) const {
+    transform_batch(*this, 1, x, y, z, count, thread_count);
+}
+
+void Matrix4::transform_directions(real *x, real *y, real *z, size_t count, int thread_count) const {
+    transform_batch(*this, 0, x, y, z, count, thread_count);
+}
+
 bool MatrixDimension::equals(MatrixDimension other) {
     return (this->n == other.n && this->m == other.m);
 }
@@ -199,7 +353,7 @@ bool MatrixDimension::can_multiply(MatrixDimension other) {
 }
 
 
-Matrix MatrixTransformations::translation(float tx, float ty, float tz) {
+Matrix MatrixTransformations::translation(real tx, real ty, real tz) {
     /*
     1 0 0 tx
     0 1 0 ty
@@ -207,12 +361,12 @@ Matrix MatrixTransformations::translation(float tx, float ty, float tz) {
     0 0 0 1
     */
 
-    vector<vector<float>> result{vector<float>{1,0,0,tx}, vector<float>{0,1,0,ty}, vector<float>{0,0,1,tz}, vector<float>{0,0,0,1}};
+    vector<vector<real>> result{vector<real>{1,0,0,tx}, vector<real>{0,1,0,ty}, vector<real>{0,0,1,tz}, vector<real>{0,0,0,1}};
     return Matrix(result);
 }
 
 
-Matrix MatrixTransformations::scale(Vector3d fixed_point, float sx, float sy, float sz) {
+Matrix MatrixTransformations::scale(Vector3d fixed_point, real sx, real sy, real sz) {
     /*
     Sx 0 0  (1-Sx)x
     0 Sy 0  (1-Sy)y
@@ -220,22 +374,22 @@ Matrix MatrixTransformations::scale(Vector3d fixed_point, float sx, float sy, fl
     0  0 0     1
     */
 
-    vector<vector<float>> result{vector<float>{sx,0,0,(1-sx)*fixed_point.x}, vector<float>{0,sy,0,(1-sy)*fixed_point.y}, vector<float>{0,0,sz,(1-sz)*fixed_point.z}, vector<float>{0,0,0,1}};
+    vector<vector<real>> result{vector<real>{sx,0,0,(1-sx)*fixed_point.x}, vector<real>{0,sy,0,(1-sy)*fixed_point.y}, vector<real>{0,0,sz,(1-sz)*fixed_point.z}, vector<real>{0,0,0,1}};
     return Matrix(result);
 }
 
-Matrix MatrixTransformations::rotation(float theta, int axis) {
-    vector<vector<float>> result;
+Matrix MatrixTransformations::rotation(real theta, int axis) {
+    vector<vector<real>> result;
     switch (axis)
     {
     case X_AXIS:
-        result = {vector<float>{1,0,0,0}, vector<float>{0, cos(theta), -sin(theta), 0}, {0, sin(theta), cos(theta), 0}, {0, 0, 0, 1}};
+        result = {vector<real>{1,0,0,0}, vector<real>{0, cos(theta), -sin(theta), 0}, {0, sin(theta), cos(theta), 0}, {0, 0, 0, 1}};
         break;
     case Y_AXIS:
-        result = {vector<float>{cos(theta),0,sin(theta),0}, vector<float>{0, 1, 0, 0}, {-sin(theta), 0, cos(theta), 0}, {0, 0, 0, 1}};
+        result = {vector<real>{cos(theta),0,sin(theta),0}, vector<real>{0, 1, 0, 0}, {-sin(theta), 0, cos(theta), 0}, {0, 0, 0, 1}};
         break;
     case Z_AXIS:
-        result = {vector<float>{cos(theta), -sin(theta), 0, 0}, vector<float>{sin(theta), cos(theta), 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+        result = {vector<real>{cos(theta), -sin(theta), 0, 0}, vector<real>{sin(theta), cos(theta), 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
         break;
     default:
         throw runtime_error("Eixo de rotação inválido.");
@@ -245,18 +399,18 @@ Matrix MatrixTransformations::rotation(float theta, int axis) {
 }
 
 
-Matrix MatrixTransformations::rotation(float sin_theta, float cos_theta, int axis) {
-    vector<vector<float>> result;
+Matrix MatrixTransformations::rotation(real sin_theta, real cos_theta, int axis) {
+    vector<vector<real>> result;
     switch (axis)
     {
     case X_AXIS:
-        result = {vector<float>{1,0,0,0}, vector<float>{0, cos_theta, -sin_theta, 0}, {0, sin_theta, cos_theta, 0}, {0, 0, 0, 1}};
+        result = {vector<real>{1,0,0,0}, vector<real>{0, cos_theta, -sin_theta, 0}, {0, sin_theta, cos_theta, 0}, {0, 0, 0, 1}};
         break;
     case Y_AXIS:
-        result = {vector<float>{cos_theta,0,sin_theta,0}, vector<float>{0, 1, 0, 0}, {-sin_theta, 0, cos_theta, 0}, {0, 0, 0, 1}};
+        result = {vector<real>{cos_theta,0,sin_theta,0}, vector<real>{0, 1, 0, 0}, {-sin_theta, 0, cos_theta, 0}, {0, 0, 0, 1}};
         break;
     case Z_AXIS:
-        result = {vector<float>{cos_theta, -sin_theta, 0, 0}, vector<float>{sin_theta, cos_theta, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+        result = {vector<real>{cos_theta, -sin_theta, 0, 0}, vector<real>{sin_theta, cos_theta, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
         break;
     default:
         throw runtime_error("Eixo de rotação inválido.");
@@ -266,7 +420,7 @@ Matrix MatrixTransformations::rotation(float sin_theta, float cos_theta, int axi
 }
 
 
-Matrix MatrixTransformations::arbitrary_rotation(float theta, Vector3d p1, Vector3d p2) {
+Matrix MatrixTransformations::arbitrary_rotation(real theta, Vector3d p1, Vector3d p2) {
     Vector3d u = p2.minus(p1).get_vector_normalized();
 
     // First step - translate p1 to origin.
@@ -274,17 +428,15 @@ Matrix MatrixTransformations::arbitrary_rotation(float theta, Vector3d p1, Vecto
 
     // Second step - rotate in x, by theta_x
     Vector3d u1 = Vector3d(0, u.y, u.z);
-    float d = u1.size();
-    float cos_x = u1.z / d;
-    float sin_x = u1.y / d;
+    real d = u1.size();
+    real cos_x = u1.z / d;
+    real sin_x = u1.y / d;
 
     Matrix second_matrix = MatrixTransformations::rotation(sin_x, cos_x, X_AXIS);
 
     // Third step - rotate in y, by theta_y
-    Vector3d u2 = Vector3d(u.x, 0, d);
-
-    float cos_y = d;
-    float sin_y = -u.x;
+    real cos_y = d;
+    real sin_y = -u.x;
 
     Matrix third_matrix = MatrixTransformations::rotation(-sin_y, cos_y, Y_AXIS);
 
@@ -298,4 +450,59 @@ Matrix MatrixTransformations::arbitrary_rotation(float theta, Vector3d p1, Vecto
 
     Matrix result = seventh_matrix.multiply(sixth_matrix).multiply(fifth_matrix).multiply(fourth_matrix).multiply(third_matrix).multiply(second_matrix).multiply(first_matrix);
     return result;
+}
+
+
+BoundingBox BoundingBox::infinite_box() {
+    BoundingBox box(Vector3d(-INFINITY, -INFINITY, -INFINITY), Vector3d(INFINITY, INFINITY, INFINITY));
+    box.infinite = true;
+    return box;
+}
+
+
+bool BoundingBox::is_empty() {
+    return this->min_point.x > this->max_point.x;
+}
+
+
+void BoundingBox::expand(Vector3d p) {
+    this->min_point = Vector3d(std::min(this->min_point.x, p.x), std::min(this->min_point.y, p.y), std::min(this->min_point.z, p.z));
+    this->max_point = Vector3d(std::max(this->max_point.x, p.x), std::max(this->max_point.y, p.y), std::max(this->max_point.z, p.z));
+}
+
+
+void BoundingBox::merge(BoundingBox other) {
+    if (other.infinite) {
+        *this = other;
+        return;
+    }
+    if (this->infinite || other.is_empty()) return;
+
+    this->expand(other.min_point);
+    this->expand(other.max_point);
+}
+
+
+bool BoundingBox::intersects_ray(Ray ray) {
+    if (this->infinite) return true;
+    if (this->is_empty()) return false;
+
+    Vector3d dr = ray.get_dr();
+    real origin[3] = {ray.p1.x, ray.p1.y, ray.p1.z};
+    real direction[3] = {dr.x, dr.y, dr.z};
+    real box_min[3] = {this->min_point.x, this->min_point.y, this->min_point.z};
+    real box_max[3] = {this->max_point.x, this->max_point.y, this->max_point.z};
+
+    real t_min = 0;
+    real t_max = INFINITY;
+    for (int axis = 0; axis < 3; axis++) {
+        // Division by zero gives +-inf, which the comparisons below handle.
+        real inverse = 1 / direction[axis];
+        real t1 = (box_min[axis] - origin[axis]) * inverse;
+        real t2 = (box_max[axis] - origin[axis]) * inverse;
+        // NaN (origin on the slab border with a parallel ray) leaves the interval untouched.
+        t_min = std::max(t_min, std::min(t1, t2));
+        t_max = std::min(t_max, std::max(t1, t2));
+    }
+    return t_min <= t_max;
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include <thread>
+
+#include "Animation.hpp"
+#include "Concurrency.hpp"
+#include "Render.hpp"
+
+using namespace std;
+using namespace atividades_cg_1::animation;
+using namespace atividades_cg_1::concurrency;
+using namespace atividades_cg_1::render;
+
+
+Camera Animation::camera_at(int frame, Camera base)
+{
+    Vector3d eye = base.eye;
+    Vector3d look_at = base.look_at;
+
+    switch (this->camera_mode)
+    {
+    case CAMERA_TURNTABLE:
+    {
+        real angle = 2 * M_PI * frame / this->frame_count;
+        eye = this->target.sum(Vector3d(this->radius * sin(angle), this->height, this->radius * cos(angle)));
+        look_at = this->target;
+        break;
+    }
+    case CAMERA_FLYTHROUGH:
+    {
+        real progress = this->frame_count > 1 ? frame / (real)(this->frame_count - 1) : 0;
+        eye = this->from.sum(this->to.minus(this->from).multiply(progress));
+        look_at = this->target;
+        break;
+    }
+    default:
+        break;
+    }
+
+    Window &window = base.window;
+    Camera camera(look_at, eye, base.view_up, base.focal_distance, window.width, window.height, window.cols, window.rows);
+    // Keep the window plane where the base camera had it, so the field of view does not change as the eye moves.
+    camera.window.center = window.center;
+    return camera;
+}
+
+
+void atividades_cg_1::animation::render_animation(Scene &scene, Animation &animation, FrameSink sink, RenderSettings settings, int buffer_count)
+{
+    Camera base = scene.get_camera();
+
+    vector<Window> buffers(buffer_count, base.window);
+    BoundedQueue<Window *> free_buffers(buffer_count);
+    BoundedQueue<pair<int, Window *>> finished_frames(buffer_count);
+    for (auto &buffer : buffers) {
+        free_buffers.push(&buffer);
+    }
+
+    // The tracer owns the scene while the animation runs; the calling thread only touches finished buffers.
+    vector<ObjectTransformation> per_frame;
+    for (auto &object_animation : animation.object_animations) {
+        per_frame.push_back(ObjectTransformation(object_animation.object_index, object_animation.per_frame_transformation));
+    }
+
+    thread tracer([&]() {
+        for (int frame = 0; frame < animation.frame_count; frame++)
+        {
+            Window *buffer;
+            if (!free_buffers.pop(buffer)) break;
+
+            if (frame > 0) {
+                scene.transform_objects(per_frame);
+            }
+            scene.set_camera(animation.camera_at(frame, base));
+            render_frame(scene, *buffer, settings);
+
+            if (!finished_frames.push({frame, buffer})) break;
+        }
+        finished_frames.close();
+    });
+
+    pair<int, Window *> finished;
+    while (finished_frames.pop(finished))
+    {
+        if (!sink(finished.first, *finished.second)) {
+            free_buffers.close();
+            finished_frames.close();
+            break;
+        }
+        free_buffers.push(finished.second);
+    }
+
+    tracer.join();
+}
@@ -4,8 +4,8 @@
 
 using namespace atividades_cg_1::camera;
 
-Camera::Camera(Vector3d look_at, Vector3d eye, Vector3d view_up, float d, float width,
-               float height, int cols, int rows) : look_at(look_at), eye(eye), focal_distance(d)
+Camera::Camera(Vector3d look_at, Vector3d eye, Vector3d view_up, real d, real width,
+               real height, int cols, int rows) : look_at(look_at), eye(eye), focal_distance(d)
 {
     this->view_up = view_up;
     this->window = Window(width, height, cols, rows, eye.x, eye.y, eye.z - d);
@@ -14,29 +14,39 @@ Camera::Camera(Vector3d look_at, Vector3d eye, Vector3d view_up, float d, float
     this->ic = view_up.vectorial_product(kc).get_vector_normalized();
     this->jc = kc.vectorial_product(ic);
 
-    this->camera_to_world = new Matrix(vector<vector<float>>{
-        vector<float>{this->ic.x, this->ic.y, this->ic.z, - this->ic.scalar_product(eye)},
-        vector<float>{this->jc.x, this->jc.y, this->jc.z, - this->jc.scalar_product(eye)},
-        vector<float>{this->kc.x, this->kc.y, this->kc.z, - this->kc.scalar_product(eye)},
-        vector<float>{0,0,0,1.0}
+    this->camera_to_world = new Matrix(vector<vector<real>>{
+        vector<real>{this->ic.x, this->ic.y, this->ic.z, - this->ic.scalar_product(eye)},
+        vector<real>{this->jc.x, this->jc.y, this->jc.z, - this->jc.scalar_product(eye)},
+        vector<real>{this->kc.x, this->kc.y, this->kc.z, - this->kc.scalar_product(eye)},
+        vector<real>{0,0,0,1.0}
         });
 
-    this->world_to_camera = new Matrix(vector<vector<float>>{
-        vector<float>{this->ic.x, this->jc.x, this->kc.x, eye.x},
-        vector<float>{this->ic.y, this->jc.y, this->kc.y, eye.y},
-        vector<float>{this->ic.z, this->jc.z, this->kc.z, eye.z},
-        vector<float>{0,0,0,1.0}
+    this->world_to_camera = new Matrix(vector<vector<real>>{
+        vector<real>{this->ic.x, this->jc.x, this->kc.x, eye.x},
+        vector<real>{this->ic.y, this->jc.y, this->kc.y, eye.y},
+        vector<real>{this->ic.z, this->jc.z, this->kc.z, eye.z},
+        vector<real>{0,0,0,1.0}
     });
 }
 
 
 Vector3d Camera::transform_vector_from_world_to_camera(Vector3d v) {
-    return this->camera_to_world->multiply(v.as_matrix()).as_vector();
+    return this->get_world_to_camera_matrix().transform(v);
 }
 
 
 Vector3d Camera::transform_vector_from_camera_to_world(Vector3d v) {
-    return this->world_to_camera->multiply(v.as_matrix()).as_vector();
+    return this->get_camera_to_world_matrix().transform(v);
+}
+
+
+Matrix4 Camera::get_world_to_camera_matrix() {
+    return Matrix4(*this->camera_to_world);
+}
+
+
+Matrix4 Camera::get_camera_to_world_matrix() {
+    return Matrix4(*this->world_to_camera);
 }
 
 
@@ -45,7 +55,7 @@ void Camera::destroy() {
     delete this->world_to_camera;
 }
 
-Window::Window(float width, float height, int cols, int rows, float x, float y, float z)
+Window::Window(real width, real height, int cols, int rows, real x, real y, real z)
 {
     this->width = width;
     this->height = height;
@@ -53,8 +63,8 @@ Window::Window(float width, float height, int cols, int rows, float x, float y,
     this->rows = rows;
     this->center = Vector3d(x, y, z);
 
-    this->dx = width / (float)cols;
-    this->dy = height / (float)rows;
+    this->dx = width / (real)cols;
+    this->dy = height / (real)rows;
 
     for (int i = 0; i < rows; i++)
     {
@@ -65,4 +75,51 @@ Window::Window(float width, float height, int cols, int rows, float x, float y,
         }
         this->windows_colors.push_back(row);
     }
+}
+
+
+Frustum::Frustum(real left, real right, real bottom, real top, real window_z)
+{
+    // The window is normally in front of the eye (negative z); flip everything if it is not.
+    real side = window_z < 0 ? 1 : -1;
+    this->normals[0] = Vector3d(-window_z, 0, left).multiply(side);
+    this->normals[1] = Vector3d(window_z, 0, -right).multiply(side);
+    this->normals[2] = Vector3d(0, -window_z, bottom).multiply(side);
+    this->normals[3] = Vector3d(0, window_z, -top).multiply(side);
+    this->normals[4] = Vector3d(0, 0, -side);
+}
+
+
+Frustum Frustum::from_window(Window &window)
+{
+    return Frustum::from_pixels(window, 0, window.cols, 0, window.rows);
+}
+
+
+Frustum Frustum::from_pixels(Window &window, int first_col, int last_col, int first_row, int last_row)
+{
+    real left = - window.width / 2 + window.dx * first_col;
+    real right = - window.width / 2 + window.dx * last_col;
+    real top = window.height / 2 - window.dy * first_row;
+    real bottom = window.height / 2 - window.dy * last_row;
+    return Frustum(left, right, bottom, top, window.center.z);
+}
+
+
+bool Frustum::is_outside(BoundingBox box)
+{
+    if (box.infinite) return false;
+    if (box.is_empty()) return true;
+
+    for (auto &n : this->normals)
+    {
+        // Corner of the box furthest along the inward normal.
+        Vector3d farthest(n.x >= 0 ? box.max_point.x : box.min_point.x,
+                          n.y >= 0 ? box.max_point.y : box.min_point.y,
+                          n.z >= 0 ? box.max_point.z : box.min_point.z);
+        if (n.scalar_product(farthest) < 0) {
+            return true;
+        }
+    }
+    return false;
 }
\ No newline at end of file
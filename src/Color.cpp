@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "Color.hpp"
 
 using namespace std;
@@ -5,7 +7,7 @@ using namespace atividades_cg_1::color;
 
 
 IntensityColor Color::to_color_normalized() const {
-    return {this->r / (float)255, this->g / (float)255, this->b / (float)255};
+    return {this->r / (real)255, this->g / (real)255, this->b / (real)255};
 };
 
 Color Color::multiply(IntensityColor intensity) const {
@@ -14,26 +16,23 @@ Color Color::multiply(IntensityColor intensity) const {
 
 
 IntensityColor::IntensityColor() = default;
-IntensityColor::IntensityColor(float r, float g, float b)
+IntensityColor::IntensityColor(real r, real g, real b)
 {
-    if (r > 1.0) r = 1.0;
-    if (g > 1.0) g = 1.0;
-    if (b > 1.0) b = 1.0;
-
-    this->r = r;
-    this->g = g;
-    this->b = b;
+    // std::min compiles to a min instruction instead of a branch per channel.
+    this->r = std::min(r, (real)1.0);
+    this->g = std::min(g, (real)1.0);
+    this->b = std::min(b, (real)1.0);
 }
 // Combines source intensity color with true color from object.
 IntensityColor IntensityColor::arroba_multiply(IntensityColor intensity)
 {
-    float r = this->r * intensity.r;
-    float g = this->g * intensity.g;
-    float b = this->b * intensity.b;
+    real r = this->r * intensity.r;
+    real g = this->g * intensity.g;
+    real b = this->b * intensity.b;
     return {r, g, b};
 }
 
-IntensityColor IntensityColor::multiply(float value)
+IntensityColor IntensityColor::multiply(real value)
 {
     return IntensityColor(this->r * value, this->g * value, this->b * value);
 }
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "Cost.hpp"
+
+using namespace std;
+using namespace atividades_cg_1::cost;
+
+
+int atividades_cg_1::cost::parse_cost_metric(string name)
+{
+    if (name == "intersections") return COST_INTERSECTIONS;
+    if (name == "shadows") return COST_SHADOW_TESTS;
+    if (name == "cycles") return COST_CYCLES;
+    throw runtime_error("Medida de custo desconhecida: " + name + " (intersections, shadows ou cycles)");
+}
+
+
+double PixelCost::get(int metric) const
+{
+    switch (metric)
+    {
+    case COST_INTERSECTIONS:
+        return this->intersection_tests;
+    case COST_SHADOW_TESTS:
+        return this->shadow_tests;
+    case COST_CYCLES:
+        return this->cycles;
+    default:
+        return 0;
+    }
+}
+
+
+void CostBuffers::resize(int cols, int rows)
+{
+    this->cols = cols;
+    this->rows = rows;
+    this->pixels.assign((size_t)cols * rows, PixelCost());
+}
+
+
+// Color of t in [0, 1], interpolated between the stops of an inferno like map.
+static Color heat_color(double t)
+{
+    static const double stops[5][3] = {{0, 0, 4}, {87, 16, 110}, {188, 55, 84}, {249, 142, 9}, {252, 255, 164}};
+    double position = std::min(std::max(t, 0.0), 1.0) * 4;
+    int i = std::min((int)position, 3);
+    double f = position - i;
+    auto channel = [&](int c) { return (uint8_t)std::lround(stops[i][c] + (stops[i + 1][c] - stops[i][c]) * f); };
+    return Color(channel(0), channel(1), channel(2));
+}
+
+
+double atividades_cg_1::cost::write_heatmap(const CostBuffers &costs, int metric, Window &window)
+{
+    if (costs.cols != window.cols || costs.rows != window.rows) {
+        throw runtime_error("Buffer de custos com tamanho diferente da janela");
+    }
+
+    vector<double> values;
+    values.reserve(costs.pixels.size());
+    for (const PixelCost &cost : costs.pixels) {
+        values.push_back(cost.get(metric));
+    }
+    vector<double> sorted = values;
+    size_t percentile = sorted.empty() ? 0 : (sorted.size() - 1) * 99 / 100;
+    nth_element(sorted.begin(), sorted.begin() + percentile, sorted.end());
+    double scale = sorted.empty() ? 0 : sorted[percentile];
+    if (scale <= 0) {
+        scale = sorted.empty() ? 0 : *max_element(sorted.begin(), sorted.end());
+    }
+
+    for (int y = 0; y < window.rows; y++) {
+        for (int x = 0; x < window.cols; x++) {
+            double value = values[(size_t)y * window.cols + x];
+            window.windows_colors[y][x] = heat_color(scale > 0 ? value / scale : 0);
+        }
+    }
+    return scale;
+}
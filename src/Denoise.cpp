@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "Denoise.hpp"
+
+using namespace std;
+using namespace atividades_cg_1::denoise;
+
+
+void GuideBuffers::resize(int cols, int rows)
+{
+    this->cols = cols;
+    this->rows = rows;
+    this->pixels.assign((size_t)cols * rows, PixelGuide());
+}
+
+
+void GuideBuffers::set(int row, int col, const ShadingBatch &batch, int index)
+{
+    PixelGuide &guide = this->pixels[(size_t)row * this->cols + col];
+    guide.object = batch.objects[index];
+    if (guide.object == NULL) return;
+
+    // Some objects (like Plan) return normals that are not unitary.
+    Vector3d normal = Vector3d(batch.nx[index], batch.ny[index], batch.nz[index]).get_vector_normalized();
+    guide.nx = normal.x;
+    guide.ny = normal.y;
+    guide.nz = normal.z;
+    guide.depth = std::sqrt(batch.px[index] * batch.px[index] + batch.py[index] * batch.py[index] + batch.pz[index] * batch.pz[index]);
+    guide.albedo_r = batch.albedo[index].r / (real)255;
+    guide.albedo_g = batch.albedo[index].g / (real)255;
+    guide.albedo_b = batch.albedo[index].b / (real)255;
+}
+
+
+// One pass over rows [first_row, last_row) with taps `step` pixels apart, from `source` to `target` (RGB in
+// [0, 1], three values per pixel).
+static void filter_rows(const GuideBuffers &guides, const DenoiseSettings &settings, int step, real color_sigma,
+                        const vector<real> &source, vector<real> &target, int first_row, int last_row)
+{
+    // Linear B-spline; the 5x5 B3 spline of the paper cost three times as much for a larger error on our scenes.
+    static const real kernel[3] = {(real)1 / 4, (real)1 / 2, (real)1 / 4};
+    const real color_scale = 1 / (color_sigma * color_sigma);
+    const real normal_scale = 1 / (settings.normal_sigma * settings.normal_sigma);
+    const real albedo_scale = 1 / (settings.albedo_sigma * settings.albedo_sigma);
+    const int cols = guides.cols, rows = guides.rows;
+
+    for (int y = first_row; y < last_row; y++)
+    {
+        for (int x = 0; x < cols; x++)
+        {
+            size_t p = (size_t)y * cols + x;
+            const PixelGuide &guide = guides.pixels[p];
+            if (guide.object == NULL) {
+                copy(&source[p * 3], &source[p * 3] + 3, &target[p * 3]);
+                continue;
+            }
+
+            real depth_scale = 1 / (guide.depth * settings.depth_sigma * step);
+            depth_scale *= depth_scale;
+            real r = 0, g = 0, b = 0, total = 0;
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                int qy = y + dy * step;
+                if (qy < 0 || qy >= rows) continue;
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    int qx = x + dx * step;
+                    if (qx < 0 || qx >= cols) continue;
+                    size_t q = (size_t)qy * cols + qx;
+                    const PixelGuide &other = guides.pixels[q];
+                    if (other.object != guide.object) continue;
+
+                    real cr = source[q * 3] - source[p * 3];
+                    real cg = source[q * 3 + 1] - source[p * 3 + 1];
+                    real cb = source[q * 3 + 2] - source[p * 3 + 2];
+                    real nx = other.nx - guide.nx, ny = other.ny - guide.ny, nz = other.nz - guide.nz;
+                    real dz = other.depth - guide.depth;
+                    real ar = other.albedo_r - guide.albedo_r, ag = other.albedo_g - guide.albedo_g, ab = other.albedo_b - guide.albedo_b;
+
+                    real exponent = (cr * cr + cg * cg + cb * cb) * color_scale
+                                  + (nx * nx + ny * ny + nz * nz) * normal_scale
+                                  + dz * dz * depth_scale
+                                  + (ar * ar + ag * ag + ab * ab) * albedo_scale;
+                    real weight = kernel[dy + 1] * kernel[dx + 1] * std::exp(-exponent);
+                    r += source[q * 3] * weight;
+                    g += source[q * 3 + 1] * weight;
+                    b += source[q * 3 + 2] * weight;
+                    total += weight;
+                }
+            }
+            // The center tap always counts, so total > 0.
+            target[p * 3] = r / total;
+            target[p * 3 + 1] = g / total;
+            target[p * 3 + 2] = b / total;
+        }
+    }
+}
+
+
+void atividades_cg_1::denoise::denoise_frame(Window &window, const GuideBuffers &guides, DenoiseSettings settings)
+{
+    if (guides.cols != window.cols || guides.rows != window.rows) {
+        throw runtime_error("Buffers auxiliares com tamanho diferente da janela");
+    }
+    int cols = window.cols, rows = window.rows;
+    vector<real> current((size_t)cols * rows * 3), next(current.size());
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            const Color &color = window.windows_colors[y][x];
+            size_t p = ((size_t)y * cols + x) * 3;
+            current[p] = color.r / (real)255;
+            current[p + 1] = color.g / (real)255;
+            current[p + 2] = color.b / (real)255;
+        }
+    }
+
+    int thread_count = settings.thread_count > 0 ? settings.thread_count : max(1u, thread::hardware_concurrency());
+    thread_count = max(1, min(thread_count, rows));
+    real color_sigma = settings.color_sigma;
+    for (int pass = 0, step = 1; pass < settings.iterations; pass++, step *= 2)
+    {
+        // Each pass reads the whole previous one, so the threads join before the next pass starts.
+        vector<thread> threads;
+        for (int t = 1; t < thread_count; t++) {
+            threads.push_back(thread(filter_rows, cref(guides), cref(settings), step, color_sigma, cref(current), ref(next),
+                                     rows * t / thread_count, rows * (t + 1) / thread_count));
+        }
+        filter_rows(guides, settings, step, color_sigma, current, next, 0, rows / thread_count);
+        for (auto &t : threads) {
+            t.join();
+        }
+        swap(current, next);
+        color_sigma /= 2;
+    }
+
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            size_t p = ((size_t)y * cols + x) * 3;
+            auto channel = [](real value) { return (uint8_t)std::lround(std::min(std::max(value, (real)0), (real)1) * 255); };
+            window.windows_colors[y][x] = Color(channel(current[p]), channel(current[p + 1]), channel(current[p + 2]));
+        }
+    }
+}
@@ -0,0 +1,404 @@
+#include "Distributed.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+using namespace atividades_cg_1::distributed;
+
+// While a worker is idle and tiles are in flight, poll wakes up this often to look for stragglers.
+const int STRAGGLER_POLL_MS = 10;
+// How long local workers get to read their scene (meshes included) and start listening.
+const int LOCAL_WORKER_START_TIMEOUT_MS = 60000;
+// How long local workers get to exit after `shutdown` before they are killed.
+const int LOCAL_WORKER_STOP_TIMEOUT_MS = 5000;
+
+
+static double elapsed_ms(chrono::steady_clock::time_point start, chrono::steady_clock::time_point end)
+{
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+
+RenderCoordinator::RenderCoordinator(vector<string> addresses, DistributedSettings settings) : settings(settings)
+{
+    for (string &address : addresses)
+    {
+        Worker worker;
+        worker.address = address;
+        int fd;
+        try {
+            fd = connect_address(address);
+        } catch (runtime_error &error) {
+            cerr << error.what() << endl;
+            continue;
+        }
+        if (fd < 0) {
+            cerr << "Worker " << address << " não está escutando" << endl;
+            continue;
+        }
+        worker.connection = make_unique<Connection>(fd);
+
+        string answer, type;
+        int cols = 0, rows = 0;
+        if (!worker.connection->write_line("window") || !worker.connection->read_line(answer)) {
+            cerr << "Worker " << address << " fechou a conexão" << endl;
+            continue;
+        }
+        istringstream iss(answer);
+        if (!(iss >> type >> cols >> rows) || type != "window") {
+            cerr << "Worker " << address << " respondeu " << answer << endl;
+            continue;
+        }
+        if (this->workers.empty()) {
+            this->cols = cols;
+            this->rows = rows;
+        } else if (cols != this->cols || rows != this->rows) {
+            cerr << "Worker " << address << " renderiza " << cols << "x" << rows << ", esperado "
+                 << this->cols << "x" << this->rows << endl;
+            continue;
+        }
+        this->workers.push_back(move(worker));
+    }
+
+    if (this->workers.empty()) {
+        throw runtime_error("Nenhum worker disponível para renderizar");
+    }
+}
+
+
+int RenderCoordinator::get_worker_count() const
+{
+    int count = 0;
+    for (const Worker &worker : this->workers) {
+        if (worker.is_alive()) count++;
+    }
+    return count;
+}
+
+
+bool RenderCoordinator::send_tile(Worker &worker, const RenderTile &tile)
+{
+    ostringstream request;
+    request << "tile " << tile.first_col << " " << tile.first_row << " " << tile.last_col << " " << tile.last_row;
+    return worker.connection->write_line(request.str());
+}
+
+
+bool RenderCoordinator::receive_tile(Worker &worker, vector<char> &pixels, string &error)
+{
+    string answer;
+    if (!worker.connection->read_line(answer)) {
+        error = "conexão perdida";
+        return false;
+    }
+
+    istringstream iss(answer);
+    string type, format;
+    int cols, rows;
+    size_t bytes;
+    if (!(iss >> type >> cols >> rows >> format >> bytes) || type != "frame" || format != "raw"
+        || bytes != (size_t)cols * rows * 3) {
+        error = answer;
+        return false;
+    }
+
+    pixels.resize(bytes);
+    if (!worker.connection->read_bytes(pixels.data(), bytes)) {
+        error = "conexão perdida";
+        return false;
+    }
+    return true;
+}
+
+
+void RenderCoordinator::drop_worker(Worker &worker, string reason)
+{
+    cerr << "Worker " << worker.address << " descartado: " << reason << endl;
+    worker.connection.reset();
+    worker.tile = -1;
+}
+
+
+void RenderCoordinator::drain(Worker &worker)
+{
+    if (!worker.is_alive() || worker.tile < 0) return;
+    vector<char> discarded;
+    string error;
+    if (!this->receive_tile(worker, discarded, error)) {
+        this->drop_worker(worker, error);
+    }
+    worker.tile = -1;
+}
+
+
+DistributedStats RenderCoordinator::render(vector<vector<Color>> &pixels)
+{
+    auto start = chrono::steady_clock::now();
+    DistributedStats stats;
+    int alive_workers = this->get_worker_count();
+    this->frame++;
+
+    vector<RenderTile> tiles;
+    int size = this->settings.tile_size;
+    for (int l = 0; l < this->rows; l += size) {
+        for (int c = 0; c < this->cols; c += size) {
+            tiles.push_back(RenderTile(c, min(c + size, this->cols), l, min(l + size, this->rows)));
+        }
+    }
+    int tile_count = tiles.size();
+    stats.tiles = tile_count;
+    pixels.assign(this->rows, vector<Color>(this->cols));
+
+    deque<int> queue;
+    for (int i = 0; i < tile_count; i++) queue.push_back(i);
+    vector<bool> done(tile_count, false);
+    // Workers rendering each tile, and when the first of them got it.
+    vector<int> runners(tile_count, 0);
+    vector<chrono::steady_clock::time_point> started(tile_count);
+    int remaining = tile_count;
+    double total_tile_ms = 0;
+    int timed_tiles = 0;
+    vector<char> tile_pixels;
+
+    while (remaining > 0)
+    {
+        if (this->get_worker_count() == 0) {
+            throw runtime_error("Todos os workers foram perdidos antes do fim do quadro");
+        }
+
+        // Idle workers take the next queued tile or, once the queue is empty, the oldest straggler.
+        auto now = chrono::steady_clock::now();
+        for (Worker &worker : this->workers)
+        {
+            if (!worker.is_alive() || worker.tile >= 0) continue;
+
+            int tile = -1;
+            while (tile < 0 && !queue.empty()) {
+                if (!done[queue.front()]) tile = queue.front();
+                queue.pop_front();
+            }
+            bool duplicate = false;
+            if (tile < 0 && timed_tiles > 0 && this->settings.straggler_factor > 0) {
+                double limit_ms = this->settings.straggler_factor * total_tile_ms / timed_tiles;
+                for (int i = 0; i < tile_count; i++) {
+                    if (done[i] || runners[i] != 1 || elapsed_ms(started[i], now) <= limit_ms) continue;
+                    if (tile < 0 || started[i] < started[tile]) tile = i;
+                }
+                duplicate = tile >= 0;
+            }
+            if (tile < 0) continue;
+
+            if (!this->send_tile(worker, tiles[tile])) {
+                this->drop_worker(worker, "conexão perdida");
+                if (!duplicate) {
+                    queue.push_front(tile);
+                    stats.requeued_tiles++;
+                }
+                continue;
+            }
+            worker.tile = tile;
+            worker.frame = this->frame;
+            worker.started = now;
+            if (runners[tile] == 0) started[tile] = now;
+            runners[tile]++;
+            if (duplicate) stats.duplicated_tiles++;
+        }
+
+        vector<pollfd> fds;
+        vector<int> polled;
+        bool has_idle = false;
+        for (int i = 0; i < (int)this->workers.size(); i++)
+        {
+            Worker &worker = this->workers[i];
+            if (!worker.is_alive()) continue;
+            if (worker.tile < 0) {
+                has_idle = true;
+                continue;
+            }
+            fds.push_back({worker.connection->get_fd(), POLLIN, 0});
+            polled.push_back(i);
+        }
+        if (fds.empty()) continue;
+
+        if (poll(fds.data(), fds.size(), has_idle ? STRAGGLER_POLL_MS : -1) < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("Falha em poll: ") + strerror(errno));
+        }
+
+        for (int i = 0; i < (int)fds.size(); i++)
+        {
+            if (fds[i].revents == 0) continue;
+            Worker &worker = this->workers[polled[i]];
+            int tile = worker.tile;
+            bool current = worker.frame == this->frame;
+            string error;
+            bool received = this->receive_tile(worker, tile_pixels, error);
+            worker.tile = -1;
+
+            if (!current) {
+                // Straggler of an earlier frame, already rendered by another worker.
+                if (!received) this->drop_worker(worker, error);
+                continue;
+            }
+
+            runners[tile]--;
+            const RenderTile &region = tiles[tile];
+            int tile_cols = region.last_col - region.first_col;
+            if (received && tile_pixels.size() != (size_t)tile_cols * (region.last_row - region.first_row) * 3) {
+                received = false;
+                error = "tamanho de tile inesperado";
+            }
+            if (!received) {
+                this->drop_worker(worker, error);
+                if (!done[tile] && runners[tile] == 0) {
+                    queue.push_front(tile);
+                    stats.requeued_tiles++;
+                }
+                continue;
+            }
+
+            worker.tiles_done++;
+            if (!done[tile]) {
+                const char *rgb = tile_pixels.data();
+                for (int l = region.first_row; l < region.last_row; l++) {
+                    for (int c = region.first_col; c < region.last_col; c++, rgb += 3) {
+                        pixels[l][c] = Color((unsigned char)rgb[0], (unsigned char)rgb[1], (unsigned char)rgb[2]);
+                    }
+                }
+                done[tile] = true;
+                remaining--;
+                total_tile_ms += elapsed_ms(worker.started, chrono::steady_clock::now());
+                timed_tiles++;
+            }
+            if (this->on_tile_done) {
+                this->on_tile_done(polled[i], worker.tiles_done);
+            }
+        }
+    }
+
+    stats.lost_workers = alive_workers - this->get_worker_count();
+    stats.frame_time_ms = elapsed_ms(start, chrono::steady_clock::now());
+    return stats;
+}
+
+
+void RenderCoordinator::shutdown_workers()
+{
+    for (Worker &worker : this->workers)
+    {
+        this->drain(worker);
+        if (!worker.is_alive()) continue;
+        string answer;
+        if (worker.connection->write_line("shutdown")) {
+            worker.connection->read_line(answer);
+        }
+        worker.connection.reset();
+    }
+}
+
+
+static void kill_local_workers(vector<LocalWorker> &workers)
+{
+    for (LocalWorker &worker : workers) {
+        kill(worker.pid, SIGKILL);
+        waitpid(worker.pid, NULL, 0);
+        unlink(worker.address.c_str());
+    }
+    workers.clear();
+}
+
+
+vector<LocalWorker> atividades_cg_1::distributed::spawn_local_workers(string scene_path, int count, int threads_per_worker)
+{
+    vector<LocalWorker> workers;
+    string threads = to_string(threads_per_worker);
+    for (int i = 0; i < count; i++)
+    {
+        LocalWorker worker;
+        worker.address = "/tmp/cenario-" + to_string(getpid()) + "-" + to_string(i) + ".sock";
+        // Everything the child touches is ready before fork: only exec and async-signal-safe calls after it.
+        const char *argv[] = {"cenario", "--scene", scene_path.c_str(), "--serve", worker.address.c_str(),
+                              "--threads", threads.c_str(), NULL};
+        worker.pid = fork();
+        if (worker.pid < 0) {
+            kill_local_workers(workers);
+            throw runtime_error("Não foi possível criar o processo do worker");
+        }
+        if (worker.pid == 0) {
+            // The workers' messages would get mixed with the coordinator's output.
+            int null_fd = open("/dev/null", O_WRONLY);
+            if (null_fd >= 0) dup2(null_fd, STDOUT_FILENO);
+            execv("/proc/self/exe", (char *const *)argv);
+            _exit(127);
+        }
+        workers.push_back(worker);
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        LocalWorker worker = workers[i];
+        for (;;)
+        {
+            int fd = connect_unix(worker.address);
+            if (fd >= 0) {
+                close_socket(fd);
+                break;
+            }
+            if (waitpid(worker.pid, NULL, WNOHANG) == worker.pid) {
+                // Already reaped: only the others are left to kill.
+                workers.erase(workers.begin() + i);
+                kill_local_workers(workers);
+                throw runtime_error("Um worker local terminou antes de escutar em " + worker.address);
+            }
+            if (elapsed_ms(start, chrono::steady_clock::now()) > LOCAL_WORKER_START_TIMEOUT_MS) {
+                kill_local_workers(workers);
+                throw runtime_error("Worker local não começou a escutar em " + worker.address);
+            }
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    }
+    return workers;
+}
+
+
+void atividades_cg_1::distributed::stop_local_workers(vector<LocalWorker> &workers)
+{
+    auto start = chrono::steady_clock::now();
+    for (LocalWorker &worker : workers)
+    {
+        while (waitpid(worker.pid, NULL, WNOHANG) == 0) {
+            if (elapsed_ms(start, chrono::steady_clock::now()) > LOCAL_WORKER_STOP_TIMEOUT_MS) {
+                kill(worker.pid, SIGKILL);
+                waitpid(worker.pid, NULL, 0);
+                break;
+            }
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        unlink(worker.address.c_str());
+    }
+    workers.clear();
+}
+
+
+vector<string> atividades_cg_1::distributed::parse_worker_addresses(string list)
+{
+    vector<string> addresses;
+    istringstream iss(list);
+    string address;
+    while (getline(iss, address, ',')) {
+        if (!address.empty()) addresses.push_back(address);
+    }
+    return addresses;
+}
@@ -0,0 +1,96 @@
+#include "Image.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstdlib>
+
+using namespace std;
+using namespace atividades_cg_1::image;
+
+
+void atividades_cg_1::image::write_ppm(string file_path, const vector<vector<Color>> &pixels)
+{
+    ofstream file(file_path, ios::binary);
+    if (!file) {
+        throw runtime_error("Não foi possível criar a imagem " + file_path);
+    }
+
+    int rows = pixels.size();
+    int cols = rows > 0 ? pixels[0].size() : 0;
+    file << "P6\n" << cols << " " << rows << "\n255\n";
+
+    for (auto &row : pixels) {
+        for (auto &color : row) {
+            char rgb[3] = {(char)color.r, (char)color.g, (char)color.b};
+            file.write(rgb, 3);
+        }
+    }
+}
+
+
+vector<vector<Color>> atividades_cg_1::image::read_ppm(string file_path)
+{
+    ifstream file(file_path, ios::binary);
+    if (!file) {
+        throw runtime_error("Não foi possível abrir a imagem " + file_path);
+    }
+
+    string magic;
+    int cols, rows, max_value;
+    file >> magic >> cols >> rows >> max_value;
+    if (magic != "P6" || max_value != 255 || cols <= 0 || rows <= 0) {
+        throw runtime_error("Formato de imagem não suportado (esperado PPM P6 de 8 bits): " + file_path);
+    }
+    file.get(); // Single whitespace between header and pixel data.
+
+    vector<vector<Color>> pixels(rows, vector<Color>(cols));
+    for (auto &row : pixels) {
+        for (auto &color : row) {
+            char rgb[3];
+            if (!file.read(rgb, 3)) {
+                throw runtime_error("Imagem truncada: " + file_path);
+            }
+            color = Color(rgb[0], rgb[1], rgb[2]);
+        }
+    }
+    return pixels;
+}
+
+
+double ImageDifference::mismatched_ratio()
+{
+    if (this->total_pixels == 0) return 0;
+    return this->mismatched_pixels / (double)this->total_pixels;
+}
+
+
+ImageDifference atividades_cg_1::image::compare_images(const vector<vector<Color>> &a, const vector<vector<Color>> &b, int channel_tolerance)
+{
+    ImageDifference difference;
+    if (a.size() != b.size() || (a.size() > 0 && a[0].size() != b[0].size())) {
+        difference.same_dimensions = false;
+        return difference;
+    }
+
+    long accumulated = 0;
+    for (size_t l = 0; l < a.size(); l++) {
+        for (size_t c = 0; c < a[l].size(); c++) {
+            int dr = abs(a[l][c].r - b[l][c].r);
+            int dg = abs(a[l][c].g - b[l][c].g);
+            int db = abs(a[l][c].b - b[l][c].b);
+            int pixel_max = max(dr, max(dg, db));
+
+            accumulated += dr + dg + db;
+            difference.max_channel_difference = max(difference.max_channel_difference, pixel_max);
+            if (pixel_max > channel_tolerance) {
+                difference.mismatched_pixels++;
+            }
+            difference.total_pixels++;
+        }
+    }
+
+    if (difference.total_pixels > 0) {
+        difference.mean_channel_difference = accumulated / (3.0 * difference.total_pixels);
+    }
+    return difference;
+}
@@ -0,0 +1,151 @@
+#include "Interactive.hpp"
+#include "Timeline.hpp"
+
+using namespace std;
+using namespace atividades_cg_1::interactive;
+using namespace atividades_cg_1::timeline;
+
+
+void atividades_cg_1::interactive::pack_frame(Window &window, PresentedFrame &frame)
+{
+    frame.cols = window.cols;
+    frame.rows = window.rows;
+    frame.rgb.resize((size_t)window.cols * window.rows * 3);
+    uint8_t *out = frame.rgb.data();
+    for (auto &row : window.windows_colors) {
+        for (Color &color : row) {
+            *out++ = color.r;
+            *out++ = color.g;
+            *out++ = color.b;
+        }
+    }
+}
+
+
+Camera atividades_cg_1::interactive::move_camera(Camera current, real right, real up, real forward)
+{
+    Vector3d offset = current.ic.multiply(right).sum(current.jc.multiply(up)).sum(current.kc.multiply(-forward));
+    Window &window = current.window;
+    Camera moved(current.look_at.sum(offset), current.eye.sum(offset), current.view_up, current.focal_distance,
+                 window.width, window.height, window.cols, window.rows);
+    moved.window.center = window.center;
+    return moved;
+}
+
+
+RenderThread::RenderThread(Scene &scene, RenderSettings settings, double target_fps, function<void()> on_frame_ready)
+: scene(scene), settings(settings), resolution(target_fps), on_frame_ready(on_frame_ready)
+{
+    this->settings.cancel = &this->cancel_frame;
+    this->thread = std::thread(&RenderThread::run, this);
+}
+
+
+RenderThread::~RenderThread()
+{
+    this->stop();
+}
+
+
+void RenderThread::move_camera(real right, real up, real forward)
+{
+    lock_guard<std::mutex> lock(this->mutex);
+    this->pending_right += right;
+    this->pending_up += up;
+    this->pending_forward += forward;
+    this->has_pending_move = true;
+    // Low resolution frames are not cancelled: with a key held down, moves would arrive faster than they finish.
+    if (this->tracing_full_resolution.load()) {
+        this->cancel_frame.store(true);
+    }
+    this->wake.notify_one();
+}
+
+
+void RenderThread::stop()
+{
+    {
+        lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+        this->cancel_frame.store(true);
+        this->wake.notify_one();
+    }
+    if (this->thread.joinable()) {
+        this->thread.join();
+    }
+}
+
+
+void RenderThread::publish(Window &window, double frame_time_ms, bool full_resolution)
+{
+    TimelineScope scope("publish frame");
+    PresentedFrame &frame = this->frames.get_back();
+    pack_frame(window, frame);
+    frame.frame_time_ms = frame_time_ms;
+    frame.full_resolution = full_resolution;
+    this->frames.publish();
+    if (this->on_frame_ready) {
+        this->on_frame_ready();
+    }
+}
+
+
+void RenderThread::run()
+{
+    name_thread("render thread");
+    Window full = this->scene.get_camera().window;
+    Window low_resolution = scale_window(full, this->resolution.scale);
+    bool full_frame_needed = true;
+
+    for (;;)
+    {
+        real right, up, forward;
+        bool moved;
+        {
+            unique_lock<std::mutex> lock(this->mutex);
+            auto woken = [&]() { return this->stopping || this->has_pending_move || full_frame_needed; };
+            // Nothing signals a mesh that finishes loading, so poll for it; prepare_frame swaps it in.
+            while (!woken() && this->scene.has_pending_meshes()) {
+                this->wake.wait_for(lock, chrono::milliseconds(MESH_POLL_INTERVAL_MS), woken);
+                if (this->scene.has_loaded_meshes()) full_frame_needed = true;
+            }
+            this->wake.wait(lock, woken);
+            if (this->stopping) return;
+
+            right = this->pending_right;
+            up = this->pending_up;
+            forward = this->pending_forward;
+            moved = this->has_pending_move;
+            this->pending_right = this->pending_up = this->pending_forward = 0;
+            this->has_pending_move = false;
+            this->cancel_frame.store(false);
+            this->tracing_full_resolution.store(!moved);
+        }
+
+        if (moved)
+        {
+            this->scene.set_camera(atividades_cg_1::interactive::move_camera(this->scene.get_camera(), right, up, forward));
+            Window scaled = scale_window(full, this->resolution.scale);
+            if (scaled.cols != low_resolution.cols || scaled.rows != low_resolution.rows) {
+                low_resolution = scaled;
+            }
+
+            FrameStats stats = render_frame(this->scene, low_resolution, this->settings);
+            if (this->cancel_frame.load()) continue;
+            this->resolution.record_frame(stats.frame_time_ms);
+            upscale_window(low_resolution, full);
+            bool is_full = low_resolution.cols == full.cols && low_resolution.rows == full.rows;
+            this->publish(full, stats.frame_time_ms, is_full);
+            full_frame_needed = !is_full;
+        }
+        else
+        {
+            FrameStats stats = render_frame(this->scene, full, this->settings);
+            this->tracing_full_resolution.store(false);
+            // Cancelled by a move: the next iteration traces it, and a full frame afterwards.
+            if (this->cancel_frame.load()) continue;
+            this->publish(full, stats.frame_time_ms, true);
+            full_frame_needed = false;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "Memory.hpp"
+
+using namespace std;
+using namespace atividades_cg_1::memory;
+
+
+string atividades_cg_1::memory::get_memory_category_key(int category)
+{
+    static const char *keys[MEMORY_CATEGORY_COUNT] = {"mesh_geometry", "framebuffers", "acceleration", "textures", "objects"};
+    return keys[category];
+}
+
+
+size_t MemoryUsage::total() const
+{
+    size_t sum = 0;
+    for (size_t count : this->bytes) {
+        sum += count;
+    }
+    return sum;
+}
+
+
+size_t atividades_cg_1::memory::get_pixels_memory(const vector<vector<Color>> &pixels)
+{
+    size_t bytes = get_vector_memory(pixels);
+    for (auto &row : pixels) {
+        bytes += get_vector_memory(row);
+    }
+    return bytes;
+}
+
+
+void MemoryAccount::record(const MemoryUsage &usage)
+{
+    this->current = usage;
+    for (int c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+        this->peak.bytes[c] = max(this->peak.bytes[c], usage.bytes[c]);
+    }
+    this->peak_total = max(this->peak_total, usage.total());
+}
+
+
+string MemoryAccount::describe() const
+{
+    static const char *names[MEMORY_CATEGORY_COUNT] = {"geometria de malhas", "framebuffers", "estruturas de aceleração", "texturas", "objetos"};
+    auto format = [](size_t bytes) {
+        ostringstream text;
+        if (bytes < 1024 * 1024) {
+            text << fixed << setprecision(1) << bytes / 1024.0 << " KiB";
+        } else {
+            text << fixed << setprecision(2) << bytes / (1024.0 * 1024.0) << " MiB";
+        }
+        return text.str();
+    };
+
+    ostringstream text;
+    for (int c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+        text << "  " << names[c] << ": " << format(this->current.bytes[c]) << " (pico " << format(this->peak.bytes[c]) << ")\n";
+    }
+    text << "  total: " << format(this->current.total()) << " (pico " << format(this->peak_total) << ")\n";
+    return text.str();
+}
@@ -3,24 +3,29 @@
 #include "Algebra.hpp"
 #include "Color.hpp"
 #include "Camera.hpp"
+#include "Timeline.hpp"
+
+#include <map>
+#include <tuple>
 
 using namespace atividades_cg_1::algebra;
 using namespace atividades_cg_1::color;
 using namespace atividades_cg_1::objects;
 using namespace atividades_cg_1::camera;
+using namespace atividades_cg_1::timeline;
 
 IntensityColor Object::get_difuse_contribution(Vector3d intersec_point, Intersection intersection, SourceOfLight source_of_light)
 {
     Vector3d l = this->get_light_vector(intersec_point, intersection, source_of_light);
     Vector3d n = this->get_normal_vector(intersec_point, intersection);
-    float scalar_product_l_n = l.scalar_product(n);
+    real scalar_product_l_n = l.scalar_product(n);
 
     // if scalar_product is negative, the angle is greater than 180 degrees and we can't see the object. The color in result will be black.
     if (scalar_product_l_n < 0)
     {
         scalar_product_l_n = 0;
     }
-    float f_difuse = scalar_product_l_n;
+    real f_difuse = scalar_product_l_n;
     IntensityColor contribution = source_of_light.intensity.arroba_multiply(this->difuse_reflectivity).multiply(f_difuse);
 
     return contribution;
@@ -34,12 +39,63 @@ IntensityColor Object::get_specular_contribution(Vector3d intersec_point, Inters
     Vector3d r = n.multiply(2).minus(l).get_vector_normalized();
     Vector3d v = eye_point.minus(intersec_point).get_vector_normalized();
 
-    float f_specular = std::pow(r.scalar_product(v), this->shininess);
+    real f_specular = std::pow(r.scalar_product(v), this->shininess);
 
     IntensityColor contribution = source_of_light.intensity.arroba_multiply(this->specular_reflectivity).multiply(f_specular);
     return contribution;
 }
 
+void Object::add_memory_usage(MemoryUsage &usage)
+{
+    usage.add(MEMORY_OBJECTS, sizeof(Object));
+}
+
+void Object::set_material(Color color, IntensityColor dr, IntensityColor sr, IntensityColor er, real shininess)
+{
+    this->color = color;
+    this->difuse_reflectivity = dr;
+    this->specular_reflectivity = sr;
+    this->environment_reflectivity = er;
+    this->shininess = shininess;
+    this->classify_material();
+}
+
+void Object::set_optics(IntensityColor mirror_reflectivity, IntensityColor transmissivity, real refraction_index)
+{
+    this->mirror_reflectivity = mirror_reflectivity;
+    this->transmissivity = transmissivity;
+    this->refraction_index = refraction_index;
+
+    IntensityColor &k_r = this->mirror_reflectivity;
+    IntensityColor &k_t = this->transmissivity;
+    this->has_optics = k_r.r > 0 || k_r.g > 0 || k_r.b > 0 || k_t.r > 0 || k_t.g > 0 || k_t.b > 0;
+}
+
+Intersection Object::get_next_intersection(Ray ray)
+{
+    Intersection intersection = this->get_intersection(ray);
+    if (intersection.is_valid && intersection.time > 0)
+        return intersection;
+    return Intersection(intersection.time, false);
+}
+
+void Object::classify_material()
+{
+    IntensityColor &k_e = this->specular_reflectivity;
+    if (k_e.r <= 0 && k_e.g <= 0 && k_e.b <= 0)
+    {
+        this->material_class = MATERIAL_DIFFUSE_ONLY;
+    }
+    else if (this->shininess >= 0 && this->shininess <= MAX_INTEGER_SHININESS && this->shininess == std::floor(this->shininess))
+    {
+        this->material_class = MATERIAL_PHONG_INTEGER;
+    }
+    else
+    {
+        this->material_class = MATERIAL_PHONG;
+    }
+}
+
 Vector3d Object::get_light_vector(Vector3d intersec_point, Intersection intersection, SourceOfLight source)
 {
     return (source.center.minus(intersec_point)).get_vector_normalized();
@@ -52,49 +108,89 @@ Vector3d Sphere::get_normal_vector(Vector3d intersec_point, Intersection interse
     return (intersec_point.minus(this->center)).divide(this->radius);
 }
 
-void Sphere::apply_transformation(Matrix transformation)
+bool Sphere::get_texture_coordinates(Vector3d intersec_point, Intersection intersection, TextureCoordinates &coordinates)
+{
+    Vector3d d = intersec_point.minus(this->center).get_vector_normalized();
+    Vector3d pole = this->texture_pole.minus(this->center).get_vector_normalized();
+    Vector3d meridian = this->texture_meridian.minus(this->center);
+    meridian = meridian.minus(pole.multiply(meridian.scalar_product(pole))).get_vector_normalized();
+    Vector3d east = pole.vectorial_product(meridian);
+
+    real latitude = std::acos(std::min(std::max(d.scalar_product(pole), (real)-1), (real)1));
+    real longitude = std::atan2(d.scalar_product(east), d.scalar_product(meridian));
+    coordinates.u = longitude / (2 * (real)M_PI) + (real)0.5;
+    coordinates.v = latitude / (real)M_PI;
+    // Along the equator, one repeat per circumference.
+    coordinates.density = 1 / (2 * (real)M_PI * this->radius);
+    return true;
+}
+
+void Sphere::apply_transformation(Matrix4 transformation)
 {
     this->center = this->center.apply_transformation(transformation);
+    this->texture_pole = this->texture_pole.apply_transformation(transformation);
+    this->texture_meridian = this->texture_meridian.apply_transformation(transformation);
+
+    // A scale in the matrix (from Scene::transform_objects) grows the radius by its smallest factor, like
+    // apply_scale_transformation. Rotations and translations, within rounding, leave the radius alone.
+    real s = 1;
+    for (int c = 0; c < 3; c++) {
+        real column = std::sqrt(transformation.m[0][c] * transformation.m[0][c] + transformation.m[1][c] * transformation.m[1][c] +
+                                transformation.m[2][c] * transformation.m[2][c]);
+        s = c == 0 ? column : min(s, column);
+    }
+    if (std::abs(s - 1) > 1e-4) {
+        this->radius *= s;
+    }
+}
+
+Vector3d Sphere::get_center()
+{
+    return this->center;
 }
 
-void Sphere::apply_scale_transformation(float sx, float sy, float sz)
+void Sphere::apply_scale_transformation(real sx, real sy, real sz)
 {
     // We need to grow sphere's radius.
-    float s = min(sx, sy);
+    real s = min(sx, sy);
     s = min(s, sz);
     this->radius *= s;
 }
 
-Intersection Sphere::get_intersection(Ray ray)
+Intersection Sphere::get_next_intersection(Ray ray)
 {
-
-    Vector3d initial_point = ray.p1;
+    // Same equation as get_intersection, but keeps the smallest positive root so rays leaving the sphere from
+    // inside (refraction) find the far side.
     Vector3d dr = ray.get_dr();
+    Vector3d w = ray.p1.minus(this->center);
 
-    Vector3d w = initial_point.minus(this->center);
-
-    // We want to check if ||Pint - C||² = R²
-    // (Pin + tint*dr - C).(Pin + tint*dr - C) - R² = 0
-    // (w + tint*dr).(w + tint*dr) - R² = 0
-    // w² + 2w*tint*dr + tint²*dr² - R² = 0
-    // dr²*tint² + 2w*dr*tint + w² -     R² = 0
-    float a = dr.scalar_product(dr);
-    float b = (w.multiply(2)).scalar_product(dr);
-    float c = w.scalar_product(w) - std::pow(this->radius, 2);
-
-    float delta = std::pow(b, 2) - (4 * a * c);
-    float t1 = (-b + std::sqrt(delta)) / (2 * a);
-    float t2 = (-b - std::sqrt(delta)) / (2 * a);
-
+    real b = w.scalar_product(dr);
+    real c = w.scalar_product(w) - this->radius * this->radius;
+    real delta = b * b - c;
     if (delta < 0)
     {
         return Intersection(0.0, false);
     }
 
-    Vector3d intersection_point;
-    if (t1 < t2)
-        return Intersection(t1, true, this);
-    return Intersection(t2, true, this);
+    real root = std::sqrt(delta);
+    real t_near = -b - root;
+    real t_far = -b + root;
+    if (t_near > 0)
+        return Intersection(t_near, true, this);
+    if (t_far > 0)
+        return Intersection(t_far, true, this);
+    return Intersection(t_far, false);
+}
+
+void Sphere::add_memory_usage(MemoryUsage &usage)
+{
+    usage.add(MEMORY_OBJECTS, sizeof(Sphere));
+}
+
+BoundingBox Sphere::get_bounds()
+{
+    Vector3d extent(this->radius, this->radius, this->radius);
+    return BoundingBox(this->center.minus(extent), this->center.sum(extent));
 }
 
 void Sphere::apply_coordinate_change(Camera camera, int type_coord_change)
@@ -103,10 +199,14 @@ void Sphere::apply_coordinate_change(Camera camera, int type_coord_change)
     {
     case CHANGE_FROM_WORLD_TO_CAMERA:
         this->center = camera.transform_vector_from_world_to_camera(this->center);
+        this->texture_pole = camera.transform_vector_from_world_to_camera(this->texture_pole);
+        this->texture_meridian = camera.transform_vector_from_world_to_camera(this->texture_meridian);
         break;
 
     case CHANGE_FROM_CAMERA_TO_WORLD:
         this->center = camera.transform_vector_from_camera_to_world(this->center);
+        this->texture_pole = camera.transform_vector_from_camera_to_world(this->texture_pole);
+        this->texture_meridian = camera.transform_vector_from_camera_to_world(this->texture_meridian);
         break;
     default:
         throw runtime_error("Tipo de mudança de coordenada inválida");
@@ -119,22 +219,42 @@ Vector3d Plan::get_normal_vector(Vector3d intersec_point, Intersection intersect
     return this->normal.get_vector_normalized();
 }
 
-void Plan::apply_transformation(Matrix transformation)
+void Plan::apply_transformation(Matrix4 transformation)
 {
     this->known_point = this->known_point.apply_transformation(transformation);
     this->normal = this->normal.apply_transformation(transformation);
+    this->texture_u_point = this->texture_u_point.apply_transformation(transformation);
+    this->texture_v_point = this->texture_v_point.apply_transformation(transformation);
 }
 
-Intersection Plan::get_intersection(Ray ray)
+void Plan::add_memory_usage(MemoryUsage &usage)
 {
-    Vector3d w = ray.p1.minus(this->known_point);
-    Vector3d dr = ray.get_dr();
+    usage.add(MEMORY_OBJECTS, sizeof(Plan));
+}
 
-    float t_int = -(this->normal.scalar_product(w)) / (this->normal.scalar_product(dr));
-    if (t_int > 0) {
-        return Intersection(t_int, true, this);
-    }
-    return Intersection(t_int, false);
+void Plan::set_texture(shared_ptr<const Texture> texture, real scale)
+{
+    this->texture = texture;
+
+    // u along the world axis closest to the plane, v completing the right handed pair with the normal.
+    Vector3d n = this->normal.get_vector_normalized();
+    Vector3d axis = std::abs(n.y) < (real)0.9 ? Vector3d(0, 1, 0) : Vector3d(0, 0, -1);
+    Vector3d u = axis.minus(n.multiply(axis.scalar_product(n))).get_vector_normalized();
+    Vector3d v = n.vectorial_product(u);
+    this->texture_u_point = this->known_point.sum(u.multiply(scale));
+    this->texture_v_point = this->known_point.sum(v.multiply(scale));
+}
+
+bool Plan::get_texture_coordinates(Vector3d intersec_point, Intersection intersection, TextureCoordinates &coordinates)
+{
+    Vector3d u = this->texture_u_point.minus(this->known_point);
+    Vector3d v = this->texture_v_point.minus(this->known_point);
+    Vector3d offset = intersec_point.minus(this->known_point);
+    real u_length_squared = u.scalar_product(u);
+    coordinates.u = offset.scalar_product(u) / u_length_squared;
+    coordinates.v = offset.scalar_product(v) / v.scalar_product(v);
+    coordinates.density = 1 / std::sqrt(u_length_squared);
+    return true;
 }
 
 void Plan::apply_coordinate_change(Camera camera, int type_coord_change)
@@ -144,11 +264,15 @@ void Plan::apply_coordinate_change(Camera camera, int type_coord_change)
     case CHANGE_FROM_WORLD_TO_CAMERA:
         this->known_point = camera.transform_vector_from_world_to_camera(this->known_point);
         this->normal = camera.transform_vector_from_world_to_camera(this->normal);
+        this->texture_u_point = camera.transform_vector_from_world_to_camera(this->texture_u_point);
+        this->texture_v_point = camera.transform_vector_from_world_to_camera(this->texture_v_point);
         break;
 
     case CHANGE_FROM_CAMERA_TO_WORLD:
         this->known_point = camera.transform_vector_from_camera_to_world(this->known_point);
         this->normal = camera.transform_vector_from_camera_to_world(this->normal);
+        this->texture_u_point = camera.transform_vector_from_camera_to_world(this->texture_u_point);
+        this->texture_v_point = camera.transform_vector_from_camera_to_world(this->texture_v_point);
         break;
     default:
         throw runtime_error("Tipo de mudança de coordenada inválida");
@@ -159,7 +283,7 @@ void Plan::apply_coordinate_change(Camera camera, int type_coord_change)
 Triangle::Triangle(Vector3d p1, Vector3d p2,
                    Vector3d p3, Color color,
                    IntensityColor dr, IntensityColor sr,
-                   IntensityColor er, float shininess) : p1(p1), p2(p2), p3(p3), Object(color, dr, sr, er, shininess) {}
+                   IntensityColor er, real shininess) : Object(color, dr, sr, er, shininess), p1(p1), p2(p2), p3(p3) {}
 
 // We can pass any value of interserction_point
 Vector3d Triangle::get_normal_vector(Vector3d intersec_point = Vector3d(), Intersection intersection = Intersection())
@@ -175,7 +299,7 @@ Vector3d Triangle::get_center() {
     return this->p1.sum(this->p2).sum(this->p3).divide(3);
 }
 
-void Triangle::apply_transformation(Matrix transformation)
+void Triangle::apply_transformation(Matrix4 transformation)
 {
 
     this->p1 = this->p1.apply_transformation(transformation);
@@ -183,47 +307,31 @@ void Triangle::apply_transformation(Matrix transformation)
     this->p3 = this->p3.apply_transformation(transformation);
 }
 
-void Triangle::apply_scale_transformation(float sx, float sy, float sz)
+void Triangle::apply_scale_transformation(real sx, real sy, real sz)
 {
     Vector3d fixed_point = this->get_center();
-    Matrix matrix_transformation = MatrixTransformations::scale(fixed_point, sx, sy, sz);
+    Matrix4 matrix_transformation = MatrixTransformations::scale(fixed_point, sx, sy, sz);
     Triangle::apply_transformation(matrix_transformation);
 }
 
-void Triangle::apply_rotation_transformation(float theta, int axis)
+void Triangle::apply_rotation_transformation(real theta, int axis)
 {
-    Matrix rotation_matrix = MatrixTransformations::rotation(theta, axis);
+    Matrix4 rotation_matrix = MatrixTransformations::rotation(theta, axis);
     Triangle::apply_transformation(rotation_matrix);
 }
 
-Intersection Triangle::get_intersection(Ray ray)
+void Triangle::add_memory_usage(MemoryUsage &usage)
 {
-    Vector3d normal_vector = this->get_normal_vector();
-    float intersec_t = -(((ray.p1.minus(this->p1)).scalar_product(normal_vector)) / ray.get_dr().scalar_product(normal_vector));
-
-    if (intersec_t <= 0)
-    {
-        return Intersection(intersec_t, false);
-    }
-
-    Vector3d intersec_point = ray.p1.sum(ray.get_dr().multiply(intersec_t));
-
-    Vector3d r1 = this->p2.minus(this->p1);
-    Vector3d r2 = this->p3.minus(this->p1);
-    Vector3d v = intersec_point.minus(this->p1);
-
-    float total_area = r1.vectorial_product(r2).scalar_product(normal_vector);
-
-    float c1 = v.vectorial_product(r2).scalar_product(normal_vector) / total_area;
-    float c2 = r1.vectorial_product(v).scalar_product(normal_vector) / total_area;
-    float c3 = 1.0 - c1 - c2;
-
-    if (c1 >= 0.0 && c2 >= 0.0 && c3 >= 0.0 && abs(c1 + c2 + c3 - 1.0) <= 1.0e-12)
-    {
-        return Intersection(intersec_t, true, this);
-    }
+    usage.add(MEMORY_OBJECTS, sizeof(Triangle));
+}
 
-    return Intersection(intersec_t, false);
+BoundingBox Triangle::get_bounds()
+{
+    BoundingBox box;
+    box.expand(this->p1);
+    box.expand(this->p2);
+    box.expand(this->p3);
+    return box;
 }
 
 void Triangle::apply_coordinate_change(Camera camera, int type_coord_change)
@@ -263,6 +371,38 @@ Vector3d Triangle::get_p1()
     return this->p1;
 }
 
+void Triangle::set_points(Vector3d p1, Vector3d p2, Vector3d p3)
+{
+    this->p1 = p1;
+    this->p2 = p2;
+    this->p3 = p3;
+}
+
+bool Triangle::interpolate_texture_coordinates(Vector3d point, const real *uv, TextureCoordinates &coordinates)
+{
+    // Barycentric weights of the point.
+    Vector3d e1 = this->p2.minus(this->p1);
+    Vector3d e2 = this->p3.minus(this->p1);
+    Vector3d offset = point.minus(this->p1);
+    real d11 = e1.scalar_product(e1), d12 = e1.scalar_product(e2), d22 = e2.scalar_product(e2);
+    real o1 = offset.scalar_product(e1), o2 = offset.scalar_product(e2);
+    real denominator = d11 * d22 - d12 * d12;
+    if (denominator <= 0) return false;
+    real w2 = (d22 * o1 - d12 * o2) / denominator;
+    real w3 = (d11 * o2 - d12 * o1) / denominator;
+    real w1 = 1 - w2 - w3;
+
+    coordinates.u = w1 * uv[0] + w2 * uv[2] + w3 * uv[4];
+    coordinates.v = w1 * uv[1] + w2 * uv[3] + w3 * uv[5];
+
+    // Square root of texture area over surface area: repeats per unit of length, averaged over both directions.
+    real du1 = uv[2] - uv[0], dv1 = uv[3] - uv[1];
+    real du2 = uv[4] - uv[0], dv2 = uv[5] - uv[1];
+    real texture_area = std::abs(du1 * dv2 - du2 * dv1);
+    coordinates.density = std::sqrt(texture_area / std::sqrt(denominator));
+    return true;
+}
+
 Vector3d Triangle::get_p2()
 {
     return this->p2;
@@ -277,7 +417,7 @@ Vector3d Triangle::get_p3()
 FourPointsFace::FourPointsFace(Vector3d p1, Vector3d p2,
                                Vector3d p3, Vector3d p4, Color color,
                                IntensityColor dr, IntensityColor sr,
-                               IntensityColor er, float shininess) : Object(color, dr, sr, er, shininess)
+                               IntensityColor er, real shininess) : Object(color, dr, sr, er, shininess)
 {
     this->t1 = Triangle(p1, p2, p3);
     this->t2 = Triangle(p3, p4, p1);
@@ -292,52 +432,45 @@ Vector3d FourPointsFace::get_normal_vector(Vector3d intersec_point, Intersection
     return this->t1.get_normal_vector();
 }
 
-void FourPointsFace::apply_transformation(Matrix transformation)
+void FourPointsFace::apply_transformation(Matrix4 transformation)
 {
     this->t1.apply_transformation(transformation);
     this->t2.apply_transformation(transformation);
 }
 
-void FourPointsFace::apply_scale_transformation(float sx, float sy, float sz)
+void FourPointsFace::apply_scale_transformation(real sx, real sy, real sz)
 {
     Vector3d fixed_point = this->get_center();
-    Matrix matrix_transformation = MatrixTransformations::scale(fixed_point, sx, sy, sz);
+    Matrix4 matrix_transformation = MatrixTransformations::scale(fixed_point, sx, sy, sz);
     this->t1.apply_transformation(matrix_transformation);
     this->t2.apply_transformation(matrix_transformation);
 }
 
-void FourPointsFace::apply_rotation_transformation(float theta, int axis)
+void FourPointsFace::apply_rotation_transformation(real theta, int axis)
 {
-    Matrix rotation_matrix = MatrixTransformations::rotation(theta, axis);
+    Matrix4 rotation_matrix = MatrixTransformations::rotation(theta, axis);
     this->t1.apply_transformation(rotation_matrix);
     this->t2.apply_transformation(rotation_matrix);
 }
 
 Intersection FourPointsFace::get_intersection(Ray ray)
 {
+    // The hit triangle is the intersepted object, so shading reads the material from it.
+    // Intersection tests must not write to the object: several threads trace the same scene.
     Intersection intersec1 = this->t1.get_intersection(ray);
     if (intersec1.is_valid)
     {
-        this->color = this->t1.color;
-        this->shininess = this->t1.shininess;
-        this->difuse_reflectivity = this->t1.difuse_reflectivity;
-        this->environment_reflectivity = this->t1.environment_reflectivity;
-        this->specular_reflectivity = this->t1.specular_reflectivity;
         return intersec1;
-        
-    } 
-
-    Intersection intersec2 = this->t2.get_intersection(ray);
-    if (intersec2.is_valid)
-    {
-        this->color = this->t2.color;
-        this->shininess = this->t2.shininess;
-        this->difuse_reflectivity = this->t2.difuse_reflectivity;
-        this->environment_reflectivity = this->t2.environment_reflectivity;
-        this->specular_reflectivity = this->t2.specular_reflectivity;
     }
-    
-    return intersec2;
+
+    return this->t2.get_intersection(ray);
+}
+
+BoundingBox FourPointsFace::get_bounds()
+{
+    BoundingBox box = this->t1.get_bounds();
+    box.merge(this->t2.get_bounds());
+    return box;
 }
 
 void FourPointsFace::apply_coordinate_change(Camera camera, int type_coord_change)
@@ -346,13 +479,44 @@ void FourPointsFace::apply_coordinate_change(Camera camera, int type_coord_chang
     this->t2.apply_coordinate_change(camera, type_coord_change);
 }
 
+// Shading uses the triangle that was hit, so both halves carry the face material.
+void FourPointsFace::set_material(Color color, IntensityColor dr, IntensityColor sr, IntensityColor er, real shininess)
+{
+    Object::set_material(color, dr, sr, er, shininess);
+    this->t1.set_material(color, dr, sr, er, shininess);
+    this->t2.set_material(color, dr, sr, er, shininess);
+}
+
+void FourPointsFace::set_optics(IntensityColor mirror_reflectivity, IntensityColor transmissivity, real refraction_index)
+{
+    Object::set_optics(mirror_reflectivity, transmissivity, refraction_index);
+    this->t1.set_optics(mirror_reflectivity, transmissivity, refraction_index);
+    this->t2.set_optics(mirror_reflectivity, transmissivity, refraction_index);
+}
+
+void FourPointsFace::get_vertices(Vector3d *vertices)
+{
+    vertices[0] = this->t1.get_p1();
+    vertices[1] = this->t1.get_p2();
+    vertices[2] = this->t1.get_p3();
+    vertices[3] = this->t2.get_p1();
+    vertices[4] = this->t2.get_p2();
+    vertices[5] = this->t2.get_p3();
+}
+
+void FourPointsFace::set_vertices(const Vector3d *vertices)
+{
+    this->t1.set_points(vertices[0], vertices[1], vertices[2]);
+    this->t2.set_points(vertices[3], vertices[4], vertices[5]);
+}
+
 void FourPointsFace::print() {
     this->get_center().print();
 }
 
 Mesh::Mesh(vector<FourPointsFace> faces, Color color,
            IntensityColor dr, IntensityColor sr,
-           IntensityColor er, float shininess) : faces(faces), Object(color, dr, sr, er, shininess)
+           IntensityColor er, real shininess) : Object(color, dr, sr, er, shininess), faces(faces)
 {}
 
 Vector3d Mesh::get_center() {
@@ -370,45 +534,133 @@ Vector3d Mesh::get_center() {
         throw runtime_error("Malha inválida (não possui faces).");
     }
 
-    return v.divide(count);
+    // The average of the vertices follows any affine transformation, so there is no need to flush.
+    v = v.divide(count);
+    return this->transformation_pending ? this->pending_transformation.transform(v) : v;
 }
 
-void Mesh::apply_transformation(Matrix transformation)
+void Mesh::queue_transformation(Matrix4 transformation)
 {
-    for (auto &face : this->faces)
+    this->pending_transformation = transformation.multiply(this->pending_transformation);
+    this->transformation_pending = true;
+    this->bounds_valid = false;
+}
+
+void Mesh::flush_transformations()
+{
+    if (!this->transformation_pending) return;
+
+    this->transformation_pending = false;
+    if (this->pending_transformation.is_identity()) return;
+    TimelineScope scope("transform mesh");
+
+    // Vertices are gathered into coordinate arrays, transformed by the batched kernel and scattered back.
+    const int n = FourPointsFace::VERTEX_COUNT;
+    size_t count = this->faces.size() * n;
+    vector<real> x(count), y(count), z(count);
+    Vector3d vertices[n];
+    for (size_t f = 0; f < this->faces.size(); f++)
+    {
+        this->faces[f].get_vertices(vertices);
+        for (int v = 0; v < n; v++)
+        {
+            x[f * n + v] = vertices[v].x;
+            y[f * n + v] = vertices[v].y;
+            z[f * n + v] = vertices[v].z;
+        }
+    }
+
+    // Mesh vertices are always points.
+    this->pending_transformation.transform_points(x.data(), y.data(), z.data(), count);
+
+    for (size_t f = 0; f < this->faces.size(); f++)
     {
-        face.apply_transformation(transformation);
+        for (int v = 0; v < n; v++)
+        {
+            vertices[v] = Vector3d(x[f * n + v], y[f * n + v], z[f * n + v]);
+        }
+        this->faces[f].set_vertices(vertices);
     }
+    this->pending_transformation = Matrix4();
+    this->bounds_valid = false;
+}
+
+void Mesh::apply_transformation(Matrix4 transformation)
+{
+    this->queue_transformation(transformation);
 }
 
 void Mesh::apply_coordinate_change(Camera camera, int type_coord_change)
 {
-    for (auto &face : this->faces)
+    switch (type_coord_change)
     {
-        face.apply_coordinate_change(camera, type_coord_change);
+    case CHANGE_FROM_WORLD_TO_CAMERA:
+        this->queue_transformation(camera.get_world_to_camera_matrix());
+        break;
+
+    case CHANGE_FROM_CAMERA_TO_WORLD:
+        this->queue_transformation(camera.get_camera_to_world_matrix());
+        break;
+    default:
+        throw runtime_error("Tipo de mudança de coordenada inválida");
+        break;
     }
 }
 
-void Mesh::apply_scale_transformation(float sx, float sy, float sz)
+void Mesh::apply_scale_transformation(real sx, real sy, real sz)
 {
-    Vector3d fixed_point = this->get_center();
-    Matrix matrix_transformation = MatrixTransformations::scale(fixed_point, sx, sy, sz);
+    this->queue_transformation(MatrixTransformations::scale(this->get_center(), sx, sy, sz));
+}
 
-    for (auto& face : this->faces) {
-        face.apply_transformation(matrix_transformation);
+void Mesh::apply_rotation_transformation(real theta, int axis)
+{
+    this->queue_transformation(MatrixTransformations::rotation(theta, axis));
+}
+
+void Mesh::set_material(Color color, IntensityColor dr, IntensityColor sr, IntensityColor er, real shininess)
+{
+    Object::set_material(color, dr, sr, er, shininess);
+    for (auto &face : this->faces)
+    {
+        face.set_material(color, dr, sr, er, shininess);
     }
 }
 
-void Mesh::apply_rotation_transformation(float theta, int axis)
+void Mesh::set_optics(IntensityColor mirror_reflectivity, IntensityColor transmissivity, real refraction_index)
 {
-    Matrix rotation_matrix = MatrixTransformations::rotation(theta, axis);
+    Object::set_optics(mirror_reflectivity, transmissivity, refraction_index);
     for (auto &face : this->faces)
     {
-        face.apply_transformation(rotation_matrix);
+        face.set_optics(mirror_reflectivity, transmissivity, refraction_index);
     }
 }
 
+void Mesh::set_texture_coordinates(int face, const real *uv)
+{
+    if (this->texture_coordinates.empty()) {
+        this->texture_coordinates.assign(this->faces.size() * 8, NAN);
+    }
+    std::copy(uv, uv + 8, &this->texture_coordinates[(size_t)face * 8]);
+}
+
+bool Mesh::get_texture_coordinates(Vector3d intersec_point, Intersection intersection, TextureCoordinates &coordinates)
+{
+    if (this->texture_coordinates.empty()) return false;
+    int face = intersection.primitive_index / 2, half = intersection.primitive_index % 2;
+    const real *uv = &this->texture_coordinates[(size_t)face * 8];
+    if (std::isnan(uv[0])) return false;
+
+    // Same corners as the FourPointsFace constructor: t1 is (p1, p2, p3) and t2 is (p3, p4, p1).
+    real corners[6] = {uv[0], uv[1], uv[2], uv[3], uv[4], uv[5]};
+    if (half == 1) {
+        real second[6] = {uv[4], uv[5], uv[6], uv[7], uv[0], uv[1]};
+        std::copy(second, second + 6, corners);
+    }
+    return this->faces[face].get_half_triangle(half).interpolate_texture_coordinates(intersec_point, corners, coordinates);
+}
+
 void Mesh::print() {
+    this->flush_transformations();
     cout << "Face centers\n";
     for (auto& item : this->faces) {
         item.get_center().print();
@@ -417,27 +669,299 @@ void Mesh::print() {
 }
 
 Vector3d Mesh::get_normal_vector(Vector3d intersec_point, Intersection intersection) {
-    return intersection.intersepted_object->get_normal_vector(intersec_point, intersection);
+    int face = intersection.primitive_index / 2;
+    return this->faces[face].get_half_triangle(intersection.primitive_index % 2).get_normal_vector(intersec_point, intersection);
+}
+
+void Mesh::add_memory_usage(MemoryUsage &usage)
+{
+    usage.add(MEMORY_OBJECTS, sizeof(Mesh));
+    usage.add(MEMORY_MESH_GEOMETRY, get_vector_memory(this->faces) + get_vector_memory(this->texture_coordinates));
+}
+
+BoundingBox Mesh::get_bounds() {
+    // Intersection goes through here, so a mesh is flushed the first time it is traced after a change.
+    // Scene::prepare_frame flushes every object before the render threads start.
+    this->flush_transformations();
+    if (!this->bounds_valid) {
+        this->bounds = BoundingBox();
+        for (auto &face : this->faces) {
+            this->bounds.merge(face.get_bounds());
+        }
+        // Small margin, so flat meshes and rounding in the slab test never reject a real hit.
+        if (!this->bounds.is_empty()) {
+            Vector3d margin = this->bounds.max_point.minus(this->bounds.min_point).multiply(1e-3).sum(Vector3d(1e-3, 1e-3, 1e-3));
+            this->bounds = BoundingBox(this->bounds.min_point.minus(margin), this->bounds.max_point.sum(margin));
+        }
+        this->bounds_valid = true;
+    }
+    return this->bounds;
 }
 
 Intersection Mesh::get_intersection(Ray ray) {
 
     Intersection intersection_min(INFINITY, false);
 
-    for (auto& face : this->faces) {
-        Intersection intersection = face.get_intersection(ray);
+    // Rays that miss the whole mesh skip every face test.
+    if (!this->get_bounds().intersects_ray(ray)) {
+        return intersection_min;
+    }
+
+    size_t closest_face = 0;
+    for (size_t f = 0; f < this->faces.size(); f++) {
+        Intersection intersection = this->faces[f].get_intersection(ray);
         if (intersection.is_valid && intersection.time < intersection_min.time) {
             intersection_min = intersection;
+            closest_face = f;
+        }
+    }
+
+    if (intersection_min.is_valid) {
+        int half = this->faces[closest_face].get_half(intersection_min.intersepted_object);
+        intersection_min.primitive_index = (int)closest_face * 2 + half;
+        intersection_min.intersepted_object = this;
+    }
+    return intersection_min;
+}
+
+Intersection Mesh::get_primitive_intersection(Ray ray, int primitive_index) {
+    this->flush_transformations();
+    Intersection intersection = this->faces[primitive_index / 2].get_half_triangle(primitive_index % 2).get_intersection(ray);
+    if (intersection.is_valid) {
+        intersection.primitive_index = primitive_index;
+        intersection.intersepted_object = this;
+    }
+    return intersection;
+}
+
+CompactMesh::CompactMesh(const vector<Vector3d> &vertices, const vector<uint32_t> &quads, Color color,
+           IntensityColor dr, IntensityColor sr,
+           IntensityColor er, real shininess) : Object(color, dr, sr, er, shininess)
+{
+    this->build(vertices, quads);
+}
+
+CompactMesh::CompactMesh(Mesh &mesh) : Object(mesh)
+{
+    mesh.flush_transformations();
+
+    // Faces that share a corner share its vertex.
+    vector<Vector3d> vertices;
+    vector<uint32_t> quads;
+    map<tuple<real, real, real>, uint32_t> welded;
+    Vector3d face_vertices[FourPointsFace::VERTEX_COUNT];
+    for (auto &face : mesh.faces)
+    {
+        face.get_vertices(face_vertices);
+        // t1 is (p1, p2, p3) and t2 is (p3, p4, p1).
+        for (int corner : {0, 1, 2, 4})
+        {
+            Vector3d &p = face_vertices[corner];
+            auto key = make_tuple(p.x, p.y, p.z);
+            auto found = welded.find(key);
+            if (found == welded.end()) {
+                found = welded.insert({key, (uint32_t)vertices.size()}).first;
+                vertices.push_back(p);
+            }
+            quads.push_back(found->second);
+        }
+    }
+    this->build(vertices, quads);
+}
+
+void CompactMesh::build(const vector<Vector3d> &vertices, const vector<uint32_t> &quads)
+{
+    TimelineScope scope("build compact mesh");
+    if (quads.size() % 4 != 0) {
+        throw runtime_error("Malha compacta inválida (faces precisam de quatro índices).");
+    }
+    this->face_count = quads.size() / 4;
+
+    BoundingBox box;
+    for (auto vertex : vertices) {
+        box.expand(vertex);
+    }
+    if (box.is_empty()) {
+        box = BoundingBox(Vector3d(0, 0, 0), Vector3d(0, 0, 0));
+    }
+
+    // Each axis is spread over the whole 16 bit range; flat axes keep a zero step.
+    real origin[3] = {box.min_point.x, box.min_point.y, box.min_point.z};
+    real extent[3] = {box.max_point.x - origin[0], box.max_point.y - origin[1], box.max_point.z - origin[2]};
+    real step[3];
+    for (int axis = 0; axis < 3; axis++) {
+        step[axis] = extent[axis] / 65535;
+        this->decoding.m[axis][axis] = step[axis];
+        this->decoding.m[axis][3] = origin[axis];
+    }
+
+    this->positions.resize(vertices.size() * 3);
+    for (size_t v = 0; v < vertices.size(); v++) {
+        real coordinates[3] = {vertices[v].x, vertices[v].y, vertices[v].z};
+        for (int axis = 0; axis < 3; axis++) {
+            real q = step[axis] > 0 ? round((coordinates[axis] - origin[axis]) / step[axis]) : 0;
+            this->positions[v * 3 + axis] = (uint16_t)max((real)0, min((real)65535, q));
+        }
+    }
+
+    for (auto index : quads) {
+        if (index >= vertices.size()) {
+            throw runtime_error("Índice de vértice inválido na malha compacta: " + to_string(index));
+        }
+    }
+    if (vertices.size() <= 65536) {
+        this->short_indices.assign(quads.begin(), quads.end());
+    } else {
+        this->long_indices = quads;
+    }
+    this->bounds_valid = false;
+}
+
+uint32_t CompactMesh::get_index(size_t face, int corner)
+{
+    return this->short_indices.empty() ? this->long_indices[face * 4 + corner] : this->short_indices[face * 4 + corner];
+}
+
+Vector3d CompactMesh::get_vertex(uint32_t index)
+{
+    const uint16_t *q = &this->positions[index * 3];
+    return this->decoding.transform(Vector3d(q[0], q[1], q[2]));
+}
+
+void CompactMesh::get_triangle(int primitive_index, Vector3d &p1, Vector3d &p2, Vector3d &p3)
+{
+    size_t face = primitive_index / 2;
+    if (primitive_index % 2 == 0) {
+        p1 = this->get_vertex(this->get_index(face, 0));
+        p2 = this->get_vertex(this->get_index(face, 1));
+        p3 = this->get_vertex(this->get_index(face, 2));
+    } else {
+        p1 = this->get_vertex(this->get_index(face, 2));
+        p2 = this->get_vertex(this->get_index(face, 3));
+        p3 = this->get_vertex(this->get_index(face, 0));
+    }
+}
+
+size_t CompactMesh::get_face_count()
+{
+    return this->face_count;
+}
+
+size_t CompactMesh::get_memory_usage()
+{
+    return this->positions.size() * sizeof(uint16_t) + this->short_indices.size() * sizeof(uint16_t)
+        + this->long_indices.size() * sizeof(uint32_t);
+}
+
+Vector3d CompactMesh::get_normal_vector(Vector3d intersec_point, Intersection intersection)
+{
+    Vector3d p1, p2, p3;
+    this->get_triangle(intersection.primitive_index, p1, p2, p3);
+    return p2.minus(p1).vectorial_product(p3.minus(p1)).get_vector_normalized();
+}
+
+void CompactMesh::print()
+{
+    cout << "Malha compacta: " << this->face_count << " faces, " << this->positions.size() / 3 << " vértices, "
+         << this->get_memory_usage() << " bytes" << endl;
+}
+
+void CompactMesh::apply_transformation(Matrix4 transformation)
+{
+    this->decoding = transformation.multiply(this->decoding);
+    this->bounds_valid = false;
+}
+
+void CompactMesh::apply_scale_transformation(real sx, real sy, real sz)
+{
+    this->apply_transformation(MatrixTransformations::scale(this->get_center(), sx, sy, sz));
+}
+
+void CompactMesh::apply_rotation_transformation(real theta, int axis)
+{
+    this->apply_transformation(MatrixTransformations::rotation(theta, axis));
+}
+
+void CompactMesh::apply_coordinate_change(Camera camera, int type_coord_change)
+{
+    switch (type_coord_change)
+    {
+    case CHANGE_FROM_WORLD_TO_CAMERA:
+        this->apply_transformation(camera.get_world_to_camera_matrix());
+        break;
+
+    case CHANGE_FROM_CAMERA_TO_WORLD:
+        this->apply_transformation(camera.get_camera_to_world_matrix());
+        break;
+    default:
+        throw runtime_error("Tipo de mudança de coordenada inválida");
+        break;
+    }
+}
+
+Vector3d CompactMesh::get_center()
+{
+    return this->decoding.transform(Vector3d(65535 / 2.0, 65535 / 2.0, 65535 / 2.0));
+}
+
+void CompactMesh::add_memory_usage(MemoryUsage &usage)
+{
+    usage.add(MEMORY_OBJECTS, sizeof(CompactMesh));
+    usage.add(MEMORY_MESH_GEOMETRY, this->get_memory_usage());
+}
+
+BoundingBox CompactMesh::get_bounds()
+{
+    if (!this->bounds_valid) {
+        // Corners of the quantization box, in current coordinates.
+        this->bounds = BoundingBox();
+        for (int corner = 0; corner < 8; corner++) {
+            this->bounds.expand(this->decoding.transform(Vector3d(corner & 1 ? 65535 : 0, corner & 2 ? 65535 : 0, corner & 4 ? 65535 : 0)));
         }
+        Vector3d margin = this->bounds.max_point.minus(this->bounds.min_point).multiply(1e-3).sum(Vector3d(1e-3, 1e-3, 1e-3));
+        this->bounds = BoundingBox(this->bounds.min_point.minus(margin), this->bounds.max_point.sum(margin));
+        this->bounds_valid = true;
     }
+    return this->bounds;
+}
 
-    if (intersection_min.time != INFINITY) {
-        this->color = intersection_min.intersepted_object->color;
-        this->shininess = intersection_min.intersepted_object->shininess;
-        this->difuse_reflectivity = intersection_min.intersepted_object->difuse_reflectivity;
-        this->environment_reflectivity = intersection_min.intersepted_object->environment_reflectivity;
-        this->specular_reflectivity = intersection_min.intersepted_object->specular_reflectivity;
+Intersection CompactMesh::get_intersection(Ray ray)
+{
+    Intersection intersection_min(INFINITY, false);
+
+    // Rays that miss the whole mesh skip every face test.
+    if (!this->get_bounds().intersects_ray(ray)) {
+        return intersection_min;
     }
-    
+
+    for (size_t face = 0; face < this->face_count; face++)
+    {
+        Vector3d p[4];
+        for (int corner = 0; corner < 4; corner++) {
+            p[corner] = this->get_vertex(this->get_index(face, corner));
+        }
+
+        // Like FourPointsFace, the second half is only tested when the first one is missed.
+        int half = 0;
+        Intersection intersection = intersect_triangle(p[0], p[1], p[2], ray, this);
+        if (!intersection.is_valid) {
+            half = 1;
+            intersection = intersect_triangle(p[2], p[3], p[0], ray, this);
+        }
+        if (intersection.is_valid && intersection.time < intersection_min.time) {
+            intersection_min = intersection;
+            intersection_min.primitive_index = face * 2 + half;
+        }
+    }
+
     return intersection_min;
-}
\ No newline at end of file
+}
+
+Intersection CompactMesh::get_primitive_intersection(Ray ray, int primitive_index)
+{
+    Vector3d p1, p2, p3;
+    this->get_triangle(primitive_index, p1, p2, p3);
+    Intersection intersection = intersect_triangle(p1, p2, p3, ray, this);
+    intersection.primitive_index = primitive_index;
+    return intersection;
+}
@@ -1,63 +1,734 @@
 #include "Reader.hpp"
+#include "StaticScene.hpp"
+#include "Timeline.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <map>
+#include <functional>
+#include <future>
+#include <charconv>
+#include <cstring>
+#include <thread>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 using namespace atividades_cg_1::reader;
+using namespace atividades_cg_1::timeline;
 
-vector<string> custom_split(string str, char separator) {
-    vector<string> strings;
-    int startIndex = 0, endIndex = 0;
-    for (int i = 0; i <= str.size(); i++) {
-        
-        // If we reached the end of the word or the end of the input.
-        if (str[i] == separator || i == str.size()) {
-            endIndex = i;
-            string temp;
-            temp.append(str, startIndex, endIndex - startIndex);
-            strings.push_back(temp);
-            startIndex = endIndex + 1;
+// A file mapped read-only into memory, so the OBJ parser reads the page cache instead of a copy of the file.
+class MappedFile {
+    public:
+        const char *data = "";
+        size_t size = 0;
+
+        MappedFile(string file_path) {
+            int fd = open(file_path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw runtime_error("Não foi possível abrir o arquivo OBJ " + file_path + ": " + strerror(errno));
+            }
+            struct stat status;
+            if (fstat(fd, &status) < 0) {
+                int error = errno;
+                close(fd);
+                throw runtime_error("Não foi possível ler o tamanho do arquivo OBJ " + file_path + ": " + strerror(error));
+            }
+            // mmap rejects empty mappings; an empty file just has no lines.
+            if (status.st_size > 0) {
+                void *mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    int error = errno;
+                    close(fd);
+                    throw runtime_error("Não foi possível mapear o arquivo OBJ " + file_path + ": " + strerror(error));
+                }
+                this->data = (const char *)mapping;
+                this->size = status.st_size;
+            }
+            close(fd);
+        }
+
+        ~MappedFile() {
+            if (this->size > 0) munmap((void *)this->data, this->size);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+};
+
+// Vertices and faces read from one chunk of an OBJ file. Face indices are kept as written: negative (relative)
+// ones can only be resolved by the merge, once every chunk knows how many vertices come before it.
+class ObjChunk {
+    public:
+        vector<Vector3d> vertices;
+        vector<real> texture_coordinates; // u and v of every `vt` line.
+        vector<int> indices;         // Vertex indices of every face, back to back.
+        vector<int> texture_indices; // Texture coordinate index of each entry of indices, 0 when there is none.
+        vector<int> face_starts;     // First entry of each face in indices.
+        vector<int> vertices_before; // Vertices of this chunk read before each face.
+        vector<int> texture_coordinates_before; // Same for texture coordinates.
+        int mesh_faces = 0;          // FourPointsFaces the faces turn into.
+};
+
+static inline const char *skip_blanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static inline bool is_command(const char *p, const char *end, char command) {
+    return end - p >= 2 && p[0] == command && (p[1] == ' ' || p[1] == '\t');
+}
+
+static inline bool is_texture_coordinates(const char *p, const char *end) {
+    return end - p >= 3 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t');
+}
+
+// Parses the complete lines in [begin, end). Only `v`, `vt` and `f` lines matter, everything else is skipped.
+static ObjChunk parse_obj_chunk(const char *begin, const char *end) {
+    ObjChunk chunk;
+    for (const char *line = begin; line < end;)
+    {
+        const char *line_end = (const char *)memchr(line, '\n', end - line);
+        if (line_end == NULL) line_end = end;
+        const char *p = skip_blanks(line, line_end);
+
+        if (is_command(p, line_end, 'v'))
+        {
+            real xyz[3] = {0, 0, 0};
+            p += 2;
+            for (int i = 0; i < 3; i++) {
+                p = skip_blanks(p, line_end);
+                p = std::from_chars(p, line_end, xyz[i]).ptr;
+            }
+            chunk.vertices.push_back(Vector3d(xyz[0], xyz[1], xyz[2]));
+        }
+        else if (is_texture_coordinates(p, line_end))
+        {
+            real uv[2] = {0, 0};
+            p += 3;
+            for (int i = 0; i < 2; i++) {
+                p = skip_blanks(p, line_end);
+                p = std::from_chars(p, line_end, uv[i]).ptr;
+            }
+            // OBJ puts v = 0 at the bottom of the image, textures at the top.
+            chunk.texture_coordinates.push_back(uv[0]);
+            chunk.texture_coordinates.push_back(1 - uv[1]);
+        }
+        else if (is_command(p, line_end, 'f'))
+        {
+            int first = chunk.indices.size();
+            chunk.face_starts.push_back(first);
+            chunk.vertices_before.push_back(chunk.vertices.size());
+            chunk.texture_coordinates_before.push_back(chunk.texture_coordinates.size() / 2);
+
+            // Each token is v, v/vt, v//vn or v/vt/vn; the normal is not used.
+            for (p = skip_blanks(p + 2, line_end); p < line_end; p = skip_blanks(p, line_end)) {
+                int index, texture_index = 0;
+                auto result = std::from_chars(p, line_end, index);
+                if (result.ec != std::errc()) {
+                    throw runtime_error("Face inválida no arquivo OBJ: " + string(line, line_end));
+                }
+                p = result.ptr;
+                if (p + 1 < line_end && *p == '/' && p[1] != '/') {
+                    result = std::from_chars(p + 1, line_end, texture_index);
+                    if (result.ec != std::errc()) {
+                        throw runtime_error("Face inválida no arquivo OBJ: " + string(line, line_end));
+                    }
+                    p = result.ptr;
+                }
+                chunk.indices.push_back(index);
+                chunk.texture_indices.push_back(texture_index);
+                for (; p < line_end && *p != ' ' && *p != '\t' && *p != '\r'; p++);
+            }
+
+            // Positions in indices are ints; read_obj_indices checks the vertex and face totals.
+            if (chunk.indices.size() > INT_MAX) {
+                throw runtime_error("Arquivo OBJ grande demais");
+            }
+            int count = chunk.indices.size() - first;
+            if (count < 3) {
+                throw runtime_error("Face com menos de três vértices no arquivo OBJ: " + string(line, line_end));
+            }
+            chunk.mesh_faces += (count - 1) / 2;
+        }
+        line = line_end + 1;
+    }
+    return chunk;
+}
+
+// Reads the vertices of file_path into reader.vertices (and the `vt` lines into reader.texture_coordinates), calls
+// resize(face_count) and then, from several threads, emit(face, corners, texture_corners) with the four vertex
+// indices of each face (FourPointsFace order) and their texture coordinate indices, NULL when some corner has none.
+template <typename Resize, typename Emit>
+static void read_obj_indices(ObjReader &reader, string file_path, Resize resize, Emit emit)
+{
+    TimelineScope scope("parse obj");
+    MappedFile file(file_path);
+    const char *data = file.data;
+    const char *data_end = data + file.size;
+
+    // Chunks of at least OBJ_MIN_CHUNK_SIZE bytes, one per thread, cut right after a line break.
+    int thread_count = reader.thread_count > 0 ? reader.thread_count : max(1u, thread::hardware_concurrency());
+    size_t chunk_count = min((size_t)thread_count, file.size / OBJ_MIN_CHUNK_SIZE + 1);
+    vector<const char *> bounds = {data};
+    for (size_t c = 1; c < chunk_count; c++) {
+        const char *cut = max(bounds.back(), data + file.size * c / chunk_count);
+        const char *line_break = (const char *)memchr(cut, '\n', data_end - cut);
+        bounds.push_back(line_break == NULL ? data_end : line_break + 1);
+    }
+    bounds.push_back(data_end);
+
+    vector<future<ObjChunk>> parsing;
+    for (size_t c = 0; c < chunk_count; c++) {
+        parsing.push_back(std::async(std::launch::async, parse_obj_chunk, bounds[c], bounds[c + 1]));
+    }
+    vector<ObjChunk> chunks;
+    for (auto &chunk : parsing) {
+        chunks.push_back(chunk.get());
+    }
+
+    // Prefix sums: where the vertices and the faces of each chunk start in the whole mesh.
+    vector<size_t> vertex_offsets(chunk_count + 1, 0), face_offsets(chunk_count + 1, 0), texture_offsets(chunk_count + 1, 0);
+    for (size_t c = 0; c < chunk_count; c++) {
+        vertex_offsets[c + 1] = vertex_offsets[c] + chunks[c].vertices.size();
+        face_offsets[c + 1] = face_offsets[c] + chunks[c].mesh_faces;
+        texture_offsets[c + 1] = texture_offsets[c] + chunks[c].texture_coordinates.size() / 2;
+    }
+    // Vertex indices are emitted as ints and each face holds two primitives, whose index is face * 2 + half.
+    if (vertex_offsets[chunk_count] > INT_MAX || texture_offsets[chunk_count] > INT_MAX
+        || face_offsets[chunk_count] > INT_MAX / 2) {
+        throw runtime_error("Arquivo OBJ grande demais: " + file_path);
+    }
+    reader.vertices.resize(vertex_offsets[chunk_count]);
+    reader.texture_coordinates.resize(texture_offsets[chunk_count] * 2);
+    resize(face_offsets[chunk_count]);
+
+    auto merge = [&](int c) {
+        ObjChunk &chunk = chunks[c];
+
+        int face_index = face_offsets[c];
+        for (size_t f = 0; f < chunk.face_starts.size(); f++) {
+            int first = chunk.face_starts[f];
+            int last = f + 1 < chunk.face_starts.size() ? chunk.face_starts[f + 1] : (int)chunk.indices.size();
+
+            auto vertex = [&](int i) {
+                int index = chunk.indices[first + i];
+                // 1 is the first vertex of the file, -1 the last one read before this face.
+                int64_t resolved = index > 0 ? (int64_t)index - 1 : (int64_t)(vertex_offsets[c] + chunk.vertices_before[f]) + index;
+                if (index == 0 || resolved < 0 || resolved >= (int64_t)vertex_offsets[chunk_count]) {
+                    throw runtime_error("Índice de vértice inválido no arquivo OBJ: " + to_string(index));
+                }
+                return (int)resolved;
+            };
+            bool textured = true;
+            auto texture_coordinates = [&](int i) {
+                int index = chunk.texture_indices[first + i];
+                int64_t resolved = index > 0 ? (int64_t)index - 1
+                                             : (int64_t)(texture_offsets[c] + chunk.texture_coordinates_before[f]) + index;
+                if (resolved < 0 || resolved >= (int64_t)texture_offsets[chunk_count]) {
+                    throw runtime_error("Índice de coordenada de textura inválido no arquivo OBJ: " + to_string(index));
+                }
+                return (int)resolved;
+            };
+
+            int count = last - first;
+            for (int i = 0; i < count; i++) {
+                textured = textured && chunk.texture_indices[first + i] != 0;
+            }
+
+            // Polygons become a fan of quads around their first vertex, closed by a triangle when the count is
+            // odd. Triangles repeat their first vertex, so the second half of the face has no area.
+            for (int i = 1; i + 1 < count; i += 2) {
+                int corners[4] = {0, i, i + 1, i + 2 < count ? i + 2 : 0};
+                int vertices[4], textures[4];
+                for (int k = 0; k < 4; k++) {
+                    vertices[k] = vertex(corners[k]);
+                    if (textured) textures[k] = texture_coordinates(corners[k]);
+                }
+                emit(face_index++, vertices, textured ? textures : (const int *)NULL);
+            }
         }
+    };
+
+    // Vertices are copied before any face reads them, so faces can point into any chunk.
+    vector<future<void>> merging;
+    for (size_t c = 0; c < chunk_count; c++) {
+        merging.push_back(std::async(std::launch::async, [&, c]() {
+            std::copy(chunks[c].vertices.begin(), chunks[c].vertices.end(), reader.vertices.begin() + vertex_offsets[c]);
+            std::copy(chunks[c].texture_coordinates.begin(), chunks[c].texture_coordinates.end(),
+                      reader.texture_coordinates.begin() + texture_offsets[c] * 2);
+        }));
+    }
+    for (auto &m : merging) m.get();
+    merging.clear();
+    for (size_t c = 0; c < chunk_count; c++) {
+        merging.push_back(std::async(std::launch::async, merge, c));
     }
-    return strings;
+    for (auto &m : merging) m.get();
 }
 
 Mesh* ObjReader::read_obj_file(string file_path)
 {
+    // Faces are emitted from several threads, so the texture coordinates of every face are allocated up front,
+    // and only when the file has `vt` lines.
+    vector<real> face_texture_coordinates;
+    read_obj_indices(*this, file_path,
+        [&](size_t face_count) {
+            this->faces.resize(face_count);
+            if (!this->texture_coordinates.empty()) face_texture_coordinates.assign(face_count * 8, NAN);
+        },
+        [&](int face, const int *corners, const int *texture_corners) {
+            this->faces[face] = FourPointsFace(this->vertices[corners[0]], this->vertices[corners[1]],
+                                               this->vertices[corners[2]], this->vertices[corners[3]]);
+            if (texture_corners != NULL) {
+                for (int k = 0; k < 4; k++) {
+                    face_texture_coordinates[(size_t)face * 8 + 2 * k] = this->texture_coordinates[2 * texture_corners[k]];
+                    face_texture_coordinates[(size_t)face * 8 + 2 * k + 1] = this->texture_coordinates[2 * texture_corners[k] + 1];
+                }
+            }
+        });
+    Mesh *mesh = new Mesh(this->faces);
+    mesh->texture_coordinates = std::move(face_texture_coordinates);
+    return mesh;
+}
+
+CompactMesh* ObjReader::read_compact_obj_file(string file_path)
+{
+    vector<uint32_t> quads;
+    read_obj_indices(*this, file_path, [&](size_t face_count) { quads.resize(face_count * 4); },
+        // CompactMesh has no texture coordinates, so the `vt` indices of each face are ignored.
+        [&](int face, const int *corners, const int *) {
+            std::copy(corners, corners + 4, &quads[face * 4]);
+        });
+    return new CompactMesh(this->vertices, quads);
+}
+
+class MaterialDescription {
+    public:
+        Color color = Color(255, 255, 255);
+        IntensityColor difuse_reflectivity = IntensityColor(.7, .7, .7);
+        IntensityColor specular_reflectivity = IntensityColor(.7, .7, .7);
+        IntensityColor environment_reflectivity = IntensityColor(.7, .7, .7);
+        real shininess = 10;
+        IntensityColor mirror_reflectivity = IntensityColor(0, 0, 0);
+        IntensityColor transmissivity = IntensityColor(0, 0, 0);
+        real refraction_index = 1;
+        shared_ptr<const Texture> texture;
+        real texture_scale = 1;
+};
+
+// An object line of the scene file. Meshes only get their object once the asset finishes loading.
+class ObjectDescription {
+    public:
+        Object *object = NULL;
+        std::string asset;
+        MaterialDescription material;
+        std::string transformations;
+        int line_number;
+        // Optional bounds of a mesh, drawn as a box while the asset loads.
+        BoundingBox bounds;
+        bool has_bounds = false;
+};
+
+static runtime_error scene_error(string file_path, int line_number, string message) {
+    return runtime_error(file_path + ":" + to_string(line_number) + ": " + message);
+}
+
+static IntensityColor read_intensity(istringstream &iss) {
+    real r, g, b;
+    iss >> r >> g >> b;
+    return IntensityColor(r, g, b);
+}
+
+static Color read_color(istringstream &iss) {
+    int r, g, b;
+    iss >> r >> g >> b;
+    return Color(r, g, b);
+}
+
+static Vector3d read_vector(istringstream &iss) {
+    real x, y, z;
+    iss >> x >> y >> z;
+    return Vector3d(x, y, z);
+}
+
+static int read_axis(string axis) {
+    if (axis == "x") return X_AXIS;
+    if (axis == "y") return Y_AXIS;
+    if (axis == "z") return Z_AXIS;
+    throw runtime_error("Eixo de rotação inválido: " + axis);
+}
+
+// Calls transform for each translation and rotation and scale for each scale, in the order written.
+static void read_transformations(string transformations, function<void(Matrix4)> transform, function<void(Vector3d)> scale) {
+    istringstream iss(transformations);
+    string type;
+    while (iss >> type) {
+        if (type == "translate") {
+            Vector3d t = read_vector(iss);
+            transform(MatrixTransformations::translation(t.x, t.y, t.z));
+        } else if (type == "rotate") {
+            string axis;
+            real degrees;
+            iss >> axis >> degrees;
+            transform(MatrixTransformations::rotation(degrees * M_PI / 180, read_axis(axis)));
+        } else if (type == "scale") {
+            scale(read_vector(iss));
+        } else {
+            throw runtime_error("Transformação desconhecida: " + type);
+        }
+    }
+}
+
+void atividades_cg_1::reader::apply_transformations(Object *object, string transformations) {
+    read_transformations(transformations,
+        [&](Matrix4 transformation) { object->apply_transformation(transformation); },
+        [&](Vector3d s) { object->apply_scale_transformation(s.x, s.y, s.z); });
+}
+
+Matrix4 atividades_cg_1::reader::get_transformation_matrix(string transformations, Vector3d center) {
+    Matrix4 result;
+    read_transformations(transformations,
+        [&](Matrix4 transformation) {
+            result = transformation.multiply(result);
+            center = transformation.transform(center);
+        },
+        [&](Vector3d s) { result = Matrix4(MatrixTransformations::scale(center, s.x, s.y, s.z)).multiply(result); });
+    return result;
+}
+
+static string resolve_path(string scene_path, string asset_path) {
+    size_t separator = scene_path.find_last_of('/');
+    if (asset_path.empty() || asset_path[0] == '/' || separator == string::npos) {
+        return asset_path;
+    }
+    return scene_path.substr(0, separator + 1) + asset_path;
+}
+
+Scene* SceneReader::read_scene_file(string file_path)
+{
+    TimelineScope scope("load scene");
     std::ifstream file(file_path);
+    if (!file) {
+        throw runtime_error("Não foi possível abrir o arquivo de cena " + file_path);
+    }
+
+    Camera camera;
+    bool has_camera = false;
+    Color background_color(0, 0, 0);
+    IntensityColor environment_light(0, 0, 0);
+    vector<SourceOfLight> lights;
+    map<string, MaterialDescription> materials;
+    map<string, shared_ptr<const Texture>> textures;
+    map<string, string> asset_paths;
+    map<string, bool> compact_assets;
+    map<string, shared_future<Object*>> loading_assets;
+    map<string, shared_ptr<int>> asset_references;
+    vector<ObjectDescription> descriptions;
+
+    auto find_material = [&](string name, int line_number) {
+        if (!materials.count(name)) {
+            throw scene_error(file_path, line_number, "material desconhecido " + name);
+        }
+        return materials[name];
+    };
+
     std::string line;
+    int line_number = 0;
     while (std::getline(file, line))
     {
+        line_number++;
         std::istringstream iss(line);
         std::string type;
-        iss >> type;
+        if (!(iss >> type) || type[0] == '#') continue;
 
-        if (type == "v")
+        // camera eye x y z look_at x y z view_up x y z focal d window width height cols rows
+        if (type == "camera")
+        {
+            Vector3d eye, look_at, view_up;
+            real focal_distance = 1, width = 60, height = 60;
+            int cols = 500, rows = 500;
+            string key;
+            while (iss >> key) {
+                if (key == "eye") eye = read_vector(iss);
+                else if (key == "look_at") look_at = read_vector(iss);
+                else if (key == "view_up") view_up = read_vector(iss);
+                else if (key == "focal") iss >> focal_distance;
+                else if (key == "window") iss >> width >> height >> cols >> rows;
+                else throw scene_error(file_path, line_number, "parâmetro de câmera desconhecido " + key);
+            }
+            camera = Camera(look_at, eye, view_up, focal_distance, width, height, cols, rows);
+            has_camera = true;
+        }
+        else if (type == "background")
+        {
+            background_color = read_color(iss);
+        }
+        else if (type == "ambient")
         {
-            float x; float y; float z;
-            iss >> x >> y >> z;
-            this->vertices.push_back(Vector3d(x,y,z));
+            environment_light = read_intensity(iss);
         }
-        else if (type == "f")
+        // light x y z r g b [rectangle ux uy uz vx vy vz samples n | sphere radius samples n]
+        else if (type == "light")
         {
-            vector<Vector3d> face_vertices;
+            Vector3d center = read_vector(iss);
+            IntensityColor intensity = read_intensity(iss);
+            string shape, key;
+            int samples = 16;
+            if (!(iss >> shape)) {
+                lights.push_back(SourceOfLight(intensity, center));
+            } else if (shape == "rectangle") {
+                Vector3d edge_u = read_vector(iss);
+                Vector3d edge_v = read_vector(iss);
+                if (iss >> key && key == "samples") iss >> samples;
+                lights.push_back(SourceOfLight::rectangle(intensity, center, edge_u, edge_v, samples));
+            } else if (shape == "sphere") {
+                real radius;
+                iss >> radius;
+                if (iss >> key && key == "samples") iss >> samples;
+                lights.push_back(SourceOfLight::sphere(intensity, center, radius, samples));
+            } else {
+                throw scene_error(file_path, line_number, "formato de luz desconhecido " + shape);
+            }
+        }
+        // material name color r g b kd r g b ks r g b ka r g b shininess s [reflect r g b] [refract r g b index]
+        //          [texture file.ppm] [texture_scale s]
+        else if (type == "material")
+        {
+            string name, key;
+            iss >> name;
+            MaterialDescription material;
+            while (iss >> key) {
+                if (key == "color") material.color = read_color(iss);
+                else if (key == "kd") material.difuse_reflectivity = read_intensity(iss);
+                else if (key == "ks") material.specular_reflectivity = read_intensity(iss);
+                else if (key == "ka") material.environment_reflectivity = read_intensity(iss);
+                else if (key == "shininess") iss >> material.shininess;
+                else if (key == "reflect") material.mirror_reflectivity = read_intensity(iss);
+                else if (key == "refract") {
+                    material.transmissivity = read_intensity(iss);
+                    iss >> material.refraction_index;
+                }
+                else if (key == "texture") {
+                    string path;
+                    iss >> path;
+                    path = resolve_path(file_path, path);
+                    // Materials sharing an image share its texels and mip levels.
+                    if (!textures.count(path)) {
+                        try {
+                            textures[path] = Texture::load(path);
+                        } catch (runtime_error &error) {
+                            throw scene_error(file_path, line_number, error.what());
+                        }
+                    }
+                    material.texture = textures[path];
+                }
+                else if (key == "texture_scale") iss >> material.texture_scale;
+                else throw scene_error(file_path, line_number, "parâmetro de material desconhecido " + key);
+            }
+            materials[name] = material;
+        }
+        // asset name path/to/file.obj
+        else if (type == "asset")
+        {
+            string name, path, storage;
+            iss >> name >> path;
+            asset_paths[name] = resolve_path(file_path, path);
+            compact_assets[name] = iss >> storage && storage == "compact";
+        }
+        else if (type == "sphere" || type == "plan" || type == "mesh")
+        {
+            ObjectDescription description;
+            description.line_number = line_number;
+            string material_name;
+
+            // sphere cx cy cz radius material [transformations]
+            if (type == "sphere") {
+                Vector3d center = read_vector(iss);
+                real radius;
+                iss >> radius >> material_name;
+                description.material = find_material(material_name, line_number);
+                MaterialDescription &m = description.material;
+                description.object = new Sphere(center, radius, m.color, m.difuse_reflectivity, m.specular_reflectivity, m.environment_reflectivity, m.shininess);
+            }
+            // plan px py pz nx ny nz material [transformations]
+            else if (type == "plan") {
+                Vector3d known_point = read_vector(iss);
+                Vector3d normal = read_vector(iss);
+                iss >> material_name;
+                description.material = find_material(material_name, line_number);
+                MaterialDescription &m = description.material;
+                description.object = new Plan(known_point, normal, m.difuse_reflectivity, m.specular_reflectivity, m.environment_reflectivity, m.shininess, m.color);
+            }
+            // mesh asset material [bounds x0 y0 z0 x1 y1 z1] [transformations]
+            else {
+                iss >> description.asset >> material_name;
+                description.material = find_material(material_name, line_number);
+                if (!asset_paths.count(description.asset)) {
+                    throw scene_error(file_path, line_number, "asset desconhecido " + description.asset);
+                }
 
-            FourPointsFace f;
-            int vertix_index;
+                string key;
+                streampos position = iss.tellg();
+                if (iss >> key && key == "bounds") {
+                    Vector3d min_point = read_vector(iss);
+                    description.bounds = BoundingBox(min_point, read_vector(iss));
+                    description.has_bounds = true;
+                } else {
+                    iss.clear();
+                    iss.seekg(position);
+                }
 
-            std::string output;
+                // First reference starts reading the asset in background.
+                if (!loading_assets.count(description.asset)) {
+                    string path = asset_paths[description.asset];
+                    bool compact = compact_assets[description.asset];
+                    loading_assets[description.asset] = std::async(std::launch::async, [path, compact, file_path, line_number]() {
+                        try {
+                            ObjReader reader;
+                            return compact ? (Object *)reader.read_compact_obj_file(path) : (Object *)reader.read_obj_file(path);
+                        } catch (runtime_error &error) {
+                            throw scene_error(file_path, line_number, error.what());
+                        }
+                    }).share();
+                    asset_references[description.asset] = make_shared<int>(0);
+                }
+                (*asset_references[description.asset])++;
+            }
 
-            while (iss >> output) {
-                vertix_index = std::stoi(custom_split(output, '/')[0]) - 1;
-                face_vertices.push_back(this->vertices[vertix_index]);
+            std::getline(iss, description.transformations);
+            descriptions.push_back(description);
+        }
+        // animation frames N
+        else if (type == "animation")
+        {
+            string key;
+            iss >> key >> this->animation.frame_count;
+            if (key != "frames" || this->animation.frame_count <= 0) {
+                throw scene_error(file_path, line_number, "esperado: animation frames N");
             }
-            this->faces.push_back(FourPointsFace(face_vertices[0], face_vertices[1], face_vertices[2], face_vertices[3]));
         }
+        // turntable cx cy cz radius height
+        else if (type == "turntable")
+        {
+            this->animation.camera_mode = CAMERA_TURNTABLE;
+            this->animation.target = read_vector(iss);
+            iss >> this->animation.radius >> this->animation.height;
+        }
+        // flythrough from x y z to x y z look_at x y z
+        else if (type == "flythrough")
+        {
+            this->animation.camera_mode = CAMERA_FLYTHROUGH;
+            string key;
+            while (iss >> key) {
+                if (key == "from") this->animation.from = read_vector(iss);
+                else if (key == "to") this->animation.to = read_vector(iss);
+                else if (key == "look_at") this->animation.target = read_vector(iss);
+                else throw scene_error(file_path, line_number, "parâmetro de flythrough desconhecido " + key);
+            }
+        }
+        // spin object_index <x|y|z> degrees_per_frame [pivot x y z]
+        // move object_index dx dy dz
+        // object_index counts sphere, plan and mesh lines from 0, in file order.
+        else if (type == "spin" || type == "move")
+        {
+            int object_index;
+            iss >> object_index;
+            Matrix per_frame_transformation;
+
+            if (type == "spin") {
+                string axis, key;
+                real degrees;
+                Vector3d pivot(0, 0, 0);
+                iss >> axis >> degrees;
+                if (iss >> key && key == "pivot") pivot = read_vector(iss);
+
+                Matrix rotation = MatrixTransformations::rotation(degrees * M_PI / 180, read_axis(axis));
+                per_frame_transformation = MatrixTransformations::translation(pivot.x, pivot.y, pivot.z)
+                    .multiply(rotation)
+                    .multiply(MatrixTransformations::translation(-pivot.x, -pivot.y, -pivot.z));
+            } else {
+                Vector3d t = read_vector(iss);
+                per_frame_transformation = MatrixTransformations::translation(t.x, t.y, t.z);
+            }
+            this->animation.object_animations.push_back(ObjectAnimation(object_index, per_frame_transformation));
+        }
+        else
+        {
+            throw scene_error(file_path, line_number, "comando desconhecido " + type);
+        }
+    }
+
+    for (auto &object_animation : this->animation.object_animations) {
+        if (object_animation.object_index < 0 || (size_t)object_animation.object_index >= descriptions.size()) {
+            throw runtime_error(file_path + ": objeto animado inexistente " + to_string(object_animation.object_index));
+        }
+    }
+
+    if (!has_camera) {
+        throw runtime_error(file_path + ": a cena precisa de uma câmera");
+    }
+    if (lights.empty()) {
+        throw runtime_error(file_path + ": a cena precisa de pelo menos uma luz");
+    }
+
+    Scene *scene = this->static_dispatch ? new ProductionScene(background_color, lights[0], environment_light, camera)
+                                         : new Scene(background_color, lights[0], environment_light, camera);
+    for (size_t i = 1; i < lights.size(); i++) {
+        scene->push_light(lights[i]);
+    }
+
+    for (auto &description : descriptions)
+    {
+        MaterialDescription m = description.material;
+        string transformations = description.transformations;
+        try {
+            if (description.asset.empty()) {
+                description.object->set_optics(m.mirror_reflectivity, m.transmissivity, m.refraction_index);
+                if (m.texture != nullptr) description.object->set_texture(m.texture, m.texture_scale);
+                apply_transformations(description.object, transformations);
+            } else if (description.has_bounds) {
+                description.object = ObjFactory::create_box(description.bounds);
+                description.object->set_material(m.color, m.difuse_reflectivity, m.specular_reflectivity, m.environment_reflectivity, m.shininess);
+                apply_transformations(description.object, transformations);
+            } else {
+                // Object transformations are no-ops, this only checks the syntax before the mesh arrives.
+                Object probe;
+                apply_transformations(&probe, transformations);
+            }
+        } catch (runtime_error &error) {
+            throw scene_error(file_path, description.line_number, error.what());
+        }
+
+        if (description.asset.empty()) {
+            scene->push_object(description.object);
+            continue;
+        }
+
+        // Meshes join the scene when their asset is loaded. The last instance of an asset to be ready takes the
+        // loaded mesh, the others get copies.
+        shared_ptr<int> references = asset_references[description.asset];
+        bool compact = compact_assets[description.asset];
+        scene->push_pending_mesh(loading_assets[description.asset], [m, transformations, references, compact](Object *prototype) {
+            Object *mesh = prototype;
+            if (--(*references) > 0) {
+                mesh = compact ? (Object *)new CompactMesh(*(CompactMesh *)prototype) : (Object *)new Mesh(*(Mesh *)prototype);
+            }
+            mesh->set_material(m.color, m.difuse_reflectivity, m.specular_reflectivity, m.environment_reflectivity, m.shininess);
+            mesh->set_optics(m.mirror_reflectivity, m.transmissivity, m.refraction_index);
+            if (m.texture != nullptr) mesh->set_texture(m.texture, m.texture_scale);
+            apply_transformations(mesh, transformations);
+            return mesh;
+        }, description.object);
     }
-    return new Mesh(this->faces);
+
+    return scene;
 }
 
 Mesh* ObjFactory::create_cube() {
@@ -71,4 +742,39 @@ Mesh* ObjFactory::create_cube() {
     mesh->apply_transformation(translation_matrix);
     mesh->apply_transformation(scale_matrix);
     return mesh;
-}
\ No newline at end of file
+}
+
+Mesh* ObjFactory::create_box(BoundingBox box) {
+    real x0 = box.min_point.x, y0 = box.min_point.y, z0 = box.min_point.z;
+    real x1 = box.max_point.x, y1 = box.max_point.y, z1 = box.max_point.z;
+
+    // Counter-clockwise seen from outside, so every normal points out of the box.
+    vector<FourPointsFace> faces = {
+        FourPointsFace(Vector3d(x0, y1, z0), Vector3d(x0, y1, z1), Vector3d(x1, y1, z1), Vector3d(x1, y1, z0)),
+        FourPointsFace(Vector3d(x0, y0, z0), Vector3d(x1, y0, z0), Vector3d(x1, y0, z1), Vector3d(x0, y0, z1)),
+        FourPointsFace(Vector3d(x0, y0, z1), Vector3d(x1, y0, z1), Vector3d(x1, y1, z1), Vector3d(x0, y1, z1)),
+        FourPointsFace(Vector3d(x0, y0, z0), Vector3d(x0, y1, z0), Vector3d(x1, y1, z0), Vector3d(x1, y0, z0)),
+        FourPointsFace(Vector3d(x1, y0, z0), Vector3d(x1, y1, z0), Vector3d(x1, y1, z1), Vector3d(x1, y0, z1)),
+        FourPointsFace(Vector3d(x0, y0, z0), Vector3d(x0, y0, z1), Vector3d(x0, y1, z1), Vector3d(x0, y1, z0)),
+    };
+    return new Mesh(faces);
+}
+
+Mesh* ObjFactory::create_grid(int divisions, real size, real wave_height) {
+    vector<FourPointsFace> faces;
+    real step = size / divisions;
+
+    auto vertex = [&](int i, int j) {
+        real x = -size / 2 + i * step;
+        real z = -size / 2 + j * step;
+        real y = wave_height * std::sin(i * M_PI / 4) * std::cos(j * M_PI / 4);
+        return Vector3d(x, y, z);
+    };
+
+    for (int i = 0; i < divisions; i++) {
+        for (int j = 0; j < divisions; j++) {
+            faces.push_back(FourPointsFace(vertex(i, j), vertex(i, j + 1), vertex(i + 1, j + 1), vertex(i + 1, j)));
+        }
+    }
+    return new Mesh(faces);
+}
@@ -0,0 +1,647 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Regression.hpp"
+#include "Distributed.hpp"
+#include "Image.hpp"
+#include "Reader.hpp"
+#include "Render.hpp"
+#include "StaticScene.hpp"
+
+using namespace std;
+using namespace atividades_cg_1::regression;
+using namespace atividades_cg_1::distributed;
+using namespace atividades_cg_1::image;
+using namespace atividades_cg_1::reader;
+using namespace atividades_cg_1::render;
+
+
+// Every reference scene is seen through a 60x60 window placed 80 units in front of the eye.
+static Camera reference_camera(Vector3d eye, Vector3d look_at, int cols, int rows)
+{
+    Vector3d view_up(eye.x, eye.y + 1000, eye.z);
+    return Camera(look_at, eye, view_up, 80, 60, 60, cols, rows);
+}
+
+
+static Scene *build_spheres_scene(int cols, int rows)
+{
+    SourceOfLight light(IntensityColor(.8, .8, .8), Vector3d(0, 150, -50));
+    Scene *scene = new Scene(Color(20, 20, 40), light, IntensityColor(.3, .3, .3),
+                             reference_camera(Vector3d(0, 50, 0), Vector3d(0, 20, -150), cols, rows));
+
+    IntensityColor k(.7, .7, .7);
+    scene->push_object(new Plan(Vector3d(0, 0, 0), Vector3d(0, 1, 0), IntensityColor(.2, .7, .2), IntensityColor(0, 0, 0), IntensityColor(.2, .7, .2), 1, Color(120, 200, 120)));
+    scene->push_object(new Sphere(Vector3d(0, 20, -150), 20, Color(222, 0, 0), k, k, k, 10));
+    scene->push_object(new Sphere(Vector3d(-45, 15, -170), 15, Color(0, 0, 222), k, k, k, 20));
+    scene->push_object(new Sphere(Vector3d(45, 15, -170), 15, Color(222, 222, 0), k, k, k, 5));
+    scene->push_object(new Sphere(Vector3d(-25, 8, -110), 8, Color(0, 222, 222), k, k, k, 10));
+    scene->push_object(new Sphere(Vector3d(25, 8, -110), 8, Color(222, 0, 222), k, IntensityColor(0, 0, 0), k, 1));
+    return scene;
+}
+
+
+// Same objects as the interactive scene built in main.cpp.
+static Scene *build_room_scene(int cols, int rows)
+{
+    Vector3d look_at(400,100, -200);
+    Vector3d view_up(-390,1000000,-100);
+    Vector3d eye(-390, 100, -100);
+    Camera camera(look_at, eye, view_up, 1, 60, 60, cols, rows);
+
+    SourceOfLight pontual_light(IntensityColor(.7, .7, .7), Vector3d(0, 100, -100));
+    Scene *scene = new Scene(Color(30, 30, 30), pontual_light, IntensityColor(0.3, 0.3, 0.3), camera);
+
+    IntensityColor floor_k_d(.2, .7, .2), floor_k_e(0, 0, 0), floor_k_a(.2, .7, .2);
+    IntensityColor back_k_d(.3, .3, .7), back_k_e(0, 0, 0), back_k_a(.3, .3, .7);
+    IntensityColor sphere_k(.7, .2, .2);
+
+    scene->push_object(new Sphere(Vector3d(0, 20, -100), 20, Color(222, 0, 0), sphere_k, sphere_k, sphere_k, 10));
+    scene->push_object(new Plan(Vector3d(0, 0, 0), Vector3d(0, 1, 0), floor_k_d, floor_k_e, floor_k_a, 1, Color(50,25,199)));
+    scene->push_object(new Plan(Vector3d(0, 0, -400), Vector3d(0,0,1), back_k_d, back_k_e, back_k_a, 1, Color(255,255,255)));
+    scene->push_object(new Plan(Vector3d(-400, 0, -100), Vector3d(1,0,0), back_k_d, back_k_e, back_k_a, 1, Color(0,255,0)));
+    scene->push_object(new Plan(Vector3d(400, 0, -100), Vector3d(-1,0,0), floor_k_d, floor_k_e, floor_k_a, 1, Color(50,25,199)));
+    scene->push_object(new Plan(Vector3d(0, 0, 0), Vector3d(0,0,-1), floor_k_d, floor_k_e, floor_k_a, 1, Color(50,25,199)));
+    scene->push_object(new Plan(Vector3d(0, 400, 0), Vector3d(0,-1, 0), floor_k_d, floor_k_e, floor_k_a, 1, Color(50,25,199)));
+    return scene;
+}
+
+
+template <typename SceneType = Scene, int divisions = 32>
+static Scene *build_mesh_scene(int cols, int rows)
+{
+    SourceOfLight light(IntensityColor(.8, .8, .8), Vector3d(30, 120, -100));
+    Scene *scene = new SceneType(Color(20, 20, 40), light, IntensityColor(.3, .3, .3),
+                             reference_camera(Vector3d(0, 60, 0), Vector3d(0, 0, -150), cols, rows));
+
+    // divisions x divisions faces: 2048 triangles by default.
+    Mesh *grid = ObjFactory::create_grid(divisions, 200, 6);
+    grid->apply_transformation(MatrixTransformations::translation(0, 0, -150));
+    scene->push_object(grid);
+
+    IntensityColor k(.7, .7, .7);
+    scene->push_object(new Sphere(Vector3d(0, 25, -150), 15, Color(222, 0, 0), k, k, k, 10));
+    return scene;
+}
+
+
+// The mesh scene with the grid stored as a CompactMesh; it should match the mesh golden within quantization.
+static Scene *build_compact_mesh_scene(int cols, int rows)
+{
+    SourceOfLight light(IntensityColor(.8, .8, .8), Vector3d(30, 120, -100));
+    Scene *scene = new Scene(Color(20, 20, 40), light, IntensityColor(.3, .3, .3),
+                             reference_camera(Vector3d(0, 60, 0), Vector3d(0, 0, -150), cols, rows));
+
+    Mesh *grid = ObjFactory::create_grid(32, 200, 6);
+    grid->apply_transformation(MatrixTransformations::translation(0, 0, -150));
+    scene->push_object(new CompactMesh(*grid));
+    delete grid;
+
+    IntensityColor k(.7, .7, .7);
+    scene->push_object(new Sphere(Vector3d(0, 25, -150), 15, Color(222, 0, 0), k, k, k, 10));
+    return scene;
+}
+
+
+static Scene *build_lights_scene(int cols, int rows)
+{
+    SourceOfLight first_light(IntensityColor(.15, .15, .15), Vector3d(80, 100, -150));
+    Scene *scene = new Scene(Color(20, 20, 40), first_light, IntensityColor(.2, .2, .2),
+                             reference_camera(Vector3d(0, 50, 0), Vector3d(0, 20, -150), cols, rows));
+
+    // Seven more lights around the objects, eight in total.
+    for (int i = 1; i < 8; i++) {
+        real angle = i * M_PI / 4;
+        IntensityColor intensity(.05 + .02 * i, .15, .2 - .02 * i);
+        scene->push_light(SourceOfLight(intensity, Vector3d(80 * cos(angle), 100, -150 + 80 * sin(angle))));
+    }
+
+    IntensityColor k(.7, .7, .7);
+    scene->push_object(new Plan(Vector3d(0, 0, 0), Vector3d(0, 1, 0), IntensityColor(.7, .7, .7), IntensityColor(0, 0, 0), IntensityColor(.7, .7, .7), 1, Color(200, 200, 200)));
+    scene->push_object(new Sphere(Vector3d(0, 20, -150), 20, Color(222, 222, 222), k, k, k, 10));
+    scene->push_object(new Sphere(Vector3d(-40, 12, -140), 12, Color(222, 100, 0), k, k, k, 10));
+    scene->push_object(new Sphere(Vector3d(40, 12, -140), 12, Color(0, 100, 222), k, k, k, 10));
+    return scene;
+}
+
+
+static Scene *build_mirrors_scene(int cols, int rows)
+{
+    SourceOfLight light(IntensityColor(.8, .8, .8), Vector3d(-40, 150, -60));
+    Scene *scene = new Scene(Color(20, 20, 40), light, IntensityColor(.3, .3, .3),
+                             reference_camera(Vector3d(0, 50, 0), Vector3d(0, 20, -150), cols, rows));
+    // Unlimited budget, so the golden image does not depend on which thread runs out of rays first.
+    scene->secondary_ray_settings.rays_per_pixel = -1;
+
+    IntensityColor k(.7, .7, .7), dark(.1, .1, .1);
+    Plan *floor = new Plan(Vector3d(0, 0, 0), Vector3d(0, 1, 0), IntensityColor(.7, .7, .7), IntensityColor(0, 0, 0), IntensityColor(.7, .7, .7), 1, Color(200, 200, 200));
+    floor->set_optics(IntensityColor(.2, .2, .2), IntensityColor(0, 0, 0), 1);
+    scene->push_object(floor);
+
+    Sphere *mirror = new Sphere(Vector3d(-25, 20, -160), 20, Color(255, 255, 255), dark, k, dark, 40);
+    mirror->set_optics(IntensityColor(.8, .8, .8), IntensityColor(0, 0, 0), 1);
+    scene->push_object(mirror);
+
+    Sphere *glass = new Sphere(Vector3d(22, 15, -125), 15, Color(255, 255, 255), dark, k, dark, 40);
+    glass->set_optics(IntensityColor(.1, .1, .1), IntensityColor(.85, .85, .85), 1.5);
+    scene->push_object(glass);
+
+    scene->push_object(new Sphere(Vector3d(30, 12, -190), 12, Color(222, 0, 0), k, k, k, 10));
+    scene->push_object(new Sphere(Vector3d(-10, 8, -110), 8, Color(0, 0, 222), k, k, k, 10));
+    return scene;
+}
+
+
+template <typename SceneType = Scene>
+static Scene *build_soft_shadows_scene(int cols, int rows)
+{
+    // A 40x40 ceiling panel and a small sphere light, 16 shadow rays each.
+    SourceOfLight panel = SourceOfLight::rectangle(IntensityColor(.6, .6, .6), Vector3d(-20, 120, -140), Vector3d(40, 0, 0), Vector3d(0, 0, 40), 16);
+    Scene *scene = new SceneType(Color(20, 20, 40), panel, IntensityColor(.2, .2, .2),
+                             reference_camera(Vector3d(0, 50, 0), Vector3d(0, 20, -150), cols, rows));
+    scene->push_light(SourceOfLight::sphere(IntensityColor(.3, .2, .1), Vector3d(60, 50, -120), 10, 16));
+
+    IntensityColor k(.7, .7, .7);
+    scene->push_object(new Plan(Vector3d(0, 0, 0), Vector3d(0, 1, 0), IntensityColor(.7, .7, .7), IntensityColor(0, 0, 0), IntensityColor(.7, .7, .7), 1, Color(200, 200, 200)));
+    scene->push_object(new Sphere(Vector3d(0, 20, -150), 20, Color(222, 222, 222), k, k, k, 10));
+    scene->push_object(new Sphere(Vector3d(-40, 12, -140), 12, Color(222, 100, 0), k, k, k, 10));
+    scene->push_object(new Sphere(Vector3d(35, 8, -125), 8, Color(0, 100, 222), k, k, k, 10));
+    return scene;
+}
+
+
+// The soft shadows scene with a single shadow ray per light, for the denoiser.
+static Scene *build_soft_shadows_preview_scene(int cols, int rows)
+{
+    Scene *scene = build_soft_shadows_scene(cols, rows);
+    for (auto &light : scene->sources_of_light) {
+        light.set_sample_count(1);
+    }
+    return scene;
+}
+
+
+// 64x64 checker of 8x8 squares in two colors, with a one texel grid line that only the finest levels keep.
+static shared_ptr<Texture> build_checker_texture(Color first, Color second)
+{
+    vector<vector<Color>> pixels(64, vector<Color>(64));
+    for (int y = 0; y < 64; y++) {
+        for (int x = 0; x < 64; x++) {
+            bool line = x % 16 == 0 || y % 16 == 0;
+            pixels[y][x] = line ? Color(255, 255, 255) : ((x / 8 + y / 8) % 2 ? first : second);
+        }
+    }
+    return make_shared<Texture>(pixels);
+}
+
+
+// A textured floor receding to the horizon (where only coarse levels avoid aliasing), a textured sphere and a
+// grid mesh with texture coordinates.
+static Scene *build_textures_scene(int cols, int rows)
+{
+    SourceOfLight light(IntensityColor(.8, .8, .8), Vector3d(30, 150, -80));
+    Scene *scene = new Scene(Color(20, 20, 40), light, IntensityColor(.3, .3, .3),
+                             reference_camera(Vector3d(0, 30, 0), Vector3d(0, 10, -150), cols, rows));
+
+    IntensityColor k(.7, .7, .7), no_specular(0, 0, 0);
+    Plan *floor = new Plan(Vector3d(0, 0, 0), Vector3d(0, 1, 0), k, no_specular, k, 1, Color(255, 255, 255));
+    floor->set_texture(build_checker_texture(Color(40, 40, 40), Color(200, 200, 200)), 40);
+    scene->push_object(floor);
+
+    // Tilted around its own center, so the texture has to follow the rotation.
+    Sphere *sphere = new Sphere(Vector3d(0, 0, 0), 18, Color(255, 255, 255), k, k, k, 10);
+    sphere->set_texture(build_checker_texture(Color(200, 30, 30), Color(230, 200, 60)), 1);
+    sphere->apply_transformation(MatrixTransformations::rotation(M_PI / 5, Z_AXIS));
+    sphere->apply_transformation(MatrixTransformations::translation(-25, 20, -140));
+    scene->push_object(sphere);
+
+    const int divisions = 8;
+    Mesh *grid = ObjFactory::create_grid(divisions, 40, 3);
+    for (int i = 0; i < divisions; i++) {
+        for (int j = 0; j < divisions; j++) {
+            // Corners (i, j), (i, j + 1), (i + 1, j + 1), (i + 1, j), like create_grid; the texture covers the grid once.
+            real u0 = (real)i / divisions, u1 = (real)(i + 1) / divisions;
+            real v0 = (real)j / divisions, v1 = (real)(j + 1) / divisions;
+            real uv[8] = {u0, v0, u0, v1, u1, v1, u1, v0};
+            grid->set_texture_coordinates(i * divisions + j, uv);
+        }
+    }
+    grid->set_texture(build_checker_texture(Color(30, 60, 200), Color(220, 220, 220)), 1);
+    grid->apply_rotation_transformation(M_PI / 2, X_AXIS);
+    grid->apply_transformation(MatrixTransformations::translation(30, 22, -150));
+    scene->push_object(grid);
+    return scene;
+}
+
+
+vector<ReferenceScene> atividades_cg_1::regression::get_reference_scenes()
+{
+    RenderSettings denoised;
+    denoised.denoise = true;
+    return {
+        ReferenceScene("spheres", 128, 128, build_spheres_scene),
+        ReferenceScene("room", 128, 128, build_room_scene),
+        ReferenceScene("mesh", 48, 48, build_mesh_scene<>),
+        // 32768 triangles, so the frame time is dominated by the size of the mesh rather than by the pixels.
+        ReferenceScene("large_mesh", 16, 16, build_mesh_scene<Scene, 128>),
+        ReferenceScene("lights", 128, 128, build_lights_scene),
+        ReferenceScene("mirrors", 128, 128, build_mirrors_scene),
+        ReferenceScene("soft_shadows", 128, 128, build_soft_shadows_scene<>),
+        ReferenceScene("compact_mesh", 48, 48, build_compact_mesh_scene),
+        ReferenceScene("textures", 128, 128, build_textures_scene),
+        // The same scenes with static dispatch; their golden images are those of the polymorphic scenes.
+        ReferenceScene("mesh_static", 48, 48, build_mesh_scene<ProductionScene>),
+        ReferenceScene("soft_shadows_static", 128, 128, build_soft_shadows_scene<ProductionScene>),
+        ReferenceScene("soft_shadows_denoised", 128, 128, build_soft_shadows_preview_scene, denoised),
+        ReferenceScene("textures_denoised", 128, 128, build_textures_scene, denoised),
+    };
+}
+
+
+// Timing of a reference scene, as recorded in the baseline. relative_time is the median, over the repetitions, of
+// the frame time divided by that of the calibration frame rendered just before it.
+class SceneTiming
+{
+public:
+    double frame_time_ms = 0;
+    long rays_per_second = 0;
+    double relative_time = 0;
+};
+
+
+static map<string, SceneTiming> read_baseline(string baseline_path)
+{
+    map<string, SceneTiming> baseline;
+    ifstream file(baseline_path);
+    string line;
+    while (getline(file, line))
+    {
+        if (line.empty() || line[0] == '#') continue;
+
+        istringstream iss(line);
+        string name;
+        SceneTiming timing;
+        if (iss >> name >> timing.frame_time_ms >> timing.rays_per_second >> timing.relative_time) {
+            baseline[name] = timing;
+        }
+    }
+    return baseline;
+}
+
+
+static string describe_precision()
+{
+    ostringstream description;
+    description << "precisão " << (sizeof(real) == sizeof(double) ? "double" : "float")
+                << ", Vector3d " << sizeof(Vector3d) << " bytes"
+                << ", IntensityColor " << sizeof(IntensityColor) << " bytes"
+                << ", FourPointsFace " << sizeof(FourPointsFace) << " bytes";
+    return description.str();
+}
+
+
+static void write_baseline(string baseline_path, vector<pair<string, SceneTiming>> results)
+{
+    ofstream file(baseline_path);
+    if (!file) {
+        throw runtime_error("Não foi possível escrever o arquivo de baseline " + baseline_path);
+    }
+
+    file << "# " << describe_precision() << "\n";
+    file << "# scene frame_time_ms rays_per_second relative_time\n";
+    for (auto &[name, timing] : results) {
+        file << name << " " << timing.frame_time_ms << " " << timing.rays_per_second << " " << timing.relative_time << "\n";
+    }
+}
+
+
+// The spheres scene at 256x256. A frame of it is rendered before every frame of a reference scene, whose time
+// is judged relative to it: a slower host, or one busy for a while, slows both frames alike.
+static ReferenceScene get_calibration_scene()
+{
+    return ReferenceScene("calibration", 256, 256, build_spheres_scene);
+}
+
+
+int atividades_cg_1::regression::run_regression_suite(RegressionOptions options)
+{
+    map<string, SceneTiming> baseline = read_baseline(options.baseline_path);
+    vector<pair<string, SceneTiming>> results;
+    bool failed = false;
+
+    cout << describe_precision() << endl;
+
+    ReferenceScene calibration = get_calibration_scene();
+    Scene *calibration_scene = calibration.build(calibration.cols, calibration.rows);
+    Camera calibration_camera = calibration_scene->get_camera();
+    Window calibration_window = calibration_camera.window;
+
+    for (auto &reference : get_reference_scenes())
+    {
+        Scene *scene = reference.build(reference.cols, reference.rows);
+        Camera camera = scene->get_camera();
+        Window window = camera.window;
+
+        // Fastest frame for the report, and the median of the calibrated times for the check, which a single
+        // frame caught by a busy moment of the host does not move.
+        FrameStats best;
+        vector<double> relative_times;
+        for (int i = 0; i < options.repetitions; i++) {
+            FrameStats calibration_stats = render_frame(*calibration_scene, calibration_window, calibration.settings);
+            FrameStats stats = render_frame(*scene, window, reference.settings);
+            relative_times.push_back(stats.frame_time_ms / calibration_stats.frame_time_ms);
+            if (i == 0 || stats.frame_time_ms < best.frame_time_ms) {
+                best = stats;
+            }
+        }
+        nth_element(relative_times.begin(), relative_times.begin() + relative_times.size() / 2, relative_times.end());
+
+        SceneTiming timing;
+        timing.frame_time_ms = best.frame_time_ms;
+        timing.rays_per_second = (long)best.rays_per_second();
+        timing.relative_time = relative_times[relative_times.size() / 2];
+        results.push_back({reference.name, timing});
+
+        scene->dealloc_objects();
+        camera.destroy();
+        delete scene;
+
+        string golden_path = options.golden_dir + "/" + reference.name + ".ppm";
+        cout << reference.name << ": " << timing.frame_time_ms << " ms, " << timing.rays_per_second << " rays/s, "
+             << timing.relative_time << "x a calibração";
+
+        if (options.update) {
+            write_ppm(golden_path, window.windows_colors);
+            cout << " (golden atualizado)" << endl;
+            continue;
+        }
+
+        bool scene_failed = false;
+        ImageDifference difference;
+        try {
+            difference = compare_images(read_ppm(golden_path), window.windows_colors, options.channel_tolerance);
+        } catch (runtime_error &error) {
+            cout << " [FALHA: " << error.what() << "]" << endl;
+            failed = true;
+            continue;
+        }
+
+        if (!difference.same_dimensions || difference.mismatched_ratio() > options.mismatched_ratio_tolerance) {
+            cout << " [FALHA: imagem difere do golden, " << difference.mismatched_pixels << " pixels, diferença máxima "
+                 << difference.max_channel_difference << "]";
+            scene_failed = true;
+        }
+
+        if (baseline.count(reference.name)) {
+            double baseline_relative = baseline[reference.name].relative_time;
+            cout << " (baseline " << baseline_relative << "x)";
+            if (timing.relative_time > baseline_relative * (1 + options.time_tolerance)) {
+                cout << " [FALHA: mais lento que o baseline]";
+                scene_failed = true;
+            }
+        } else {
+            cout << " (sem baseline)";
+        }
+
+        cout << (scene_failed ? "" : " [ok]") << endl;
+        failed = failed || scene_failed;
+    }
+
+    calibration_scene->dealloc_objects();
+    calibration_camera.destroy();
+    delete calibration_scene;
+
+    if (options.update) {
+        write_baseline(options.baseline_path, results);
+    }
+
+    return failed ? 1 : 0;
+}
+
+
+
+// Hardware cache misses of the whole process, worker threads included, when the kernel allows it.
+class CacheMissCounter
+{
+protected:
+    int fd = -1;
+
+public:
+    CacheMissCounter()
+    {
+#ifdef __linux__
+        perf_event_attr attributes = {};
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+        attributes.disabled = 1;
+        attributes.inherit = 1; // Threads created while counting are counted too.
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        this->fd = syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+    }
+
+    ~CacheMissCounter()
+    {
+#ifdef __linux__
+        if (this->fd >= 0) close(this->fd);
+#endif
+    }
+
+    bool is_available() { return this->fd >= 0; }
+
+    void start()
+    {
+#ifdef __linux__
+        if (this->fd < 0) return;
+        ioctl(this->fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(this->fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    long long stop()
+    {
+        long long misses = -1;
+#ifdef __linux__
+        if (this->fd < 0) return -1;
+        ioctl(this->fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(this->fd, &misses, sizeof(misses)) != sizeof(misses)) return -1;
+#endif
+        return misses;
+    }
+};
+
+
+int atividades_cg_1::regression::run_traversal_benchmark(RegressionOptions options)
+{
+    vector<pair<string, int>> orders = {
+        {"scanline", TRAVERSAL_SCANLINE}, {"rows", TRAVERSAL_ROW_MAJOR}, {"morton", TRAVERSAL_MORTON}, {"hilbert", TRAVERSAL_HILBERT}};
+    CacheMissCounter counter;
+
+    cout << describe_precision() << endl;
+    if (!counter.is_available()) {
+        cout << "Contadores de cache indisponíveis (perf_event_open), apenas tempos serão mostrados." << endl;
+    }
+
+    for (auto &reference : get_reference_scenes())
+    {
+        Scene *scene = reference.build(reference.cols, reference.rows);
+        Camera camera = scene->get_camera();
+        Window window = camera.window;
+
+        cout << reference.name << " (" << reference.cols << "x" << reference.rows << ")" << endl;
+        for (auto &[name, order] : orders)
+        {
+            RenderSettings settings;
+            settings.traversal_order = order;
+
+            FrameStats best;
+            long long best_misses = -1;
+            for (int i = 0; i < options.repetitions; i++) {
+                counter.start();
+                FrameStats stats = render_frame(*scene, window, settings);
+                long long misses = counter.stop();
+                if (i == 0 || stats.frame_time_ms < best.frame_time_ms) {
+                    best = stats;
+                    best_misses = misses;
+                }
+            }
+
+            cout << "    " << name << ": " << best.frame_time_ms << " ms, " << (long)best.rays_per_second() << " rays/s";
+            if (best_misses >= 0) {
+                cout << ", " << best_misses << " cache misses";
+            }
+            cout << endl;
+        }
+
+        scene->dealloc_objects();
+        camera.destroy();
+        delete scene;
+    }
+    return 0;
+}
+
+
+int atividades_cg_1::regression::run_obj_benchmark(string obj_path, RegressionOptions options)
+{
+    int max_threads = max(1u, thread::hardware_concurrency());
+    double single_thread_ms = 0;
+    size_t face_count = 0;
+
+    for (int threads = 1; ; threads = min(threads * 2, max_threads))
+    {
+        double best_ms = 0;
+        for (int i = 0; i < options.repetitions; i++) {
+            ObjReader reader;
+            reader.thread_count = threads;
+            auto start = chrono::steady_clock::now();
+            Mesh *mesh;
+            try {
+                mesh = reader.read_obj_file(obj_path);
+            } catch (runtime_error &error) {
+                cerr << error.what() << endl;
+                return 1;
+            }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            best_ms = i == 0 ? ms : min(best_ms, ms);
+
+            if (threads > 1 && mesh->faces.size() != face_count) {
+                cerr << "Leitura com " << threads << " threads gerou " << mesh->faces.size() << " faces, esperado " << face_count << endl;
+                delete mesh;
+                return 1;
+            }
+            face_count = mesh->faces.size();
+            delete mesh;
+        }
+
+        if (threads == 1) single_thread_ms = best_ms;
+        cout << threads << " threads: " << best_ms << " ms, " << face_count << " faces, speedup " << single_thread_ms / best_ms << endl;
+        if (threads == max_threads) break;
+    }
+
+    ObjReader reader;
+    CompactMesh *compact = reader.read_compact_obj_file(obj_path);
+    cout << "Memória das faces: " << face_count * sizeof(FourPointsFace) << " bytes (Mesh), "
+         << compact->get_memory_usage() << " bytes (CompactMesh)" << endl;
+    delete compact;
+    return 0;
+}
+
+
+int atividades_cg_1::regression::run_distributed_check(string scene_path, int worker_count, RegressionOptions options)
+{
+    SceneReader reader;
+    Scene *scene;
+    try {
+        scene = reader.read_scene_file(scene_path);
+    } catch (runtime_error &error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    scene->swap_loaded_meshes(true);
+    Window window = scene->get_camera().window;
+    FrameStats local_stats = render_frame(*scene, window, RenderSettings());
+    scene->dealloc_objects();
+    scene->get_camera().destroy();
+    delete scene;
+
+    int threads_per_worker = max(1, (int)thread::hardware_concurrency() / worker_count);
+    vector<LocalWorker> workers;
+    try {
+        workers = spawn_local_workers(scene_path, worker_count, threads_per_worker);
+    } catch (runtime_error &error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    vector<string> addresses;
+    for (LocalWorker &worker : workers) addresses.push_back(worker.address);
+
+    int failures = 0;
+    try {
+        DistributedSettings settings;
+        // Small tiles so the killed worker still has work left, and eager duplication so stragglers are exercised.
+        settings.tile_size = 16;
+        settings.straggler_factor = 1;
+        RenderCoordinator coordinator(addresses, settings);
+        pid_t victim = workers[0].pid;
+        coordinator.on_tile_done = [victim](int worker, int tiles_done) {
+            if (worker == 0 && tiles_done == 2) kill(victim, SIGKILL);
+        };
+
+        vector<vector<Color>> pixels;
+        DistributedStats stats = coordinator.render(pixels);
+        ImageDifference difference = compare_images(window.windows_colors, pixels, options.channel_tolerance);
+        cout << "distribuído: " << stats.frame_time_ms << " ms (local " << local_stats.frame_time_ms << " ms), "
+             << stats.tiles << " tiles, " << stats.requeued_tiles << " reenviados, " << stats.duplicated_tiles
+             << " duplicados, " << stats.lost_workers << " workers perdidos, " << difference.mismatched_pixels
+             << " pixels diferentes" << endl;
+        if (!difference.same_dimensions || difference.mismatched_pixels > 0) {
+            cout << "[FALHA: quadro distribuído difere do local]" << endl;
+            failures++;
+        }
+        if (stats.lost_workers != 1) {
+            cout << "[FALHA: esperado 1 worker perdido]" << endl;
+            failures++;
+        }
+        coordinator.shutdown_workers();
+    } catch (runtime_error &error) {
+        cerr << error.what() << endl;
+        failures++;
+    }
+    stop_local_workers(workers);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+#include "Render.hpp"
+#include "Timeline.hpp"
+
+using namespace std;
+using namespace atividades_cg_1::render;
+using namespace atividades_cg_1::timeline;
+
+
+double FrameStats::rays_per_second()
+{
+    if (this->frame_time_ms <= 0) return 0;
+    return (this->primary_rays + this->secondary_rays) / (this->frame_time_ms / 1000.0);
+}
+
+
+// Even bits of a Morton code.
+static int compact_bits(int code)
+{
+    int value = 0;
+    for (int bit = 0; bit < 16; bit++) {
+        value |= ((code >> (2 * bit)) & 1) << bit;
+    }
+    return value;
+}
+
+
+// Position of the d-th cell of a Hilbert curve covering an n x n square (n a power of two).
+static pair<int, int> hilbert_position(int n, int d)
+{
+    int x = 0, y = 0;
+    for (int s = 1; s < n; s *= 2) {
+        int rx = 1 & (d / 2);
+        int ry = 1 & (d ^ rx);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            swap(x, y);
+        }
+        x += s * rx;
+        y += s * ry;
+        d /= 4;
+    }
+    return {x, y};
+}
+
+
+vector<pair<int, int>> atividades_cg_1::render::get_tile_traversal(int traversal_order, int tile_size)
+{
+    if (tile_size <= 0 || (tile_size & (tile_size - 1)) != 0) {
+        throw runtime_error("O tamanho do tile deve ser uma potência de 2.");
+    }
+
+    vector<pair<int, int>> offsets;
+    for (int i = 0; i < tile_size * tile_size; i++)
+    {
+        switch (traversal_order)
+        {
+        case TRAVERSAL_MORTON:
+            offsets.push_back({compact_bits(i), compact_bits(i >> 1)});
+            break;
+        case TRAVERSAL_HILBERT:
+            offsets.push_back(hilbert_position(tile_size, i));
+            break;
+        default:
+            offsets.push_back({i % tile_size, i / tile_size});
+            break;
+        }
+    }
+    return offsets;
+}
+
+
+int atividades_cg_1::render::parse_traversal_order(string name)
+{
+    if (name == "scanline") return TRAVERSAL_SCANLINE;
+    if (name == "rows") return TRAVERSAL_ROW_MAJOR;
+    if (name == "morton") return TRAVERSAL_MORTON;
+    if (name == "hilbert") return TRAVERSAL_HILBERT;
+    throw runtime_error("Ordem de percurso desconhecida: " + name + " (scanline, rows, morton ou hilbert)");
+}
+
+
+void ResolutionController::record_frame(double frame_time_ms)
+{
+    if (frame_time_ms <= 0) return;
+
+    // Frame time grows with the traced pixels, which grow with scale squared. Only half of the way is taken
+    // per frame, and changes under 5% are ignored, so one slow frame does not make the resolution jump around.
+    real ideal = this->scale * std::sqrt(this->target_frame_ms / frame_time_ms);
+    real next = std::min((real)1, std::max(this->min_scale, (this->scale + ideal) / 2));
+    if (std::abs(next - this->scale) > this->scale * (real)0.05 || next == 1 || next == this->min_scale) {
+        this->scale = next;
+    }
+}
+
+
+Window atividades_cg_1::render::scale_window(Window &full, real scale)
+{
+    int cols = std::max(1, (int)std::lround(full.cols * scale));
+    int rows = std::max(1, (int)std::lround(full.rows * scale));
+    return Window(full.width, full.height, cols, rows, full.center.x, full.center.y, full.center.z);
+}
+
+
+void atividades_cg_1::render::upscale_window(Window &low, Window &full)
+{
+    for (int l = 0; l < full.rows; l++)
+    {
+        // Pixel centers of the full window, in pixels of the low window.
+        real y = std::min(std::max((l + (real)0.5) * low.rows / full.rows - (real)0.5, (real)0), (real)(low.rows - 1));
+        int l0 = (int)y, l1 = std::min(l0 + 1, low.rows - 1);
+        real fy = y - l0;
+
+        for (int c = 0; c < full.cols; c++)
+        {
+            real x = std::min(std::max((c + (real)0.5) * low.cols / full.cols - (real)0.5, (real)0), (real)(low.cols - 1));
+            int c0 = (int)x, c1 = std::min(c0 + 1, low.cols - 1);
+            real fx = x - c0;
+
+            Color &a = low.windows_colors[l0][c0], &b = low.windows_colors[l0][c1];
+            Color &d = low.windows_colors[l1][c0], &e = low.windows_colors[l1][c1];
+            auto mix = [&](uint8_t pa, uint8_t pb, uint8_t pd, uint8_t pe) {
+                real top = pa + (pb - pa) * fx;
+                real bottom = pd + (pe - pd) * fx;
+                return (uint8_t)std::lround(top + (bottom - top) * fy);
+            };
+            full.windows_colors[l][c] = Color(mix(a.r, b.r, d.r, e.r), mix(a.g, b.g, d.g, e.g), mix(a.b, b.b, d.b, e.b));
+        }
+    }
+}
+
+
+// Traces and shades one tile. `offsets` lists the pixels of a full tile in traversal order; pixels that fall
+// outside a tile clipped by the window border are skipped. Fills `guides` and `costs` too, unless they are NULL.
+static void render_tile(Scene &scene, Window &window, RenderTile tile, vector<pair<int, int>> &offsets,
+                        ShadingBatch &batch, vector<Color> &colors, GuideBuffers *guides, CostBuffers *costs)
+{
+    batch.clear();
+    vector<pair<int, int>> pixels;
+    vector<PixelCost *> pixel_costs;
+    Ray ray;
+    ray.p1 = Vector3d(0,0,0); // Eye in Camera's system
+
+    TimelineScope trace_scope("trace tile");
+    for (auto &[dc, dl] : offsets)
+    {
+        int l = tile.first_row + dl;
+        int c = tile.first_col + dc;
+        if (l >= tile.last_row || c >= tile.last_col) continue;
+
+        ray.p2 = window.get_pixel_center(l, c);
+
+        PixelCost *cost = costs != NULL ? &costs->at(l, c) : NULL;
+        {
+            CountedPixel counted(cost);
+            scene.trace_pixel(ray, batch, l, c);
+        }
+        pixels.push_back({l, c});
+        if (costs != NULL) pixel_costs.push_back(cost);
+    }
+    trace_scope.end();
+
+    TimelineScope shade_scope("shade tile");
+    colors.resize(batch.size());
+    scene.shade(batch, colors.data(), costs != NULL ? pixel_costs.data() : NULL);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        window.windows_colors[pixels[i].first][pixels[i].second] = colors[i];
+    }
+    if (guides != NULL) {
+        for (size_t i = 0; i < pixels.size(); i++) {
+            guides->set(pixels[i].first, pixels[i].second, batch, i);
+        }
+    }
+}
+
+
+static FrameStats trace_region(Scene &scene, Window &window, RenderTile region, RenderSettings settings,
+                               GuideBuffers *guides, CostBuffers *costs);
+
+
+FrameStats atividades_cg_1::render::render_frame(Scene &scene, Window &window, RenderSettings settings)
+{
+    TimelineScope scope("render frame");
+    RenderTile whole_window(0, window.cols, 0, window.rows);
+    if (settings.heatmap != COST_NONE) {
+        CostBuffers costs;
+        costs.resize(window.cols, window.rows);
+        FrameStats stats = trace_region(scene, window, whole_window, settings, NULL, &costs);
+        for (const PixelCost &cost : costs.pixels) {
+            stats.intersection_tests += cost.intersection_tests;
+            stats.shadow_tests += cost.shadow_tests;
+        }
+        stats.heatmap_scale = write_heatmap(costs, settings.heatmap, window);
+        return stats;
+    }
+    if (!settings.denoise) {
+        return trace_region(scene, window, whole_window, settings, NULL, NULL);
+    }
+
+    GuideBuffers guides;
+    guides.resize(window.cols, window.rows);
+    FrameStats stats = trace_region(scene, window, whole_window, settings, &guides, NULL);
+    if (settings.cancel != NULL && settings.cancel->load()) {
+        return stats;
+    }
+
+    TimelineScope denoise_scope("denoise");
+    auto start = chrono::steady_clock::now();
+    DenoiseSettings denoise_settings = settings.denoise_settings;
+    if (denoise_settings.thread_count == 0) {
+        denoise_settings.thread_count = settings.thread_count;
+    }
+    denoise_frame(window, guides, denoise_settings);
+    stats.denoise_time_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    stats.frame_time_ms += stats.denoise_time_ms;
+    return stats;
+}
+
+
+FrameStats atividades_cg_1::render::render_region(Scene &scene, Window &window, RenderTile region, RenderSettings settings)
+{
+    return trace_region(scene, window, region, settings, NULL, NULL);
+}
+
+
+static FrameStats trace_region(Scene &scene, Window &window, RenderTile region, RenderSettings settings,
+                               GuideBuffers *guides, CostBuffers *costs)
+{
+    auto start = chrono::steady_clock::now();
+    scene.prepare_frame(window);
+
+    vector<RenderTile> tiles;
+    vector<pair<int, int>> offsets;
+    if (settings.traversal_order == TRAVERSAL_SCANLINE)
+    {
+        for (int l = region.first_row; l < region.last_row; l++) {
+            tiles.push_back(RenderTile(region.first_col, region.last_col, l, l + 1));
+        }
+        for (int c = 0; c < region.last_col - region.first_col; c++) {
+            offsets.push_back({c, 0});
+        }
+    }
+    else
+    {
+        int size = settings.tile_size;
+        for (int l = region.first_row; l < region.last_row; l += size) {
+            for (int c = region.first_col; c < region.last_col; c += size) {
+                tiles.push_back(RenderTile(c, min(c + size, region.last_col), l, min(l + size, region.last_row)));
+            }
+        }
+        offsets = get_tile_traversal(settings.traversal_order, size);
+    }
+
+    // Every thread takes the next tile that nobody took yet, until the frame is done.
+    atomic<int> next_tile(0);
+    auto worker = [&]() {
+        ShadingBatch batch(scene.sources_of_light.size());
+        vector<Color> colors;
+        for (int t = next_tile++; t < (int)tiles.size(); t = next_tile++) {
+            if (settings.cancel != NULL && settings.cancel->load(memory_order_relaxed)) break;
+            render_tile(scene, window, tiles[t], offsets, batch, colors, guides, costs);
+        }
+    };
+
+    int thread_count = settings.thread_count > 0 ? settings.thread_count : max(1u, thread::hardware_concurrency());
+    vector<thread> threads;
+    for (int i = 1; i < thread_count; i++) {
+        threads.push_back(thread(worker));
+    }
+    worker();
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    FrameStats stats;
+    stats.primary_rays = (long)(region.last_row - region.first_row) * (region.last_col - region.first_col);
+    stats.secondary_rays = scene.get_secondary_rays_traced();
+    stats.framebuffer_bytes = get_pixels_memory(window.windows_colors)
+                            + (guides != NULL ? get_vector_memory(guides->pixels) : 0)
+                            + (costs != NULL ? get_vector_memory(costs->pixels) : 0);
+    stats.frame_time_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -1,19 +1,68 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <vector>
 
 #include "Scene.hpp"
+#include "Timeline.hpp"
 
 using namespace atividades_cg_1::scene;
+using namespace atividades_cg_1::timeline;
+
+
+// FNV-1a over the hit point rounded to 1/64 units, so the random draws of a pixel (light sample jitter,
+// Russian roulette) depend neither on which thread traced it nor on the precision of real.
+static uint32_t hash_point(uint32_t seed, real x, real y, real z)
+{
+    int32_t values[3] = {(int32_t)std::lround(x * 64), (int32_t)std::lround(y * 64), (int32_t)std::lround(z * 64)};
+    unsigned char bytes[sizeof(values)];
+    memcpy(bytes, values, sizeof(values));
+    for (unsigned char byte : bytes)
+    {
+        seed = (seed ^ byte) * 16777619u;
+    }
+    return seed != 0 ? seed : 1;
+}
+
+
+// Xorshift, uniform in [0, 1).
+static real next_random(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * ((real)1 / 16777216);
+}
 
 
 Color Scene::get_color_to_draw(Ray ray)
 {
+    ShadingBatch batch(this->sources_of_light.size());
+    this->trace(ray, batch);
+
+    Color color;
+    this->shade(batch, &color);
+    return color;
+}
+
+
+void Scene::trace(Ray ray, ShadingBatch &batch)
+{
+    this->trace(ray, batch, this->objects);
+}
+
+
+void Scene::trace(Ray ray, ShadingBatch &batch, std::vector<Object *> &candidates)
+{
+    count_intersection_tests(candidates.size());
     Intersection intersection_min(INFINITY, false);
     // float min_time_intersection = INFINITY;
     // int min_index = -1;
-    for (int i = 0; i < objects.size(); i++)
+    for (size_t i = 0; i < candidates.size(); i++)
     {
-        Intersection intersection = objects[i]->get_intersection(ray);
+        Intersection intersection = candidates[i]->get_intersection(ray);
         if (intersection.is_valid)
         {
             if (intersection.time < intersection_min.time)
@@ -25,58 +74,428 @@ Color Scene::get_color_to_draw(Ray ray)
         }
     }
 
-    if (intersection_min.time == INFINITY)
-        return this->background_color;
+    if (intersection_min.time == INFINITY) {
+        batch.add_miss();
+        return;
+    }
+
+    this->add_hit(ray, intersection_min, batch, batch.last_occluders);
+}
 
-    Object *obj = intersection_min.intersepted_object;
-    Color color = obj->color;
+
+void Scene::trace_pixel(Ray ray, ShadingBatch &batch, int row, int col)
+{
+    this->trace(ray, batch, this->get_tile_candidates(row, col));
+}
+
+
+void Scene::add_hit(Ray ray, Intersection intersection, ShadingBatch &batch, std::vector<Object *> &occluders, real distance)
+{
+    Object *obj = intersection.intersepted_object;
 
     // Pin + t*dr
-    Vector3d intersection_point = ray.p1.sum(ray.get_dr().multiply(intersection_min.time));
+    Vector3d dr = ray.get_dr();
+    Vector3d intersection_point = ray.p1.sum(dr.multiply(intersection.time));
+    Vector3d normal = obj->get_normal_vector(intersection_point, intersection);
+
+    Color albedo = obj->color;
+    TextureCoordinates coordinates;
+    const Texture *texture = obj->get_texture();
+    if (texture != NULL && obj->get_texture_coordinates(intersection_point, intersection, coordinates)) {
+        // Width of the ray cone at the hit, stretched along the surface when the ray arrives at a grazing angle.
+        real cone_width = this->pixel_spread_angle * (distance + intersection.time);
+        real cos_angle = std::abs(dr.scalar_product(normal.get_vector_normalized()));
+        real footprint = cone_width * coordinates.density / std::max(cos_angle, 1 / MAX_GRAZING_FOOTPRINT_SCALE);
+        Color texel = texture->sample(coordinates.u, coordinates.v, footprint);
+        albedo = Color(texel.r * albedo.r / 255, texel.g * albedo.g / 255, texel.b * albedo.b / 255);
+    }
+    int index = batch.add_hit(obj, intersection_point, normal, dr, albedo);
+
+    occluders.resize(this->sources_of_light.size(), NULL);
+    uint32_t random_state = 0;
+
+    for (size_t l = 0; l < this->sources_of_light.size(); l++)
+    {
+        // Check if the object is seen by each sample of the light; point lights have a single one.
+        const SourceOfLight &light = this->sources_of_light[l];
+        int sample_count = light.sample_count();
+        int lit_samples = 0;
+        // Area lights are jittered even with a single sample, so few samples give noise (which the denoiser
+        // averages) instead of the hard shadow of the light's center.
+        bool jittered = light.shape != LIGHT_POINT;
+        if (jittered && random_state == 0) {
+            random_state = hash_point(2166136261u, intersection_point.x, intersection_point.y, intersection_point.z);
+        }
+        for (int s = 0; s < sample_count; s++)
+        {
+            real jitter_u = jittered ? next_random(random_state) : 0;
+            real jitter_v = jittered ? next_random(random_state) : 0;
+            Ray ray_light(light.get_sample(s, jitter_u, jitter_v), intersection_point);
+            count_shadow_test();
+            if (!this->is_occluded(ray_light, obj, intersection.primitive_index, occluders[l])) {
+                lit_samples++;
+            }
+        }
+
+        if (lit_samples < sample_count) {
+            batch.visibility[index * batch.light_count + l] = (real)lit_samples / sample_count;
+        }
+    }
+}
+
+
+bool Scene::find_target_hit(Ray &ray_light, Object *target, int target_primitive, Intersection &own)
+{
+    // The point is lit only when the closest object along the ray from the light is the one that was hit.
+    // If the target itself is missed, the closest object is another one (or none), so there is no light.
+    own = target->get_intersection(ray_light);
+    count_intersection_tests(1);
+    if (!own.is_valid) {
+        return false;
+    }
+
+    // For a CompactMesh, `own` is its closest triangle: another triangle of the mesh can shadow the hit one.
+    if (own.primitive_index != target_primitive) {
+        Intersection hit = target->get_primitive_intersection(ray_light, target_primitive);
+        count_intersection_tests(1);
+        if (!hit.is_valid || own.time < hit.time) {
+            return false;
+        }
+        own = hit;
+    }
+    return true;
+}
+
 
-    // Check if the object is seen by pontual light
-    Ray ray_light(this->source_of_light.center, intersection_point);
+bool Scene::is_occluded(Ray ray_light, Object *target, int target_primitive, Object *&last_occluder)
+{
+    Intersection own;
+    if (!this->find_target_hit(ray_light, target, target_primitive, own)) {
+        return true;
+    }
 
-    Intersection intersection_min2(INFINITY, false);
-    // float min_t2 = INFINITY;
-    // Object *min_obj = objects[0];
+    long tests = 0;
+    auto blocks = [&](Object *object) {
+        tests++;
+        Intersection intersection = object->get_intersection(ray_light);
+        return intersection.is_valid && intersection.intersepted_object != target && intersection.time < own.time;
+    };
 
-    for (auto & object : objects)
+    bool occluded = last_occluder != NULL && last_occluder != target && blocks(last_occluder);
+    // The target was already tested; a lit point costs one intersection per object, as a nearest hit search.
+    for (size_t i = 0; !occluded && i < this->objects.size(); i++)
     {
-        Intersection intersection2 = object->get_intersection(ray_light);
-        if (intersection2.is_valid)
+        Object *object = this->objects[i];
+        if (object != last_occluder && object != target && blocks(object)) {
+            last_occluder = object;
+            occluded = true;
+        }
+    }
+    count_intersection_tests(tests);
+    return occluded;
+}
+
+
+void Scene::shade(ShadingBatch &batch, Color *colors, PixelCost *const *costs)
+{
+    ShadingParameters parameters;
+    parameters.lights = &this->sources_of_light;
+    parameters.environment_light = this->environment_light;
+    parameters.eye = this->camera.eye;
+    parameters.background_color = this->background_color;
+
+    uint64_t start = costs != NULL ? read_cycle_counter() : 0;
+    shade_batch(batch, parameters, colors);
+    if (costs != NULL && batch.size() > 0) {
+        uint64_t share = (read_cycle_counter() - start) / batch.size();
+        for (int i = 0; i < batch.size(); i++) {
+            costs[i]->cycles += share;
+        }
+    }
+
+    for (int i = 0; i < batch.size(); i++)
+    {
+        if (batch.objects[i] != NULL && batch.objects[i]->has_optics) {
+            CountedPixel counted(costs != NULL ? costs[i] : NULL);
+            this->trace_secondary(batch, i, colors[i]);
+        }
+    }
+}
+
+
+// A reflection or refraction ray waiting on the stack. The throughput is how much of its color reaches the
+// pixel; it is kept unclamped because Russian roulette can weight it above 1.
+class SecondaryRay
+{
+public:
+    Ray ray;
+    real r, g, b;
+    int depth;
+    // Length of the path from the eye to ray.p1, for texture footprints.
+    real distance;
+};
+
+
+bool Scene::take_secondary_ray()
+{
+    if (this->secondary_ray_budget_limited && this->secondary_ray_budget.fetch_sub(1, memory_order_relaxed) <= 0) {
+        return false;
+    }
+    this->secondary_rays_traced.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+
+void Scene::trace_secondary(ShadingBatch &batch, int index, Color &color)
+{
+    SecondaryRaySettings &settings = this->secondary_ray_settings;
+    thread_local vector<SecondaryRay> stack;
+    thread_local ShadingBatch hit_batch;
+    stack.clear();
+    hit_batch.light_count = this->sources_of_light.size();
+
+    IntensityColor local = color.to_color_normalized();
+    real r = local.r, g = local.g, b = local.b;
+    uint32_t random_state = hash_point(2166136261u, batch.px[index], batch.py[index], batch.pz[index]);
+
+    auto push = [&](Vector3d origin, Vector3d direction, real tr, real tg, real tb, int depth, real distance) {
+        real strength = max(tr, max(tg, tb));
+        if (strength <= 0) return;
+        if (strength < settings.roulette_threshold) {
+            real survival = strength / settings.roulette_threshold;
+            if (next_random(random_state) >= survival) return;
+            tr /= survival; tg /= survival; tb /= survival;
+        }
+        if (!this->take_secondary_ray()) return;
+
+        Vector3d start = origin.sum(direction.multiply(SECONDARY_RAY_OFFSET));
+        stack.push_back(SecondaryRay{Ray(start, start.sum(direction)), tr, tg, tb, depth, distance});
+    };
+
+    // Reflection and refraction rays of hit i of `hits`, reached with throughput (tr, tg, tb) after `distance`.
+    auto spawn = [&](ShadingBatch &hits, int i, real tr, real tg, real tb, int depth, real distance) {
+        if (depth > settings.max_depth) return;
+        Object *obj = hits.objects[i];
+        Vector3d p(hits.px[i], hits.py[i], hits.pz[i]);
+        Vector3d n = Vector3d(hits.nx[i], hits.ny[i], hits.nz[i]).get_vector_normalized();
+        Vector3d d(hits.dx[i], hits.dy[i], hits.dz[i]);
+
+        // Normals point outwards; a ray leaving the object sees the flipped one.
+        real cos_in = -d.scalar_product(n);
+        bool entering = cos_in >= 0;
+        if (!entering) {
+            n = n.multiply(-1);
+            cos_in = -cos_in;
+        }
+
+        real rr = tr * obj->mirror_reflectivity.r, rg = tg * obj->mirror_reflectivity.g, rb = tb * obj->mirror_reflectivity.b;
+        real kr = tr * obj->transmissivity.r, kg = tg * obj->transmissivity.g, kb = tb * obj->transmissivity.b;
+
+        if (kr > 0 || kg > 0 || kb > 0) {
+            real eta = entering ? 1 / obj->refraction_index : obj->refraction_index;
+            real k = 1 - eta * eta * (1 - cos_in * cos_in);
+            if (k < 0) {
+                // Total internal reflection: the transmitted part is reflected too.
+                rr += kr; rg += kg; rb += kb;
+            } else {
+                Vector3d refracted = d.multiply(eta).sum(n.multiply(eta * cos_in - std::sqrt(k)));
+                push(p, refracted.get_vector_normalized(), kr, kg, kb, depth, distance);
+            }
+        }
+
+        Vector3d reflected = d.sum(n.multiply(2 * cos_in));
+        push(p, reflected.get_vector_normalized(), rr, rg, rb, depth, distance);
+    };
+
+    // Primary hits are in camera coordinates, with the eye at the origin.
+    spawn(batch, index, 1, 1, 1, 1, Vector3d(batch.px[index], batch.py[index], batch.pz[index]).size());
+
+    ShadingParameters parameters;
+    parameters.lights = &this->sources_of_light;
+    parameters.environment_light = this->environment_light;
+    parameters.background_color = this->background_color;
+
+    while (!stack.empty())
+    {
+        SecondaryRay current = stack.back();
+        stack.pop_back();
+
+        count_intersection_tests(this->objects.size());
+        Intersection nearest(INFINITY, false);
+        for (auto &obj : this->objects)
         {
-            if (intersection2.time < intersection_min2.time)
+            Intersection intersection = obj->get_next_intersection(current.ray);
+            if (intersection.is_valid && intersection.time < nearest.time) {
+                nearest = intersection;
+            }
+        }
+
+        Color hit_color;
+        hit_batch.clear();
+        if (!nearest.is_valid) {
+            hit_color = this->background_color;
+        } else {
+            this->add_hit(current.ray, nearest, hit_batch, batch.last_occluders, current.distance);
+            // Specular highlights are seen from where the secondary ray started.
+            parameters.eye = current.ray.p1;
+            shade_batch(hit_batch, parameters, &hit_color);
+        }
+
+        IntensityColor contribution = hit_color.to_color_normalized();
+        r += current.r * contribution.r;
+        g += current.g * contribution.g;
+        b += current.b * contribution.b;
+
+        if (nearest.is_valid && hit_batch.objects[0]->has_optics) {
+            spawn(hit_batch, 0, current.r, current.g, current.b, current.depth + 1, current.distance + nearest.time);
+        }
+    }
+
+    color = IntensityColor(max(r, (real)0), max(g, (real)0), max(b, (real)0)).to_color();
+}
+
+
+void Scene::prepare_frame(Window &window)
+{
+    TimelineScope scope("prepare frame");
+    this->swap_loaded_meshes();
+    // Tracing threads must never find a deferred transformation, they would all try to apply it.
+    this->flush_transformations();
+
+    this->secondary_ray_budget_limited = this->secondary_ray_settings.rays_per_pixel >= 0;
+    this->secondary_ray_budget = (long)(this->secondary_ray_settings.rays_per_pixel * window.cols * window.rows);
+    this->secondary_rays_traced = 0;
+    this->pixel_spread_angle = window.dx / std::abs(window.center.z);
+
+    vector<BoundingBox> bounds;
+    this->visible_objects.clear();
+
+    Frustum window_frustum = Frustum::from_window(window);
+    for (auto &obj : this->objects)
+    {
+        BoundingBox box = obj->get_bounds();
+        if (!window_frustum.is_outside(box)) {
+            this->visible_objects.push_back(obj);
+            bounds.push_back(box);
+        }
+    }
+
+    this->tile_cols = (window.cols + CULLING_TILE_SIZE - 1) / CULLING_TILE_SIZE;
+    int tile_rows = (window.rows + CULLING_TILE_SIZE - 1) / CULLING_TILE_SIZE;
+    this->culling_cols = window.cols;
+    this->culling_rows = window.rows;
+    this->culling_stale = false;
+    this->tile_candidates.assign(this->tile_cols * tile_rows, vector<Object *>());
+
+    for (int tile_row = 0; tile_row < tile_rows; tile_row++)
+    {
+        for (int tile_col = 0; tile_col < this->tile_cols; tile_col++)
+        {
+            int first_col = tile_col * CULLING_TILE_SIZE;
+            int first_row = tile_row * CULLING_TILE_SIZE;
+            Frustum tile_frustum = Frustum::from_pixels(window, first_col, min(first_col + CULLING_TILE_SIZE, window.cols),
+                                                        first_row, min(first_row + CULLING_TILE_SIZE, window.rows));
+
+            vector<Object *> &candidates = this->tile_candidates[tile_row * this->tile_cols + tile_col];
+            for (size_t i = 0; i < this->visible_objects.size(); i++)
             {
-                intersection_min2 = intersection2;
-                // min_t2 = intersection2.time;
-                // min_obj = object;
+                if (!tile_frustum.is_outside(bounds[i])) {
+                    candidates.push_back(this->visible_objects[i]);
+                }
             }
         }
     }
+}
 
-    Vector3d intersection_point2 = ray_light.p1.sum(ray_light.get_dr().multiply(intersection_min2.time));
 
-    // If intersection times are not equal, there is something interrupting light to get into that point, so we discard difuse and specular contributions.
-    if (intersection_min2.intersepted_object != intersection_min.intersepted_object) {
-        IntensityColor environment_contrib = this->environment_light.arroba_multiply(obj->environment_reflectivity);
+PickResult Scene::pick(int col, int row)
+{
+    return this->pick(vector<pair<int, int>>{{col, row}})[0];
+}
+
 
-        return color.multiply(environment_contrib);
+vector<PickResult> Scene::pick(const vector<pair<int, int>> &pixels)
+{
+    Window &window = this->camera.window;
+    bool use_tiles = !this->culling_stale && this->culling_cols == window.cols && this->culling_rows == window.rows;
+    Matrix4 to_world = this->camera.get_camera_to_world_matrix();
+
+    vector<PickResult> results;
+    results.reserve(pixels.size());
+    Ray ray;
+    ray.p1 = Vector3d(0, 0, 0);
+    for (auto &[col, row] : pixels)
+    {
+        if (col < 0 || col >= window.cols || row < 0 || row >= window.rows) {
+            throw runtime_error("Pixel fora da janela: " + to_string(col) + " " + to_string(row));
+        }
+        ray.p2 = window.get_pixel_center(row, col);
+
+        // The closest hit is kept with the candidate that returned it.
+        PickResult result;
+        Intersection closest(INFINITY, false);
+        for (Object *candidate : use_tiles ? this->get_tile_candidates(row, col) : this->objects)
+        {
+            Intersection intersection = candidate->get_intersection(ray);
+            if (intersection.is_valid && intersection.time < closest.time) {
+                closest = intersection;
+                result.object = candidate;
+            }
+        }
+
+        if (result.object != NULL) {
+            result.object_index = find(this->objects.begin(), this->objects.end(), result.object) - this->objects.begin();
+            result.primitive_index = result.object->get_primitive_index(closest);
+            // The direction of a ray is unitary, so its time is the distance from the eye.
+            result.distance = closest.time;
+            result.point = to_world.transform(ray.p1.sum(ray.get_dr().multiply(closest.time)));
+        }
+        results.push_back(result);
     }
+    return results;
+}
+
 
-    IntensityColor difuse_contrib = obj->get_difuse_contribution(intersection_point, intersection_min, source_of_light);
-    IntensityColor specular_contrib = obj->get_specular_contribution(intersection_point, intersection_min, this->camera.eye, source_of_light);
-    IntensityColor environment_contrib = this->environment_light.arroba_multiply(obj->environment_reflectivity);
+std::vector<Object *> &Scene::get_tile_candidates(int row, int col)
+{
+    return this->tile_candidates[(row / CULLING_TILE_SIZE) * this->tile_cols + col / CULLING_TILE_SIZE];
+}
+
+
+long Scene::get_secondary_rays_traced()
+{
+    return this->secondary_rays_traced.load();
+}
 
-    IntensityColor result = environment_contrib.sum(difuse_contrib).sum(specular_contrib);
 
+MemoryUsage Scene::get_memory_usage()
+{
+    MemoryUsage usage;
+    vector<const Texture *> textures;
+    for (auto &obj : this->objects)
+    {
+        obj->add_memory_usage(usage);
+        const Texture *texture = obj->get_texture();
+        if (texture != NULL && find(textures.begin(), textures.end(), texture) == textures.end()) {
+            textures.push_back(texture);
+            usage.add(MEMORY_TEXTURES, texture->get_memory_usage());
+        }
+    }
+    usage.add(MEMORY_OBJECTS, get_vector_memory(this->objects) + this->sources_of_light.capacity() * sizeof(SourceOfLight));
 
-    return color.multiply(result);
+    usage.add(MEMORY_ACCELERATION, get_vector_memory(this->visible_objects) + get_vector_memory(this->tile_candidates));
+    for (auto &candidates : this->tile_candidates) {
+        usage.add(MEMORY_ACCELERATION, get_vector_memory(candidates));
+    }
+    usage.add(MEMORY_FRAMEBUFFERS, get_pixels_memory(this->camera.window.windows_colors));
+    return usage;
 }
 
 
 void Scene::dealloc_objects()
 {
+    // Loading threads cannot be cancelled; their meshes are swapped in only to be deleted below.
+    this->swap_loaded_meshes(true);
     for (auto &obj : objects)
     {
         delete obj;
@@ -85,7 +504,8 @@ void Scene::dealloc_objects()
 
 
 Scene::Scene(Color bg_color, SourceOfLight source, IntensityColor environment_light, Camera camera)
-        : background_color(bg_color), source_of_light(source), environment_light(environment_light), coordinates_type(WORLD_COORDINATES) {
+        : coordinates_type(WORLD_COORDINATES), background_color(bg_color), environment_light(environment_light) {
+    this->sources_of_light.push_back(source);
     this->set_camera(camera);
 }
 
@@ -102,8 +522,119 @@ void Scene::push_object(Object *obj)
 }
 
 
+void Scene::push_light(SourceOfLight source)
+{
+    this->sources_of_light.push_back(source);
+}
+
+
+int Scene::push_pending_mesh(std::shared_future<Object *> mesh, std::function<Object *(Object *)> prepare, Object *proxy)
+{
+    PendingMesh pending;
+    pending.index = this->objects.size();
+    pending.mesh = mesh;
+    pending.prepare = prepare;
+    this->pending_meshes.push_back(pending);
+
+    // Objects have no-op transformations by default, so a plain Object is an invisible stand in.
+    this->push_object(proxy != NULL ? proxy : new Object());
+    return pending.index;
+}
+
+
+void Scene::swap_loaded_meshes(bool wait)
+{
+    for (auto it = this->pending_meshes.begin(); it != this->pending_meshes.end();)
+    {
+        if (!wait && it->mesh.wait_for(chrono::seconds(0)) != future_status::ready) {
+            it++;
+            continue;
+        }
+
+        Object *loaded;
+        try {
+            Object *mesh = it->prepare(it->mesh.get());
+            if (this->memory_budget > 0) {
+                MemoryUsage proxy, added;
+                this->objects[it->index]->add_memory_usage(proxy);
+                mesh->add_memory_usage(added);
+                size_t total = this->get_memory_usage().total() - proxy.total() + added.total();
+                if (total > this->memory_budget) {
+                    delete mesh;
+                    throw runtime_error("Malha " + to_string(it->index) + " deixada de fora: a cena passaria a usar "
+                                        + to_string(total) + " bytes, acima do limite de " + to_string(this->memory_budget));
+                }
+            }
+            for (auto &transformation : it->transformations) {
+                mesh->apply_transformation(transformation);
+            }
+            mesh->apply_coordinate_change(this->camera, CHANGE_FROM_WORLD_TO_CAMERA);
+            loaded = mesh;
+        } catch (exception &error) {
+            // The proxy goes away anyway, a mesh that failed to load is left invisible.
+            cerr << error.what() << endl;
+            loaded = new Object();
+        }
+
+        delete this->objects[it->index];
+        this->objects[it->index] = loaded;
+        this->culling_stale = true;
+        it = this->pending_meshes.erase(it);
+    }
+}
+
+
+bool Scene::has_pending_meshes()
+{
+    return !this->pending_meshes.empty();
+}
+
+bool Scene::has_loaded_meshes()
+{
+    for (PendingMesh &pending : this->pending_meshes) {
+        if (pending.mesh.wait_for(chrono::seconds(0)) == future_status::ready) return true;
+    }
+    return false;
+}
+
+
+void Scene::transform_object(int index, Matrix4 transformation)
+{
+    this->transform_objects({ObjectTransformation(index, transformation)});
+}
+
+
+void Scene::transform_objects(const vector<ObjectTransformation> &transformations)
+{
+    // Objects are stored in camera coordinates: camera -> world, the transformation, then back.
+    Matrix4 to_world = this->camera.get_camera_to_world_matrix();
+    Matrix4 to_camera = this->camera.get_world_to_camera_matrix();
+    this->culling_stale = true;
+
+    for (auto &item : transformations)
+    {
+        for (auto &pending : this->pending_meshes)
+        {
+            if (pending.index == item.object_index) pending.transformations.push_back(item.transformation);
+        }
+
+        this->objects.at(item.object_index)->apply_transformation(to_camera.multiply(item.transformation).multiply(to_world));
+    }
+}
+
+
+void Scene::flush_transformations()
+{
+    for (auto &obj : this->objects)
+    {
+        obj->flush_transformations();
+    }
+}
+
+
 void Scene::set_camera(Camera camera) {
     camera.window.should_update = true; // Please check if we have to pass camera as reference.
+    this->culling_stale = true;
 
     // Apply Camera matrix(W->C) to each object
     if (this->coordinates_type == WORLD_COORDINATES) {
@@ -115,11 +646,10 @@ void Scene::set_camera(Camera camera) {
         return;
     }
 
-    // Apply Old Camera matrix(C->W) to each object
-    // Apply New Camera matrix(W->C) to each object
+    // Apply Old Camera matrix(C->W) and New Camera matrix(W->C) to each object, composed into one matrix
+    Matrix4 change = camera.get_world_to_camera_matrix().multiply(this->camera.get_camera_to_world_matrix());
     for (auto& obj : this->objects) {
-        obj->apply_coordinate_change(this->camera, CHANGE_FROM_CAMERA_TO_WORLD); // Old camera
-        obj->apply_coordinate_change(camera, CHANGE_FROM_WORLD_TO_CAMERA); // New camera
+        obj->apply_transformation(change);
     }
 
     this->camera.destroy();
@@ -0,0 +1,218 @@
+#include "Server.hpp"
+#include "Reader.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace std;
+using namespace atividades_cg_1::server;
+using namespace atividades_cg_1::reader;
+
+
+static Vector3d read_request_vector(istringstream &iss)
+{
+    real x, y, z;
+    if (!(iss >> x >> y >> z)) {
+        throw runtime_error("esperado: x y z");
+    }
+    return Vector3d(x, y, z);
+}
+
+
+void RenderServer::send_frame(Connection &connection, Window &window, RenderTile region, string format, double frame_time_ms)
+{
+    int cols = region.last_col - region.first_col;
+    int rows = region.last_row - region.first_row;
+    string data;
+    if (format == "ppm") {
+        data = "P6\n" + to_string(cols) + " " + to_string(rows) + "\n255\n";
+    }
+    size_t header_size = data.size();
+    data.resize(header_size + (size_t)cols * rows * 3);
+
+    char *rgb = &data[header_size];
+    for (int l = region.first_row; l < region.last_row; l++) {
+        for (int c = region.first_col; c < region.last_col; c++) {
+            Color &color = window.windows_colors[l][c];
+            *rgb++ = (char)color.r;
+            *rgb++ = (char)color.g;
+            *rgb++ = (char)color.b;
+        }
+    }
+
+    ostringstream header;
+    header << "frame " << cols << " " << rows << " " << format << " " << data.size() << " " << frame_time_ms;
+    connection.write_line(header.str());
+    connection.write_bytes(data.data(), data.size());
+}
+
+
+bool RenderServer::handle_request(Connection &connection, const string &request)
+{
+    istringstream iss(request);
+    string type;
+    if (!(iss >> type)) {
+        return true;
+    }
+
+    if (type == "ping") {
+        connection.write_line("ok");
+    }
+    else if (type == "camera") {
+        Camera current = this->scene.get_camera();
+        Vector3d look_at = current.look_at, eye = current.eye, view_up = current.view_up;
+        real focal_distance = current.focal_distance;
+        string key;
+        while (iss >> key) {
+            if (key == "eye") eye = read_request_vector(iss);
+            else if (key == "look_at") look_at = read_request_vector(iss);
+            else if (key == "view_up") view_up = read_request_vector(iss);
+            else if (key == "focal" && iss >> focal_distance) continue;
+            else throw runtime_error("parâmetro de câmera desconhecido " + key);
+        }
+        this->scene.set_camera(Camera(look_at, eye, view_up, focal_distance, current.window.width, current.window.height,
+                                      current.window.cols, current.window.rows));
+        connection.write_line("ok");
+    }
+    else if (type == "resolution") {
+        int cols, rows;
+        if (!(iss >> cols >> rows) || cols <= 0 || rows <= 0) {
+            throw runtime_error("esperado: resolution cols rows");
+        }
+        Camera current = this->scene.get_camera();
+        Camera resized(current.look_at, current.eye, current.view_up, current.focal_distance, current.window.width, current.window.height, cols, rows);
+        resized.window.center = current.window.center;
+        this->scene.set_camera(resized);
+        connection.write_line("ok");
+    }
+    else if (type == "transform") {
+        int index;
+        if (!(iss >> index) || index < 0 || index >= (int)this->scene.objects.size()) {
+            throw runtime_error("índice de objeto inválido");
+        }
+        string transformations;
+        getline(iss, transformations);
+
+        // The transformations are written in world coordinates, and so is the center their scales keep fixed.
+        Camera camera = this->scene.get_camera();
+        Vector3d center = camera.transform_vector_from_camera_to_world(this->scene.objects[index]->get_center());
+        this->scene.transform_object(index, get_transformation_matrix(transformations, center));
+        connection.write_line("ok");
+    }
+    else if (type == "render") {
+        string format = "ppm";
+        iss >> format;
+        if (format != "ppm" && format != "raw") {
+            throw runtime_error("formato desconhecido " + format);
+        }
+        Window window = this->scene.get_camera().window;
+        FrameStats stats = render_frame(this->scene, window, this->settings);
+        this->record_memory(stats.framebuffer_bytes);
+        this->send_frame(connection, window, RenderTile(0, window.cols, 0, window.rows), format, stats.frame_time_ms);
+    }
+    else if (type == "tile") {
+        int first_col, first_row, last_col, last_row;
+        Window window = this->scene.get_camera().window;
+        if (!(iss >> first_col >> first_row >> last_col >> last_row) || first_col < 0 || first_row < 0
+            || last_col > window.cols || last_row > window.rows || first_col >= last_col || first_row >= last_row) {
+            throw runtime_error("esperado: tile first_col first_row last_col last_row, dentro da janela");
+        }
+        RenderTile region(first_col, last_col, first_row, last_row);
+        FrameStats stats = render_region(this->scene, window, region, this->settings);
+        this->record_memory(stats.framebuffer_bytes);
+        this->send_frame(connection, window, region, "raw", stats.frame_time_ms);
+    }
+    else if (type == "window") {
+        Window window = this->scene.get_camera().window;
+        connection.write_line("window " + to_string(window.cols) + " " + to_string(window.rows));
+    }
+    else if (type == "pick") {
+        int col, row;
+        if (!(iss >> col >> row)) {
+            throw runtime_error("esperado: pick col row");
+        }
+        PickResult result = this->scene.pick(col, row);
+        if (result.object == NULL) {
+            connection.write_line("pick none");
+        } else {
+            ostringstream line;
+            line << "pick " << result.object_index << " " << result.primitive_index << " " << result.point.x << " "
+                 << result.point.y << " " << result.point.z << " " << result.distance;
+            connection.write_line(line.str());
+        }
+    }
+    else if (type == "memory") {
+        this->record_memory(0);
+        string line = "memory total " + to_string(this->memory.current.total()) + " " + to_string(this->memory.peak_total);
+        for (int c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+            line += " " + get_memory_category_key(c) + " " + to_string(this->memory.current.bytes[c]) + " " + to_string(this->memory.peak.bytes[c]);
+        }
+        connection.write_line(line);
+    }
+    else if (type == "quit") {
+        connection.write_line("ok");
+        return false;
+    }
+    else if (type == "shutdown") {
+        connection.write_line("ok");
+        this->running = false;
+        return false;
+    }
+    else {
+        throw runtime_error("requisição desconhecida " + type);
+    }
+    return true;
+}
+
+
+void RenderServer::record_memory(size_t framebuffer_bytes)
+{
+    MemoryUsage usage = this->scene.get_memory_usage();
+    usage.add(MEMORY_FRAMEBUFFERS, framebuffer_bytes);
+    this->memory.record(usage);
+}
+
+
+int RenderServer::serve(string address)
+{
+    int listener;
+    try {
+        listener = listen_address(address);
+    } catch (runtime_error &error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    cout << "Servidor de renderização em " << address << endl;
+    this->record_memory(0);
+
+    while (this->running)
+    {
+        int fd = accept_connection(listener);
+        if (fd < 0) {
+            cerr << "Falha ao aceitar conexão em " << address << endl;
+            break;
+        }
+
+        Connection connection(fd);
+        string request;
+        while (connection.read_line(request))
+        {
+            bool keep_open;
+            try {
+                keep_open = this->handle_request(connection, request);
+            } catch (exception &error) {
+                keep_open = connection.write_line(string("error ") + error.what());
+            }
+            if (!keep_open) break;
+        }
+    }
+
+    close_socket(listener);
+    if (!is_tcp_address(address)) {
+        unlink(address.c_str());
+    }
+    cout << "Memória da cena:\n" << this->memory.describe();
+    return this->running ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+#include <algorithm>
+
+#include "Shading.hpp"
+
+using namespace std;
+using namespace atividades_cg_1::shading;
+
+
+void ShadingBatch::clear()
+{
+    this->objects.clear();
+    this->px.clear(); this->py.clear(); this->pz.clear();
+    this->nx.clear(); this->ny.clear(); this->nz.clear();
+    this->dx.clear(); this->dy.clear(); this->dz.clear();
+    this->albedo.clear();
+    this->visibility.clear();
+}
+
+
+int ShadingBatch::add_hit(Object *object, Vector3d point, Vector3d normal, Vector3d direction, Color albedo)
+{
+    this->objects.push_back(object);
+    this->px.push_back(point.x); this->py.push_back(point.y); this->pz.push_back(point.z);
+    this->nx.push_back(normal.x); this->ny.push_back(normal.y); this->nz.push_back(normal.z);
+    this->dx.push_back(direction.x); this->dy.push_back(direction.y); this->dz.push_back(direction.z);
+    this->albedo.push_back(albedo);
+    this->visibility.resize(this->visibility.size() + this->light_count, 1);
+    return this->objects.size() - 1;
+}
+
+
+void ShadingBatch::add_miss()
+{
+    this->add_hit(NULL, Vector3d(0, 0, 0), Vector3d(0, 0, 0), Vector3d(0, 0, 0), Color(0, 0, 0));
+}
+
+
+// pow(base, exponent) for integer exponents up to MAX_INTEGER_SHININESS, by squaring.
+// Every bit is visited, so there is no data dependent branch. Negative bases behave like std::pow.
+static inline real integer_pow(real base, int exponent)
+{
+    real result = 1;
+    for (int bit = 0; bit < 8; bit++)
+    {
+        result *= ((exponent >> bit) & 1) ? base : (real)1;
+        base *= base;
+    }
+    return result;
+}
+
+
+// Shades the hits listed in `indices`, which all share MATERIAL_CLASS.
+template <int MATERIAL_CLASS>
+static void shade_group(const ShadingBatch &batch, const vector<int> &indices, const ShadingParameters &parameters, Color *colors)
+{
+    const vector<SourceOfLight> &lights = *parameters.lights;
+    int light_count = lights.size();
+    Vector3d eye = parameters.eye;
+
+    for (int index : indices)
+    {
+        Object *obj = batch.objects[index];
+        Vector3d p(batch.px[index], batch.py[index], batch.pz[index]);
+        Vector3d n(batch.nx[index], batch.ny[index], batch.nz[index]);
+
+        // K_a, K_d and K_e weighted by the light intensities, accumulated unclamped.
+        real r = parameters.environment_light.r * obj->environment_reflectivity.r;
+        real g = parameters.environment_light.g * obj->environment_reflectivity.g;
+        real b = parameters.environment_light.b * obj->environment_reflectivity.b;
+
+        Vector3d v;
+        int integer_shininess = 0;
+        if constexpr (MATERIAL_CLASS != MATERIAL_DIFFUSE_ONLY) {
+            v = eye.minus(p).get_vector_normalized();
+            integer_shininess = (int)obj->shininess;
+        }
+
+        for (int l = 0; l < light_count; l++)
+        {
+            const SourceOfLight &light = lights[l];
+            real visibility = batch.visibility[index * light_count + l];
+
+            Vector3d light_vector = Vector3d(light.center.x - p.x, light.center.y - p.y, light.center.z - p.z).get_vector_normalized();
+            real f_difuse = std::max(light_vector.scalar_product(n), (real)0) * visibility;
+
+            r += light.intensity.r * obj->difuse_reflectivity.r * f_difuse;
+            g += light.intensity.g * obj->difuse_reflectivity.g * f_difuse;
+            b += light.intensity.b * obj->difuse_reflectivity.b * f_difuse;
+
+            if constexpr (MATERIAL_CLASS != MATERIAL_DIFFUSE_ONLY) {
+                Vector3d reflected = n.multiply(2).minus(light_vector).get_vector_normalized();
+                real cos_alpha = reflected.scalar_product(v);
+
+                real f_specular;
+                if constexpr (MATERIAL_CLASS == MATERIAL_PHONG_INTEGER) {
+                    f_specular = integer_pow(cos_alpha, integer_shininess);
+                } else {
+                    // A negative base with a fractional exponent has no real power.
+                    f_specular = std::pow(std::max(cos_alpha, (real)0), obj->shininess);
+                }
+                // Selected rather than multiplied, so a shadowed light never turns into NaN * 0.
+                f_specular = visibility > 0 ? f_specular * visibility : 0;
+
+                r += light.intensity.r * obj->specular_reflectivity.r * f_specular;
+                g += light.intensity.g * obj->specular_reflectivity.g * f_specular;
+                b += light.intensity.b * obj->specular_reflectivity.b * f_specular;
+            }
+        }
+
+        // Single clamp per channel, at the end.
+        r = std::min(std::max(r, (real)0), (real)1);
+        g = std::min(std::max(g, (real)0), (real)1);
+        b = std::min(std::max(b, (real)0), (real)1);
+        const Color &albedo = batch.albedo[index];
+        colors[index] = Color(albedo.r * r, albedo.g * g, albedo.b * b);
+    }
+}
+
+
+void atividades_cg_1::shading::shade_batch(const ShadingBatch &batch, const ShadingParameters &parameters, Color *colors)
+{
+    // Materials are classified when they are set, here we only bucket the hits.
+    vector<int> diffuse_only, phong_integer, phong;
+    for (int i = 0; i < batch.size(); i++)
+    {
+        Object *obj = batch.objects[i];
+        if (obj == NULL) {
+            colors[i] = parameters.background_color;
+            continue;
+        }
+
+        switch (obj->material_class)
+        {
+        case MATERIAL_DIFFUSE_ONLY:
+            diffuse_only.push_back(i);
+            break;
+        case MATERIAL_PHONG_INTEGER:
+            phong_integer.push_back(i);
+            break;
+        default:
+            phong.push_back(i);
+            break;
+        }
+    }
+
+    shade_group<MATERIAL_DIFFUSE_ONLY>(batch, diffuse_only, parameters, colors);
+    shade_group<MATERIAL_PHONG_INTEGER>(batch, phong_integer, parameters, colors);
+    shade_group<MATERIAL_PHONG>(batch, phong, parameters, colors);
+}
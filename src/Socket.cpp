@@ -0,0 +1,229 @@
+#include "Socket.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace atividades_cg_1::network;
+
+
+Connection::~Connection()
+{
+    close_socket(this->fd);
+}
+
+
+bool Connection::read_line(string &line)
+{
+    for (;;)
+    {
+        size_t line_end = this->buffer.find('\n');
+        if (line_end != string::npos) {
+            line = this->buffer.substr(0, line_end);
+            this->buffer.erase(0, line_end + 1);
+            return true;
+        }
+
+        char chunk[4096];
+        ssize_t received = recv(this->fd, chunk, sizeof(chunk), 0);
+        if (received <= 0) return false;
+        this->buffer.append(chunk, received);
+    }
+}
+
+
+bool Connection::read_bytes(char *data, size_t size)
+{
+    // Bytes that arrived together with the last line come first.
+    size_t buffered = min(size, this->buffer.size());
+    memcpy(data, this->buffer.data(), buffered);
+    this->buffer.erase(0, buffered);
+
+    for (size_t done = buffered; done < size;)
+    {
+        ssize_t received = recv(this->fd, data + done, size - done, 0);
+        if (received <= 0) return false;
+        done += received;
+    }
+    return true;
+}
+
+
+bool Connection::write_bytes(const char *data, size_t size)
+{
+    for (size_t done = 0; done < size;)
+    {
+        // MSG_NOSIGNAL: a client that went away is an error for this request, not a SIGPIPE for the process.
+        ssize_t sent = send(this->fd, data + done, size - done, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        done += sent;
+    }
+    return true;
+}
+
+
+bool Connection::write_line(const string &line)
+{
+    string data = line + "\n";
+    return this->write_bytes(data.data(), data.size());
+}
+
+
+static sockaddr_un unix_address(string path)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw runtime_error("Caminho de socket longo demais: " + path);
+    }
+    strcpy(address.sun_path, path.c_str());
+    return address;
+}
+
+
+int atividades_cg_1::network::listen_unix(string path)
+{
+    sockaddr_un address = unix_address(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw runtime_error("Não foi possível criar o socket " + path);
+    }
+
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr *)&address, sizeof(address)) < 0 || listen(fd, 16) < 0) {
+        close(fd);
+        throw runtime_error("Não foi possível escutar em " + path + ": " + strerror(errno));
+    }
+    return fd;
+}
+
+
+int atividades_cg_1::network::connect_unix(string path)
+{
+    sockaddr_un address = unix_address(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    if (connect(fd, (sockaddr *)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+// First address of host:port that `use` accepts (bind or connect), as a descriptor; -1 if none does.
+template <typename Use>
+static int open_tcp(string host, int port, bool passive, Use use)
+{
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+    addrinfo *addresses;
+    if (getaddrinfo(host.empty() ? NULL : host.c_str(), to_string(port).c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo *address = addresses; address != NULL && fd < 0; address = address->ai_next)
+    {
+        fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) continue;
+        if (!use(fd, address)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+
+int atividades_cg_1::network::listen_tcp(string host, int port)
+{
+    int fd = open_tcp(host, port, true, [](int fd, addrinfo *address) {
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        return bind(fd, address->ai_addr, address->ai_addrlen) == 0 && listen(fd, 16) == 0;
+    });
+    if (fd < 0) {
+        throw runtime_error("Não foi possível escutar em " + host + ":" + to_string(port));
+    }
+    return fd;
+}
+
+
+int atividades_cg_1::network::connect_tcp(string host, int port)
+{
+    return open_tcp(host, port, false, [](int fd, addrinfo *address) {
+        // Requests are small lines answered right away; Nagle would hold them back.
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        return connect(fd, address->ai_addr, address->ai_addrlen) == 0;
+    });
+}
+
+
+bool atividades_cg_1::network::is_tcp_address(string address)
+{
+    return !address.empty() && address[0] != '/' && address[0] != '.' && address.find(':') != string::npos;
+}
+
+
+static void split_tcp_address(string address, string &host, int &port)
+{
+    size_t separator = address.rfind(':');
+    host = address.substr(0, separator);
+    try {
+        port = stoi(address.substr(separator + 1));
+    } catch (exception &) {
+        throw runtime_error("Endereço inválido: " + address);
+    }
+}
+
+
+int atividades_cg_1::network::listen_address(string address)
+{
+    if (!is_tcp_address(address)) return listen_unix(address);
+    string host;
+    int port;
+    split_tcp_address(address, host, port);
+    return listen_tcp(host, port);
+}
+
+
+int atividades_cg_1::network::connect_address(string address)
+{
+    if (!is_tcp_address(address)) return connect_unix(address);
+    string host;
+    int port;
+    split_tcp_address(address, host, port);
+    return connect_tcp(host, port);
+}
+
+
+int atividades_cg_1::network::accept_connection(int listener)
+{
+    for (;;)
+    {
+        int fd = accept(listener, NULL, NULL);
+        if (fd >= 0 || errno != EINTR) return fd;
+    }
+}
+
+
+void atividades_cg_1::network::close_socket(int fd)
+{
+    if (fd >= 0) close(fd);
+}
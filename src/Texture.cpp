@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Texture.hpp"
+#include "Image.hpp"
+
+using namespace std;
+using namespace atividades_cg_1::texture;
+using namespace atividades_cg_1::image;
+
+
+Texture::Texture(const vector<vector<Color>> &pixels)
+{
+    int width = pixels.empty() ? 0 : pixels[0].size();
+    int height = pixels.size();
+    if (width == 0 || height == 0) {
+        throw runtime_error("Textura vazia");
+    }
+
+    // Levels are whole blocks, so a level starts on a block boundary and blocks never straddle two levels.
+    size_t offset = 0;
+    for (;;)
+    {
+        MipLevel level;
+        level.width = width;
+        level.height = height;
+        level.tiles_per_row = (width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        level.offset = offset;
+        this->levels.push_back(level);
+        offset += (size_t)level.tiles_per_row * ((height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE)
+                  * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE;
+        if (width == 1 && height == 1) break;
+        width = max(1, width / 2);
+        height = max(1, height / 2);
+    }
+    this->texels.resize(offset);
+
+    for (int y = 0; y < this->levels[0].height; y++) {
+        for (int x = 0; x < this->levels[0].width; x++) {
+            this->texel(this->levels[0], x, y) = pixels[y][x];
+        }
+    }
+
+    // Box filter: each texel averages the 2x2 block under it in the previous level. An odd last row or column
+    // is folded into its neighbour, so every texel of the previous level is counted.
+    for (size_t l = 1; l < this->levels.size(); l++)
+    {
+        const MipLevel &source = this->levels[l - 1];
+        const MipLevel &level = this->levels[l];
+        for (int y = 0; y < level.height; y++)
+        {
+            int y_last = y == level.height - 1 ? source.height - 1 : 2 * y + 1;
+            for (int x = 0; x < level.width; x++)
+            {
+                int x_last = x == level.width - 1 ? source.width - 1 : 2 * x + 1;
+                int r = 0, g = 0, b = 0, count = 0;
+                for (int sy = 2 * y; sy <= y_last; sy++) {
+                    for (int sx = 2 * x; sx <= x_last; sx++) {
+                        const Color &c = this->texel(source, sx, sy);
+                        r += c.r;
+                        g += c.g;
+                        b += c.b;
+                        count++;
+                    }
+                }
+                this->texel(level, x, y) = Color((r + count / 2) / count, (g + count / 2) / count, (b + count / 2) / count);
+            }
+        }
+    }
+}
+
+
+shared_ptr<Texture> Texture::load(string file_path)
+{
+    return make_shared<Texture>(read_ppm(file_path));
+}
+
+
+void Texture::bilinear(const MipLevel &level, real u, real v, real *rgb) const
+{
+    // Texel centers are at half integers.
+    real x = u * level.width - (real)0.5;
+    real y = v * level.height - (real)0.5;
+    real x_floor = std::floor(x), y_floor = std::floor(y);
+    real fx = x - x_floor, fy = y - y_floor;
+
+    auto wrap = [](long value, int size) {
+        int wrapped = value % size;
+        return wrapped < 0 ? wrapped + size : wrapped;
+    };
+    int x0 = wrap((long)x_floor, level.width), x1 = x0 + 1 == level.width ? 0 : x0 + 1;
+    int y0 = wrap((long)y_floor, level.height), y1 = y0 + 1 == level.height ? 0 : y0 + 1;
+
+    const Color &a = this->texel(level, x0, y0), &b = this->texel(level, x1, y0);
+    const Color &c = this->texel(level, x0, y1), &d = this->texel(level, x1, y1);
+    real wa = (1 - fx) * (1 - fy), wb = fx * (1 - fy), wc = (1 - fx) * fy, wd = fx * fy;
+    rgb[0] = a.r * wa + b.r * wb + c.r * wc + d.r * wd;
+    rgb[1] = a.g * wa + b.g * wb + c.g * wc + d.g * wd;
+    rgb[2] = a.b * wa + b.b * wb + c.b * wc + d.b * wd;
+}
+
+
+Color Texture::sample(real u, real v, real footprint) const
+{
+    // Level where the footprint covers one texel along the longest side.
+    real texels_covered = footprint * max(this->levels[0].width, this->levels[0].height);
+    real lod = texels_covered > 1 ? std::log2(texels_covered) : 0;
+    lod = min(lod, (real)(this->levels.size() - 1));
+
+    int level = (int)lod;
+    real blend = lod - level;
+    real rgb[3];
+    this->bilinear(this->levels[level], u, v, rgb);
+    if (blend > 0) {
+        real coarser[3];
+        this->bilinear(this->levels[level + 1], u, v, coarser);
+        for (int i = 0; i < 3; i++) {
+            rgb[i] += (coarser[i] - rgb[i]) * blend;
+        }
+    }
+    return Color((uint8_t)std::lround(rgb[0]), (uint8_t)std::lround(rgb[1]), (uint8_t)std::lround(rgb[2]));
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include "Timeline.hpp"
+
+using namespace std;
+using namespace atividades_cg_1::timeline;
+
+
+// Every ring ever created, and those whose thread ended. Never destroyed, so rings outlive the threads (and the
+// thread local handles) that wrote them, up to the write_timeline at the end of main.
+class TimelinePool
+{
+public:
+    mutex lock;
+    vector<unique_ptr<ThreadTimeline>> all;
+    vector<ThreadTimeline *> released;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+};
+
+
+static TimelinePool &get_pool()
+{
+    static TimelinePool *pool = new TimelinePool();
+    return *pool;
+}
+
+
+// The calling thread's ring, taken on its first event and given back when the thread ends.
+class ThreadTimelineHandle
+{
+public:
+    ThreadTimeline *timeline = NULL;
+
+    ThreadTimeline &get()
+    {
+        if (this->timeline == NULL) {
+            TimelinePool &pool = get_pool();
+            lock_guard<mutex> guard(pool.lock);
+            if (!pool.released.empty()) {
+                this->timeline = pool.released.back();
+                pool.released.pop_back();
+            } else {
+                pool.all.push_back(make_unique<ThreadTimeline>((int)pool.all.size()));
+                this->timeline = pool.all.back().get();
+            }
+        }
+        return *this->timeline;
+    }
+
+    ~ThreadTimelineHandle()
+    {
+        if (this->timeline == NULL) return;
+        TimelinePool &pool = get_pool();
+        lock_guard<mutex> guard(pool.lock);
+        pool.released.push_back(this->timeline);
+    }
+};
+
+
+static thread_local ThreadTimelineHandle thread_timeline;
+
+
+void atividades_cg_1::timeline::enable_timeline()
+{
+    get_pool().start = chrono::steady_clock::now();
+    timeline_enabled.store(true);
+}
+
+
+uint64_t atividades_cg_1::timeline::timeline_clock()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - get_pool().start).count();
+}
+
+
+void atividades_cg_1::timeline::record_event(const char *name, uint64_t start_ns, uint64_t end_ns)
+{
+    thread_timeline.get().record(TimelineEvent{name, start_ns, end_ns - start_ns});
+}
+
+
+void atividades_cg_1::timeline::name_thread(const string &name)
+{
+    if (!timeline_enabled.load(memory_order_relaxed)) return;
+    thread_timeline.get().name = name;
+}
+
+
+uint64_t atividades_cg_1::timeline::write_timeline(const string &path)
+{
+    ofstream file(path);
+    if (!file) {
+        throw runtime_error("Não foi possível criar a linha do tempo " + path);
+    }
+
+    TimelinePool &pool = get_pool();
+    lock_guard<mutex> guard(pool.lock);
+    uint64_t lost = 0;
+    bool first = true;
+    auto separator = [&]() -> ofstream & {
+        file << (first ? "\n" : ",\n");
+        first = false;
+        return file;
+    };
+
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (auto &timeline : pool.all)
+    {
+        separator() << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << timeline->id
+                    << ", \"args\": {\"name\": \"" << timeline->name << "\"}}";
+
+        uint64_t written = timeline->written.load(memory_order_acquire);
+        uint64_t kept = min<uint64_t>(written, ThreadTimeline::CAPACITY);
+        lost += written - kept;
+        for (uint64_t i = written - kept; i < written; i++)
+        {
+            const TimelineEvent &event = timeline->events[i & (ThreadTimeline::CAPACITY - 1)];
+            // Microseconds, as the format expects, with the nanoseconds as decimals.
+            separator() << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << timeline->id
+                        << ", \"ts\": " << event.start_ns / 1000 << "." << to_string(1000 + event.start_ns % 1000).substr(1)
+                        << ", \"dur\": " << event.duration_ns / 1000 << "." << to_string(1000 + event.duration_ns % 1000).substr(1) << "}";
+        }
+    }
+    file << "\n]}\n";
+    return lost;
+}
+
+
+TimelineFile::~TimelineFile()
+{
+    if (this->path.empty()) return;
+    try {
+        uint64_t lost = write_timeline(this->path);
+        cout << "Linha do tempo em " << this->path;
+        if (lost > 0) {
+            cout << " (" << lost << " eventos antigos descartados)";
+        }
+        cout << endl;
+    } catch (runtime_error &error) {
+        cerr << error.what() << endl;
+    }
+}
@@ -2,6 +2,12 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <fstream>
+#include <filesystem>
+#include <unistd.h>
 
 #include "Color.hpp"
 #include "Algebra.hpp"
@@ -9,6 +15,15 @@
 #include "Camera.hpp"
 #include "Scene.hpp"
 #include "Reader.hpp"
+#include "Render.hpp"
+#include "Regression.hpp"
+#include "Image.hpp"
+#include "Texture.hpp"
+#include "Animation.hpp"
+#include "Server.hpp"
+#include "Distributed.hpp"
+#include "Interactive.hpp"
+#include "Timeline.hpp"
 
 using namespace std;
 
@@ -17,9 +32,22 @@ using namespace atividades_cg_1::algebra;
 using namespace atividades_cg_1::objects;
 using namespace atividades_cg_1::camera;
 using namespace atividades_cg_1::scene;
+using namespace atividades_cg_1::render;
+using namespace atividades_cg_1::regression;
+using namespace atividades_cg_1::image;
+using namespace atividades_cg_1::animation;
+using namespace atividades_cg_1::server;
+using namespace atividades_cg_1::distributed;
+using namespace atividades_cg_1::interactive;
+using namespace atividades_cg_1::timeline;
 
 void run_tests();
-int render_picture(int n_rows, int n_cols, int sdl_width, int sdl_height, float window_width, float window_height);
+Scene *create_default_scene(int n_rows, int n_cols, float window_width, float window_height);
+int render_picture(Scene &scene, RenderSettings settings, double target_fps, int sdl_width, int sdl_height);
+int play_animation(Scene &scene, Animation &animation, RenderSettings settings, int sdl_width, int sdl_height);
+int write_animation(Scene &scene, Animation &animation, RenderSettings settings, string frames_dir);
+int render_distributed(vector<string> worker_addresses, string scene_path, int local_workers, int threads, string output_path);
+bool open_sdl_window(int sdl_width, int sdl_height, SDL_Window **window, SDL_Renderer **renderer);
 
 int main(int argc, char *argv[])
 {
@@ -27,11 +55,211 @@ int main(int argc, char *argv[])
     float window_height = 60;
     // window width and height will be 1.0 meter. We will render everything in a SDL window with pixes specified.
     run_tests();
-    return render_picture(500, 500, 500, 500, window_width, window_height);
+
+    // Headless regression suite: --regression checks golden images and timings, --update-golden records them.
+    RegressionOptions regression_options;
+    bool run_regression = false;
+    bool run_benchmark = false;
+    // --benchmark-obj times the OBJ reader on the given file with increasing thread counts.
+    string benchmark_obj_path;
+    // --traversal picks the primary ray order (scanline, rows, morton, hilbert), --threads the tracing threads.
+    RenderSettings render_settings;
+    // --max-bounces and --ray-budget (secondary rays per pixel, negative for unlimited) bound mirrors and glass.
+    SecondaryRaySettings secondary_ray_settings;
+    // --shadow-samples sets the shadow rays of every area light, --denoise filters each frame (see Denoise.hpp):
+    // together they give fast previews of scenes with soft shadows.
+    // --heatmap intersections|shadows|cycles shows what each pixel cost instead of its color, in the window or in --output.
+    int shadow_samples = 0;
+    // --target-fps is the frame rate the interactive window keeps while the camera moves, by lowering the resolution.
+    double target_fps = 30;
+    // --scene loads a scene description instead of the built-in scene, --output renders one frame to a PPM without SDL.
+    string scene_path;
+    string output_path;
+    // --static-dispatch loads --scene into a ProductionScene, which intersects its objects without virtual calls.
+    bool static_dispatch = false;
+    // Animations described in the scene file: --animate plays them in the SDL window, --frames-dir writes one PPM per frame.
+    bool animate = false;
+    string frames_dir;
+    // --serve keeps the scene loaded and renders on request over a Unix domain socket (see Server.hpp).
+    string socket_path;
+    // --workers renders --output through running servers (host:port or socket paths, comma separated),
+    // --local-workers through that many servers of --scene started here. --check-distributed N is the ctest for it.
+    vector<string> worker_addresses;
+    int local_workers = 0;
+    int distributed_check_workers = 0;
+    // --memory-report prints the memory of each subsystem (now and at peak) after --output, --memory-budget MB
+    // leaves out the meshes that would take the scene past that size.
+    bool memory_report = false;
+    size_t memory_budget = 0;
+    // --timeline writes the phases of the run (loading, culling, tiles, shading, presenting) as a Chrome trace
+    // when main returns, one row per thread; open it in about:tracing or ui.perfetto.dev.
+    TimelineFile timeline_file;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--regression") {
+            run_regression = true;
+        } else if (arg == "--update-golden") {
+            run_regression = true;
+            regression_options.update = true;
+        } else if (arg == "--benchmark-traversal") {
+            run_benchmark = true;
+        } else if (arg == "--benchmark-obj" && i + 1 < argc) {
+            benchmark_obj_path = argv[++i];
+        } else if (arg == "--traversal" && i + 1 < argc) {
+            render_settings.traversal_order = parse_traversal_order(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            render_settings.thread_count = stoi(argv[++i]);
+        } else if (arg == "--max-bounces" && i + 1 < argc) {
+            secondary_ray_settings.max_depth = stoi(argv[++i]);
+        } else if (arg == "--shadow-samples" && i + 1 < argc) {
+            shadow_samples = stoi(argv[++i]);
+        } else if (arg == "--denoise") {
+            render_settings.denoise = true;
+        } else if (arg == "--heatmap" && i + 1 < argc) {
+            render_settings.heatmap = parse_cost_metric(argv[++i]);
+        } else if (arg == "--ray-budget" && i + 1 < argc) {
+            secondary_ray_settings.rays_per_pixel = stod(argv[++i]);
+        } else if (arg == "--target-fps" && i + 1 < argc) {
+            target_fps = stod(argv[++i]);
+        } else if (arg == "--golden-dir" && i + 1 < argc) {
+            regression_options.golden_dir = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            regression_options.baseline_path = argv[++i];
+        } else if (arg == "--time-tolerance" && i + 1 < argc) {
+            regression_options.time_tolerance = stod(argv[++i]);
+        } else if (arg == "--scene" && i + 1 < argc) {
+            scene_path = argv[++i];
+        } else if (arg == "--static-dispatch") {
+            static_dispatch = true;
+        } else if (arg == "--output" && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (arg == "--animate") {
+            animate = true;
+        } else if (arg == "--frames-dir" && i + 1 < argc) {
+            frames_dir = argv[++i];
+        } else if (arg == "--serve" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            worker_addresses = parse_worker_addresses(argv[++i]);
+        } else if (arg == "--local-workers" && i + 1 < argc) {
+            local_workers = stoi(argv[++i]);
+        } else if (arg == "--memory-report") {
+            memory_report = true;
+        } else if (arg == "--memory-budget" && i + 1 < argc) {
+            memory_budget = (size_t)(stod(argv[++i]) * 1024 * 1024);
+        } else if (arg == "--timeline" && i + 1 < argc) {
+            timeline_file.path = argv[++i];
+            enable_timeline();
+            name_thread("main");
+        } else if (arg == "--check-distributed" && i + 1 < argc) {
+            distributed_check_workers = stoi(argv[++i]);
+        } else {
+            cerr << "Argumento desconhecido: " << arg << endl;
+            return 1;
+        }
+    }
+
+    if (run_regression) {
+        return run_regression_suite(regression_options);
+    }
+    if (run_benchmark) {
+        return run_traversal_benchmark(regression_options);
+    }
+    if (!benchmark_obj_path.empty()) {
+        return run_obj_benchmark(benchmark_obj_path, regression_options);
+    }
+
+    if (distributed_check_workers > 0 || local_workers > 0 || !worker_addresses.empty()) {
+        if ((distributed_check_workers > 0 || local_workers > 0) && scene_path.empty()) {
+            cerr << "Workers locais precisam de --scene." << endl;
+            return 1;
+        }
+        if (distributed_check_workers > 0) {
+            return run_distributed_check(scene_path, distributed_check_workers, regression_options);
+        }
+        if (output_path.empty()) {
+            cerr << "A renderização distribuída precisa de --output." << endl;
+            return 1;
+        }
+        return render_distributed(worker_addresses, scene_path, local_workers, render_settings.thread_count, output_path);
+    }
+
+    Scene *scene;
+    SceneReader reader;
+    reader.static_dispatch = static_dispatch;
+    if (scene_path.empty()) {
+        scene = create_default_scene(500, 500, window_width, window_height);
+    } else {
+        try {
+            scene = reader.read_scene_file(scene_path);
+        } catch (runtime_error &error) {
+            cerr << error.what() << endl;
+            return 1;
+        }
+    }
+
+    scene->secondary_ray_settings = secondary_ray_settings;
+    scene->memory_budget = memory_budget;
+    if (shadow_samples > 0) {
+        for (auto &light : scene->sources_of_light) {
+            light.set_sample_count(shadow_samples);
+        }
+    }
+
+    if ((animate || !frames_dir.empty()) && reader.animation.frame_count == 0) {
+        cerr << "A cena não descreve nenhuma animação (comando animation frames N)." << endl;
+        return 1;
+    }
+
+    // Offline output and the server wait for every mesh; the windows start right away and show meshes as they finish loading.
+    if (!frames_dir.empty() || !output_path.empty() || !socket_path.empty()) {
+        scene->swap_loaded_meshes(true);
+    }
+
+    int result = 0;
+    if (!socket_path.empty()) {
+        RenderServer server(*scene, render_settings);
+        result = server.serve(socket_path);
+    } else if (!frames_dir.empty()) {
+        result = write_animation(*scene, reader.animation, render_settings, frames_dir);
+    } else if (animate) {
+        Camera camera = scene->get_camera();
+        result = play_animation(*scene, reader.animation, render_settings, camera.window.cols, camera.window.rows);
+    } else if (!output_path.empty()) {
+        MemoryAccount memory;
+        memory.record(scene->get_memory_usage());
+        Window window = scene->get_camera().window;
+        FrameStats stats = render_frame(*scene, window, render_settings);
+        MemoryUsage usage = scene->get_memory_usage();
+        usage.add(MEMORY_FRAMEBUFFERS, stats.framebuffer_bytes);
+        memory.record(usage);
+        write_ppm(output_path, window.windows_colors);
+        cout << output_path << ": " << stats.frame_time_ms << " ms, " << stats.secondary_rays << " raios secundários";
+        if (render_settings.denoise) {
+            cout << ", " << stats.denoise_time_ms << " ms no filtro";
+        }
+        if (render_settings.heatmap != COST_NONE) {
+            cout << ", " << stats.intersection_tests << " testes de interseção, " << stats.shadow_tests
+                 << " raios de sombra, escala do mapa até " << stats.heatmap_scale;
+        }
+        cout << endl;
+        if (memory_report) {
+            cout << "Memória da cena:\n" << memory.describe();
+        }
+    } else {
+        Camera camera = scene->get_camera();
+        result = render_picture(*scene, render_settings, target_fps, camera.window.cols, camera.window.rows);
+    }
+
+    scene->dealloc_objects();
+    scene->get_camera().destroy();
+    delete scene;
+    return result;
 }
 
 
-int render_picture(int n_rows, int n_cols, int sdl_width, int sdl_height, float window_width, float window_height)
+Scene *create_default_scene(int n_rows, int n_cols, float window_width, float window_height)
 {
     Vector3d look_at(400,100, -200);
     Vector3d view_up(-390,1000000,-100);
@@ -40,8 +268,6 @@ int render_picture(int n_rows, int n_cols, int sdl_width, int sdl_height, float
 
     Camera camera(look_at, eye, view_up, focal_distance, window_width, window_height, n_cols, n_rows);
     // Window *cretos_window = new Window(window_width, window_height, n_cols, n_rows, 0, 0, -30);
-    float width_ratio = 1; // sdl_width / (float)n_cols;
-    float height_ratio = 1; // sdl_height / (float)n_rows;
 
     IntensityColor source_intensity = IntensityColor(.7, .7, .7);
     IntensityColor sphere_k_d = IntensityColor(.7, .2, .2);
@@ -51,7 +277,7 @@ int render_picture(int n_rows, int n_cols, int sdl_width, int sdl_height, float
     SourceOfLight pontual_light(source_intensity, Vector3d(0, 100, -100));
     IntensityColor environment_light_intensity = IntensityColor(0.3, 0.3, 0.3); // Come from every direction uniformly
 
-    Scene scene(Color(30, 30, 30), pontual_light, environment_light_intensity, camera);
+    Scene *scene = new Scene(Color(30, 30, 30), pontual_light, environment_light_intensity, camera);
 
     float sphere_radius = 20;
     IntensityColor floor_plan_k_difuse = IntensityColor(.2, .7, .2);
@@ -75,25 +301,121 @@ int render_picture(int n_rows, int n_cols, int sdl_width, int sdl_height, float
     // Triangle *triangle2 = new Triangle(Vector3d(-20, 0, -100), Vector3d(20, 0, -100), Vector3d(0, 20, -100));
     
     
-    scene.push_object(sphere);
-    scene.push_object(floor_plan);
-    scene.push_object(back_plan);
-    scene.push_object(left_plan);
-    scene.push_object(right_plan);
-    scene.push_object(front_plan);
-    scene.push_object(roof_plan);
+    scene->push_object(sphere);
+    scene->push_object(floor_plan);
+    scene->push_object(back_plan);
+    scene->push_object(left_plan);
+    scene->push_object(right_plan);
+    scene->push_object(front_plan);
+    scene->push_object(roof_plan);
+
+    // Read in background; the scene is drawn without the cube until it is loaded.
+    // scene->push_pending_mesh(std::async(std::launch::async, []() -> Object * { return ObjFactory::create_cube(); }).share(), [](Object *cube) { return cube; }, NULL);
+
+    return scene;
+}
+
+
+int render_picture(Scene &scene, RenderSettings settings, double target_fps, int sdl_width, int sdl_height)
+{
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    if (!open_sdl_window(sdl_width, sdl_height, &window, &renderer))
+    {
+        return 1;
+    }
+    Window full = scene.get_camera().window;
+    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING, full.cols, full.rows);
+
+    // Frames are traced by the render thread. This thread sleeps in SDL_WaitEventTimeout until a key, a window
+    // event or the FRAME_READY event of the render thread arrives, and presents only new frames.
+    Uint32 frame_ready_event = SDL_RegisterEvents(1);
+    RenderThread render_thread(scene, settings, target_fps, [frame_ready_event]() {
+        SDL_Event event = {};
+        event.type = frame_ready_event;
+        SDL_PushEvent(&event);
+    });
 
-    Mesh* cube = ObjFactory::create_cube();
-    // scene.push_object(cube);
+    bool isRunning = true;
+    bool has_frame = false;
+    SDL_Event event;
+    const real step = 10;
 
+    while (isRunning)
+    {
+        // The timeout only matters when a FRAME_READY event is lost, as SDL drops events when its queue is full.
+        bool has_event = SDL_WaitEventTimeout(&event, 250);
+        bool present = false;
+
+        if (has_event && event.type == SDL_QUIT)
+        {
+            isRunning = false;
+        }
+
+        // WASD moves the camera on its plane, Q and E move it down and up.
+        if (has_event && event.type == SDL_KEYDOWN)
+        {
+            real right = 0, up = 0, forward = 0;
+            switch (event.key.keysym.sym)
+            {
+            case SDLK_w: case SDLK_UP: forward = step; break;
+            case SDLK_s: case SDLK_DOWN: forward = -step; break;
+            case SDLK_a: case SDLK_LEFT: right = -step; break;
+            case SDLK_d: case SDLK_RIGHT: right = step; break;
+            case SDLK_q: up = -step; break;
+            case SDLK_e: up = step; break;
+            default: break;
+            }
+
+            if (right != 0 || up != 0 || forward != 0) {
+                render_thread.move_camera(right, up, forward);
+            }
+        }
+
+        // The window may have been uncovered: paint the last frame again.
+        if (has_event && event.type == SDL_WINDOWEVENT)
+        {
+            present = has_frame;
+        }
+
+        if (render_thread.take_frame())
+        {
+            PresentedFrame &frame = render_thread.get_frame();
+            TimelineScope scope("upload frame");
+            SDL_UpdateTexture(texture, NULL, frame.rgb.data(), frame.cols * 3);
+            has_frame = present = true;
+        }
+
+        if (present)
+        {
+            TimelineScope scope("present");
+            SDL_RenderClear(renderer);
+            SDL_RenderCopy(renderer, texture, NULL, NULL);
+            SDL_RenderPresent(renderer);
+        }
+    }
+
+    render_thread.stop();
+
+    // Free the memory
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+}
+
+
+bool open_sdl_window(int sdl_width, int sdl_height, SDL_Window **window, SDL_Renderer **renderer)
+{
     // Initialize library
     if (SDL_Init(SDL_INIT_VIDEO) < 0)
     {
         SDL_Log("Não foi possível inicializar o SDL! SDL_Error: %s", SDL_GetError());
-        return 1;
+        return false;
     }
 
-    SDL_Window *window = SDL_CreateWindow(
+    *window = SDL_CreateWindow(
         "Computação Gráfica I - Bruno e Guilherme",
         SDL_WINDOWPOS_UNDEFINED,
         SDL_WINDOWPOS_UNDEFINED,
@@ -101,133 +423,404 @@ int render_picture(int n_rows, int n_cols, int sdl_width, int sdl_height, float
         sdl_height,
         SDL_WINDOW_SHOWN);
 
-    if (!window)
+    if (!*window)
     {
         SDL_Log("Criação da janela falhou! SDL_Error: %s", SDL_GetError());
         SDL_Quit();
-        return 1;
+        return false;
     }
 
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    if (!renderer)
+    *renderer = SDL_CreateRenderer(*window, -1, SDL_RENDERER_ACCELERATED);
+    if (!*renderer)
     {
         SDL_Log("Criação do renderer falhou! SDL_Error: %s", SDL_GetError());
-        SDL_DestroyWindow(window);
+        SDL_DestroyWindow(*window);
         SDL_Quit();
-        return 1;
+        return false;
     }
+    return true;
+}
 
-    bool isRunning = true;
-    SDL_Event event;
-
-    // using pointers to save memory inside the loop
-    Ray *ray = new Ray();
-    Vector3d *center_of_small_rectangle = new Vector3d();
 
-    while (isRunning)
+int play_animation(Scene &scene, Animation &animation, RenderSettings settings, int sdl_width, int sdl_height)
+{
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    if (!open_sdl_window(sdl_width, sdl_height, &window, &renderer))
     {
-        // Event listening
+        return 1;
+    }
+
+    Window first = scene.get_camera().window;
+    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING, first.cols, first.rows);
+    PresentedFrame packed;
+
+    // Frame N is presented here while the next one is traced in background.
+    render_animation(scene, animation, [&](int, Window &frame_window) {
+        SDL_Event event;
         while (SDL_PollEvent(&event))
         {
-            if (event.type == SDL_QUIT)
-            {
-                isRunning = false;
-                camera.window.should_update = true;
-            }
+            if (event.type == SDL_QUIT) return false;
+        }
 
-            if (event.type == SDL_KEYUP)
-            { 
+        TimelineScope scope("present");
+        pack_frame(frame_window, packed);
+        SDL_UpdateTexture(texture, NULL, packed.rgb.data(), packed.cols * 3);
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+        return true;
+    }, settings);
 
-                // Matrix m = MatrixTransformations::arbitrary_rotation(M_PI/3, Vector3d(0,0,-100), Vector3d(0,20,-100));
-                // triangle2->apply_transformation(m);
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+}
 
-                // sphere->apply_transformation(translation_matrix);
-                // triangle2->apply_scale_transformation(1.1, 1.1, 1.1);
 
-                // triangle2->apply_transformation(translation_matrix);
-                // triangle2->apply_rotation_transformation(M_PI/18, Y_AXIS);
+int write_animation(Scene &scene, Animation &animation, RenderSettings settings, string frames_dir)
+{
+    auto start = chrono::steady_clock::now();
+
+    // Frame N is encoded here while the next one is traced in background.
+    render_animation(scene, animation, [&](int frame, Window &frame_window) {
+        char name[32];
+        snprintf(name, sizeof(name), "/frame_%04d.ppm", frame);
+        write_ppm(frames_dir + name, frame_window.windows_colors);
+        return true;
+    }, settings);
+
+    double total_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << animation.frame_count << " frames em " << total_ms << " ms ("
+         << animation.frame_count / (total_ms / 1000) << " fps)" << endl;
+    return 0;
+}
+
 
-                // camera.window.center.z += 0.05;
-                // cout << camera.window.center << endl;
-                camera.window.should_update = true;
-            }
+int render_distributed(vector<string> worker_addresses, string scene_path, int local_workers, int threads, string output_path)
+{
+    vector<LocalWorker> workers;
+    int result = 0;
+    try {
+        if (local_workers > 0) {
+            int threads_per_worker = threads > 0 ? threads : max(1, (int)thread::hardware_concurrency() / local_workers);
+            workers = spawn_local_workers(scene_path, local_workers, threads_per_worker);
+            for (LocalWorker &worker : workers) worker_addresses.push_back(worker.address);
         }
 
-        // Good practice
-        SDL_RenderClear(renderer);
+        RenderCoordinator coordinator(worker_addresses);
+        vector<vector<Color>> pixels;
+        DistributedStats stats = coordinator.render(pixels);
+        write_ppm(output_path, pixels);
+        cout << output_path << ": " << stats.frame_time_ms << " ms, " << coordinator.get_worker_count() << " workers, "
+             << stats.tiles << " tiles, " << stats.requeued_tiles << " reenviados, " << stats.duplicated_tiles
+             << " duplicados" << endl;
+        // Remote workers keep serving; only the ones started here are stopped.
+        if (!workers.empty()) coordinator.shutdown_workers();
+    } catch (runtime_error &error) {
+        cerr << error.what() << endl;
+        result = 1;
+    }
+    stop_local_workers(workers);
+    return result;
+}
 
-        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
 
-        // Just draw the colors saved in camera.window.windows_colors
-        if (!camera.window.should_update)
-        {
-            for (int l = 0; l < n_rows; l++)
-            {
-                for (int c = 0; c < n_cols; c++)
-                {
-                    Color color = camera.window.windows_colors[l][c];
+void test_vectorial_product() {
+    Vector3d v1(2,0,5);
+    Vector3d v2(1, 1, 8);
 
-                    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 255);
-                    SDL_RenderDrawPointF(renderer, c * width_ratio, l * height_ratio);
-                }
-            }
-            // Lastly, we update the window with the renderer we just painted
-            SDL_RenderPresent(renderer);
-            continue;
-        }
+    Vector3d result(-5, -11, 2);
+    if (!result.equals(v1.vectorial_product(v2))) {
+        throw logic_error("vectorial_product failed");
+    }
+}
 
-        // By default, we will always use Creto's system to calculate, when we need to draw just transform to SDL system
-        for (int l = 0; l < n_rows; l++)
-        {
-            float y = camera.window.height / 2 - (camera.window.dy / 2) - (camera.window.dy * l); // Creto's system
+void test_material_classification() {
+    IntensityColor k(.7, .7, .7);
+    Sphere matte(Vector3d(0, 0, 0), 1, Color(255, 255, 255), k, IntensityColor(0, 0, 0), k, 10);
+    Sphere integer_phong(Vector3d(0, 0, 0), 1, Color(255, 255, 255), k, k, k, 10);
+    Sphere phong(Vector3d(0, 0, 0), 1, Color(255, 255, 255), k, k, k, 2.5);
 
-            for (int c = 0; c < n_cols; c++)
-            {
-                float x = - camera.window.width / 2 + (camera.window.dx / 2) + (camera.window.dx * c); // Creto's system
+    if (matte.material_class != MATERIAL_DIFFUSE_ONLY || integer_phong.material_class != MATERIAL_PHONG_INTEGER
+        || phong.material_class != MATERIAL_PHONG) {
+        throw logic_error("classify_material failed");
+    }
+}
 
-                center_of_small_rectangle->x = x;
-                center_of_small_rectangle->y = y;
-                center_of_small_rectangle->z = camera.window.center.z;
+void test_dynamic_resolution() {
+    // Frames four times slower than the target should end near half the resolution, never below the minimum.
+    ResolutionController controller(25);
+    for (int i = 0; i < 20; i++) {
+        controller.record_frame(4 * 40 * controller.scale * controller.scale);
+    }
+    if (controller.scale < .4 || controller.scale > .6) {
+        throw logic_error("ResolutionController did not converge");
+    }
 
-                ray->p1 = Vector3d(0,0,0); // Eye in Camera's system
-                ray->p2 = *center_of_small_rectangle;
+    Window full(60, 60, 8, 8, 0, 0, -1);
+    Window low = scale_window(full, .5);
+    for (auto &row : low.windows_colors) {
+        for (auto &color : row) color = Color(10, 20, 30);
+    }
+    upscale_window(low, full);
+    if (low.cols != 4 || full.windows_colors[7][7].g != 20) {
+        throw logic_error("upscale_window failed");
+    }
+}
 
-                camera.window.windows_colors[l][c] = scene.get_color_to_draw(*ray);
+void test_transform_points() {
+    // Odd count and two threads, so both the SIMD lanes and the scalar tail of each chunk are used.
+    Matrix4 t = Matrix4(MatrixTransformations::rotation(.3, Y_AXIS)).multiply(MatrixTransformations::translation(1, -2, 3));
+    const int count = 2 * TRANSFORM_MIN_POINTS_PER_THREAD + 3;
+    vector<real> x(count), y(count), z(count);
+    for (int i = 0; i < count; i++) {
+        x[i] = i * .5;
+        y[i] = -i;
+        z[i] = i % 7;
+    }
+    t.transform_points(x.data(), y.data(), z.data(), count, 2);
 
-                Color color = camera.window.windows_colors[l][c];
+    for (int i = 0; i < count; i++) {
+        Vector3d expected = t.transform(Vector3d(i * .5, -i, i % 7));
+        if (x[i] != expected.x || y[i] != expected.y || z[i] != expected.z) {
+            throw logic_error("transform_points failed");
+        }
+    }
+}
 
-                SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 255);
-                SDL_RenderDrawPointF(renderer, c * width_ratio, l * height_ratio);
+void test_texture_mipmaps() {
+    // 10x6 (not multiples of the tile size) black and white checker of single texels.
+    vector<vector<Color>> pixels(6, vector<Color>(10));
+    for (int y = 0; y < 6; y++) {
+        for (int x = 0; x < 10; x++) {
+            uint8_t value = (x + y) % 2 ? 255 : 0;
+            pixels[y][x] = Color(value, value, value);
+        }
+    }
+    Texture texture(pixels);
+
+    // 10x6, 5x3, 2x1, 1x1.
+    if (texture.get_level_count() != 4 || texture.get_texel(0, 9, 5).r != pixels[5][9].r) {
+        throw logic_error("texture levels failed");
+    }
+    Color sharp = texture.sample((3 + .5) / 10, (2 + .5) / 6, 0);
+    Color blurred = texture.sample(.5, .5, 1);
+    if (sharp.r != pixels[2][3].r || std::abs(blurred.r - 128) > 2 || std::abs(texture.get_texel(1, 2, 1).r - 128) > 1) {
+        throw logic_error("texture filtering failed");
+    }
+}
+
+void test_denoise() {
+    // Two flat surfaces side by side: noise around 100 on the left one and a uniform 200 on the right one.
+    Window window(16, 8, 16, 8, 0, 0, -1);
+    window.windows_colors.assign(8, vector<Color>(16));
+    GuideBuffers guides;
+    guides.resize(16, 8);
+    Sphere left(Vector3d(0, 0, 0), 1, Color(255, 255, 255), IntensityColor(1, 1, 1), IntensityColor(1, 1, 1), IntensityColor(1, 1, 1), 1);
+    Sphere right = left;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 16; x++) {
+            uint8_t value = x >= 8 ? 200 : ((x + y) % 2 ? 130 : 70);
+            window.windows_colors[y][x] = Color(value, value, value);
+            PixelGuide &guide = guides.pixels[y * 16 + x];
+            guide.object = x >= 8 ? &right : &left;
+            guide.nx = 0, guide.ny = 0, guide.nz = 1, guide.depth = 10;
+            guide.albedo_r = guide.albedo_g = guide.albedo_b = 1;
+        }
+    }
+
+    denoise_frame(window, guides);
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 16; x++) {
+            int expected = x >= 8 ? 200 : 100;
+            if (std::abs(window.windows_colors[y][x].r - expected) > 10) {
+                throw logic_error("denoise failed");
             }
         }
+    }
+}
 
-        // Lastly, we update the window with the renderer we just painted
-        SDL_RenderPresent(renderer);
-        camera.window.should_update = false;
+void test_render_thread() {
+    // The consumer only sees the newest of the values published since it last took one.
+    TripleBuffer<int> buffer;
+    buffer.get_back() = 1;
+    buffer.publish();
+    buffer.get_back() = 2;
+    buffer.publish();
+    if (!buffer.take() || buffer.get_front() != 2 || buffer.take()) {
+        throw logic_error("TripleBuffer failed");
     }
 
-    // Free the memory
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
+    // A sphere in the middle of a 16x16 view; after the camera moves 100 units to the right it is out of view,
+    // until a mesh still loading there is ready.
+    Camera camera(Vector3d(0, 0, -100), Vector3d(0, 0, 0), Vector3d(0, 1000, 0), 80, 60, 60, 16, 16);
+    Scene scene(Color(0, 0, 0), SourceOfLight(IntensityColor(1, 1, 1), Vector3d(0, 100, 0)), IntensityColor(.3, .3, .3), camera);
+    IntensityColor k(.7, .7, .7);
+    scene.push_object(new Sphere(Vector3d(0, 0, -100), 20, Color(255, 0, 0), k, k, k, 10));
+    promise<Object *> loading;
+    scene.push_pending_mesh(loading.get_future().share(), [](Object *mesh) { return mesh; }, NULL);
+
+    RenderSettings settings;
+    settings.thread_count = 1;
+    RenderThread render_thread(scene, settings, 30, nullptr);
+    auto wait_for_frame = [&](bool sphere_visible) {
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(10);
+        while (chrono::steady_clock::now() < deadline) {
+            if (render_thread.take_frame()) {
+                PresentedFrame &frame = render_thread.get_frame();
+                if (frame.full_resolution && (frame.rgb[(8 * 16 + 8) * 3] > 0) == sphere_visible) return true;
+            }
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        return false;
+    };
+    bool first_frame = wait_for_frame(true);
+    render_thread.move_camera(100, 0, 0);
+    bool moved_frame = first_frame && wait_for_frame(false);
+    // No move follows: the render thread has to notice the mesh by itself.
+    loading.set_value(new Sphere(Vector3d(100, 0, -100), 20, Color(255, 0, 0), k, k, k, 10));
+    bool loaded_frame = moved_frame && wait_for_frame(true);
+    render_thread.stop();
+    scene.dealloc_objects();
+    scene.get_camera().destroy();
+    if (!loaded_frame) {
+        throw logic_error("RenderThread failed");
+    }
+}
 
+void test_cost_heatmap() {
+    // A sphere in the middle of a 16x16 view, which is a single culling tile: every primary ray tests the
+    // sphere once, and each hit adds a shadow ray that only tests the sphere itself.
+    Camera camera(Vector3d(0, 0, -100), Vector3d(0, 0, 0), Vector3d(0, 1000, 0), 80, 60, 60, 16, 16);
+    Scene scene(Color(0, 0, 0), SourceOfLight(IntensityColor(1, 1, 1), Vector3d(0, 100, 0)), IntensityColor(.3, .3, .3), camera);
+    IntensityColor k(.7, .7, .7);
+    scene.push_object(new Sphere(Vector3d(0, 0, -100), 20, Color(255, 0, 0), k, k, k, 10));
+
+    RenderSettings settings;
+    settings.thread_count = 1;
+    settings.heatmap = COST_INTERSECTIONS;
+    Window window = scene.get_camera().window;
+    FrameStats stats = render_frame(scene, window, settings);
+    Color center = window.windows_colors[8][8], corner = window.windows_colors[0][0];
     scene.dealloc_objects();
-    delete ray;
-    delete center_of_small_rectangle;
-    return 0;
+    scene.get_camera().destroy();
+    if (stats.shadow_tests == 0 || stats.intersection_tests != 16 * 16 + stats.shadow_tests || stats.heatmap_scale != 2
+        || (center.r == corner.r && center.g == corner.g && center.b == corner.b)) {
+        throw logic_error("cost heatmap failed");
+    }
 }
 
+void test_timeline() {
+    // Once full, a ring keeps the newest CAPACITY events.
+    ThreadTimeline timeline(0);
+    for (uint64_t i = 0; i < ThreadTimeline::CAPACITY + 5; i++) {
+        timeline.record(TimelineEvent{"event", i, 1});
+    }
+    uint64_t oldest = timeline.written.load() - ThreadTimeline::CAPACITY;
+    if (oldest != 5 || timeline.events[oldest & (ThreadTimeline::CAPACITY - 1)].start_ns != 5) {
+        throw logic_error("ThreadTimeline failed");
+    }
+}
 
-void test_vectorial_product() {
-    Vector3d v1(2,0,5);
-    Vector3d v2(1, 1, 8);
+void test_memory_accounting() {
+    // A 4x4 grid mesh and two spheres sharing one texture, which is counted once.
+    Camera camera(Vector3d(0, 0, -100), Vector3d(0, 0, 0), Vector3d(0, 1000, 0), 80, 60, 60, 16, 16);
+    Scene scene(Color(0, 0, 0), SourceOfLight(IntensityColor(1, 1, 1), Vector3d(0, 100, 0)), IntensityColor(.3, .3, .3), camera);
+    IntensityColor k(.7, .7, .7);
+    shared_ptr<Texture> texture = make_shared<Texture>(vector<vector<Color>>(8, vector<Color>(8)));
+    for (int i = 0; i < 2; i++) {
+        Sphere *sphere = new Sphere(Vector3d(0, 0, -100), 20, Color(255, 0, 0), k, k, k, 10);
+        sphere->set_texture(texture, 1);
+        scene.push_object(sphere);
+    }
+    Mesh *grid = ObjFactory::create_grid(4, 10, 0);
+    size_t geometry = grid->faces.capacity() * sizeof(FourPointsFace);
+    scene.push_object(grid);
 
-    Vector3d result(-5, -11, 2);
-    if (!result.equals(v1.vectorial_product(v2))) {
-        throw logic_error("vectorial_product failed");
+    MemoryUsage usage = scene.get_memory_usage();
+    scene.dealloc_objects();
+    scene.get_camera().destroy();
+    if (usage.bytes[MEMORY_MESH_GEOMETRY] != geometry || usage.bytes[MEMORY_TEXTURES] != texture->get_memory_usage()
+        || usage.bytes[MEMORY_OBJECTS] < 2 * sizeof(Sphere) + sizeof(Mesh) || usage.bytes[MEMORY_FRAMEBUFFERS] < 16 * 16 * sizeof(Color)) {
+        throw logic_error("memory accounting failed");
+    }
+}
+
+void test_obj_reader() {
+    // A quad written with relative indices, then a face whose index overflows an int.
+    // Distributed workers run these tests too, so each process writes its own file.
+    string path = (std::filesystem::temp_directory_path() / ("cenario_test_" + to_string(getpid()) + ".obj")).string();
+    auto read = [&](string contents) {
+        std::ofstream(path) << contents;
+        ObjReader reader;
+        return reader.read_obj_file(path);
+    };
+    Mesh *quad = read("v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf -4 -3 -2 -1\n");
+    BoundingBox bounds = quad->get_bounds();
+    bool resolved = quad->faces.size() == 1 && std::abs(bounds.min_point.x) < (real)0.01
+        && std::abs(bounds.max_point.x - 1) < (real)0.01 && std::abs(bounds.max_point.y - 1) < (real)0.01;
+    delete quad;
+    bool overflow_rejected = false;
+    try {
+        delete read("v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4294967299\n");
+    } catch (runtime_error &) {
+        overflow_rejected = true;
+    }
+    std::filesystem::remove(path);
+    if (!resolved || !overflow_rejected) {
+        throw logic_error("ObjReader failed");
+    }
+}
+
+void test_pick() {
+    // A sphere in the middle of a 16x16 view, and in front of it a mesh of two faces along the bottom.
+    Camera camera(Vector3d(0, 0, -100), Vector3d(0, 0, 0), Vector3d(0, 1000, 0), 80, 60, 60, 16, 16);
+    Scene scene(Color(0, 0, 0), SourceOfLight(IntensityColor(1, 1, 1), Vector3d(0, 100, 0)), IntensityColor(.3, .3, .3), camera);
+    IntensityColor k(.7, .7, .7);
+    scene.push_object(new Sphere(Vector3d(0, 0, -100), 20, Color(255, 0, 0), k, k, k, 10));
+    vector<FourPointsFace> faces;
+    faces.push_back(FourPointsFace(Vector3d(-18, -18, -50), Vector3d(0, -18, -50), Vector3d(0, -8, -50), Vector3d(-18, -8, -50)));
+    faces.push_back(FourPointsFace(Vector3d(0, -18, -50), Vector3d(18, -18, -50), Vector3d(18, -8, -50), Vector3d(0, -8, -50)));
+    scene.push_object(new Mesh(faces));
+
+    auto check = [&]() {
+        vector<PickResult> results = scene.pick({{8, 8}, {0, 0}, {12, 14}});
+        PickResult &sphere = results[0], &none = results[1], &face = results[2];
+        return sphere.object_index == 0 && sphere.primitive_index == -1 && std::abs(sphere.distance - 80) < 1
+            && std::abs(sphere.point.z + 80) < 1 && none.object == NULL
+            && face.object == scene.objects[1] && face.primitive_index / 2 == 1 && std::abs(face.point.z + 50) < (real)0.01;
+    };
+    // Every object is tested before the first frame; the tile candidates of the frame are used after it.
+    bool before_frame = check();
+    Window window = scene.get_camera().window;
+    render_frame(scene, window);
+    bool after_frame = check();
+    // Moving the sphere out of view, as the server's transform does, leaves the tile candidates behind.
+    Vector3d center = scene.get_camera().transform_vector_from_camera_to_world(scene.objects[0]->get_center());
+    scene.transform_object(0, get_transformation_matrix("translate 200 0 0 scale 2 2 2", center));
+    Sphere *moved = (Sphere *)scene.objects[0];
+    bool after_move = scene.pick(8, 8).object == NULL && std::abs(moved->radius - 40) < (real)0.01;
+    scene.dealloc_objects();
+    scene.get_camera().destroy();
+    if (!before_frame || !after_frame || !after_move) {
+        throw logic_error("pick failed");
     }
 }
 
 void run_tests() {
     test_vectorial_product();
+    test_material_classification();
+    test_dynamic_resolution();
+    test_transform_points();
+    test_texture_mipmaps();
+    test_denoise();
+    test_render_thread();
+    test_cost_heatmap();
+    test_timeline();
+    test_memory_accounting();
+    test_pick();
+    test_obj_reader();
 }
\ No newline at end of file